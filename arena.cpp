@@ -0,0 +1,197 @@
+#include "arena.h"
+#include <cstdlib>
+
+// smallest chunk, enough for the scratch memory of typical expressions
+const std::size_t MIN_CAPACITY = 64 * 1024;
+
+// evaluations over which the largest one decides the capacity
+const std::size_t WINDOW = 256;
+
+// an arena more than this many times larger than recent evaluations needed shrinks
+const std::size_t SHRINK_FACTOR = 4;
+
+// totals over the arenas of every thread
+std::atomic<std::uint64_t> chunk_allocations{0};
+std::atomic<std::size_t> bytes_held{0};
+std::atomic<std::size_t> most_bytes_held{0};
+
+
+/**
+ * @brief Chunk that holds an evaluation with an eighth to spare, in multiples of MIN_CAPACITY
+ * 
+ * @param bytes most bytes an evaluation used
+ * @return std::size_t chunk size
+ */
+std::size_t Arena::chunk_size(std::size_t bytes)
+{
+    std::size_t size = bytes + bytes / 8;
+
+    return std::max(MIN_CAPACITY, (size + MIN_CAPACITY - 1) / MIN_CAPACITY * MIN_CAPACITY);
+}
+
+
+/**
+ * @brief Chunks allocated and bytes held by the arenas of every thread
+ * 
+ * @return ArenaSnapshot totals since the program started
+ */
+ArenaSnapshot Arena::snapshot()
+{
+    ArenaSnapshot snapshot;
+    snapshot.chunks = chunk_allocations.load(std::memory_order_relaxed);
+    snapshot.capacity = bytes_held.load(std::memory_order_relaxed);
+    snapshot.peak_capacity = most_bytes_held.load(std::memory_order_relaxed);
+
+    return snapshot;
+}
+
+
+/**
+ * @brief Frees the chunks of the arena
+ */
+Arena::~Arena()
+{
+    release();
+}
+
+
+/**
+ * @brief Bytes held by the arena
+ * 
+ * @return std::size_t total size of the chunks
+ */
+std::size_t Arena::capacity() const
+{
+    std::size_t total = 0;
+
+    for (const Chunk &chunk : chunks)
+        total += chunk.size;
+
+    return total;
+}
+
+
+/**
+ * @brief Most bytes a recent evaluation used
+ * 
+ * @return std::size_t peak over the current and the last window of evaluations
+ */
+std::size_t Arena::recent() const
+{
+    return std::max({peak, window_peak, last_peak});
+}
+
+
+/**
+ * @brief Moves to the next chunk, or allocates one twice the size of the last, for an allocation that does not fit
+ * 
+ * @param bytes size of the allocation
+ * @param align alignment of the allocation
+ * @return void* memory valid until the enclosing Scope closes
+ */
+void *Arena::grow(std::size_t bytes, std::size_t align)
+{
+    // chunks after the current one are left from an earlier evaluation that needed them
+    while (current + 1 < chunks.size())
+    {
+        base += chunks[current].size;
+        current++;
+        used = 0;
+
+        if (bytes + align <= chunks[current].size)
+            return allocate(bytes, align);
+    }
+
+    add(std::max(chunks.empty() ? MIN_CAPACITY : chunks.back().size * 2, chunk_size(bytes + align)));
+
+    return allocate(bytes, align);
+}
+
+
+/**
+ * @brief Allocates a chunk and makes it the current one
+ * 
+ * @param size bytes of the chunk
+ */
+void Arena::add(std::size_t size)
+{
+    char *data = static_cast<char*>(std::malloc(size));
+
+    if (data == nullptr)
+        throw std::bad_alloc();
+
+    chunk_allocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t held = bytes_held.fetch_add(size, std::memory_order_relaxed) + size;
+    std::size_t most = most_bytes_held.load(std::memory_order_relaxed);
+
+    while (most < held && !most_bytes_held.compare_exchange_weak(most, held, std::memory_order_relaxed))
+        ;
+
+    if (!chunks.empty())
+    {
+        base += chunks[current].size;
+        current = chunks.size();
+    }
+
+    chunks.push_back({data, size});
+    used = 0;
+}
+
+
+/**
+ * @brief Resizes the arena after an evaluation, called whenever it is empty
+ * 
+ * An evaluation that needed several chunks leaves one chunk large enough for it. Every
+ * WINDOW evaluations the arena shrinks when it is SHRINK_FACTOR times larger than
+ * the largest of them needed.
+ */
+void Arena::adapt()
+{
+    window_peak = std::max(window_peak, peak);
+    peak = 0;
+
+    if (chunks.size() > 1)
+        replace(chunk_size(window_peak));
+
+    if (++evaluations < WINDOW)
+        return;
+
+    last_peak = window_peak;
+    window_peak = 0;
+    evaluations = 0;
+
+    std::size_t size = chunk_size(last_peak);
+
+    if (chunks.size() == 1 && chunks[0].size > size * SHRINK_FACTOR)
+        replace(size);
+}
+
+
+/**
+ * @brief Replaces the chunks of an empty arena with one chunk
+ * 
+ * @param size bytes of the new chunk
+ */
+void Arena::replace(std::size_t size)
+{
+    release();
+    add(size);
+}
+
+
+/**
+ * @brief Frees every chunk
+ */
+void Arena::release()
+{
+    for (const Chunk &chunk : chunks)
+    {
+        std::free(chunk.data);
+        bytes_held.fetch_sub(chunk.size, std::memory_order_relaxed);
+    }
+
+    chunks.clear();
+    current = 0;
+    used = 0;
+    base = 0;
+}
\ No newline at end of file
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <new>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+
+// memory of the arenas of every thread
+struct ArenaSnapshot
+{
+    std::uint64_t chunks = 0;
+    std::size_t capacity = 0;
+    std::size_t peak_capacity = 0;
+};
+
+
+// scratch memory of one thread, reused by every evaluation on it. Allocation bumps a pointer
+// and a Scope gives back everything allocated while it was open. Capacity follows the largest
+// recent evaluation: chunks added for a large input become one chunk, and an arena much larger
+// than what recent evaluations used shrinks back
+class Arena
+{
+    public:
+        // gives back everything allocated on the arena of this thread while it is open,
+        // scratch memory must be allocated inside one
+        class Scope
+        {
+            public:
+                Scope();
+                ~Scope();
+
+                Scope(const Scope&) = delete;
+                Scope &operator=(const Scope&) = delete;
+
+                template <typename T>
+                T *allocate(std::size_t count);
+
+            private:
+                Arena &arena;
+                std::size_t chunk;
+                std::size_t used;
+                std::size_t base;
+        };
+
+        static Arena &local();
+        static ArenaSnapshot snapshot();
+
+        void *allocate(std::size_t, std::size_t);
+        std::size_t capacity() const;
+        std::size_t recent() const;
+
+        Arena(const Arena&) = delete;
+        Arena &operator=(const Arena&) = delete;
+        ~Arena();
+
+    private:
+        struct Chunk
+        {
+            char *data;
+            std::size_t size;
+        };
+
+        Arena() = default;
+
+        static std::size_t chunk_size(std::size_t);
+
+        void *grow(std::size_t, std::size_t);
+        void adapt();
+        void add(std::size_t);
+        void replace(std::size_t);
+        void release();
+
+        std::vector<Chunk> chunks;
+
+        // position of the next allocation: chunk, bytes used in it and bytes of the chunks before it
+        std::size_t current = 0;
+        std::size_t used = 0;
+        std::size_t base = 0;
+
+        // most bytes in use since the arena was last empty, over this window and over the last one
+        std::size_t peak = 0;
+        std::size_t window_peak = 0;
+        std::size_t last_peak = 0;
+        std::size_t evaluations = 0;
+};
+
+
+/**
+ * @brief Arena of the calling thread, created on first use and freed when the thread exits
+ * 
+ * @return Arena& arena
+ */
+inline Arena &Arena::local()
+{
+    thread_local Arena instance;
+    return instance;
+}
+
+
+/**
+ * @brief Allocates from the current chunk, adding a chunk when it is full
+ * 
+ * @param bytes size of the allocation
+ * @param align alignment, a power of two no larger than alignof(std::max_align_t)
+ * @return void* memory valid until the enclosing Scope closes
+ */
+inline void *Arena::allocate(std::size_t bytes, std::size_t align)
+{
+    std::size_t start = (used + align - 1) & ~(align - 1);
+
+    if (current < chunks.size() && start + bytes <= chunks[current].size)
+    {
+        used = start + bytes;
+        peak = std::max(peak, base + used);
+        return chunks[current].data + start;
+    }
+
+    return grow(bytes, align);
+}
+
+
+/**
+ * @brief Marks the current position of the arena of this thread
+ */
+inline Arena::Scope::Scope() : arena(Arena::local()), chunk(arena.current), used(arena.used), base(arena.base)
+{
+}
+
+
+/**
+ * @brief Rewinds the arena to where the scope opened, adapting its capacity when that leaves it empty
+ */
+inline Arena::Scope::~Scope()
+{
+    arena.current = chunk;
+    arena.used = used;
+    arena.base = base;
+
+    if (chunk == 0 && used == 0)
+        arena.adapt();
+}
+
+
+/**
+ * @brief Allocates an uninitialized array on the arena of the scope
+ * 
+ * @param count number of elements
+ * @return T* array valid until the scope closes
+ */
+template <typename T>
+T *Arena::Scope::allocate(std::size_t count)
+{
+    return static_cast<T*>(arena.allocate(count * sizeof(T), alignof(T)));
+}
+
+
+// allocator of containers that live inside a Scope, deallocation is left to the scope
+template <typename T>
+struct ArenaAllocator
+{
+    using value_type = T;
+
+    ArenaAllocator() = default;
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>&) {}
+
+    T *allocate(std::size_t count)
+    {
+        return static_cast<T*>(Arena::local().allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, std::size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>&) const { return true; }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>&) const { return false; }
+};
+
+
+template <typename T>
+using ScratchVector = std::vector<T, ArenaAllocator<T>>;
+
+
+template <typename K, typename V>
+using ScratchMap = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>, ArenaAllocator<std::pair<const K, V>>>;
\ No newline at end of file
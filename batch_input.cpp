@@ -0,0 +1,263 @@
+#include "batch_input.h"
+#include "evaluate_expression.h"
+#include "stream_parser.h"
+#include "stats.h"
+
+// bytes read from the input at once
+const std::size_t BLOCK_SIZE = 1 << 20;
+
+// lines evaluated by one task
+const std::size_t CHUNK_LINES = 1024;
+
+
+/**
+ * @brief Evaluates newline delimited expressions from a file or stdin without prompts
+ * 
+ * @param path file to read, stdin if null
+ * @param threads number of evaluation threads
+ * @param cache_bytes memory limit of the result cache, zero disables it
+ * @param options notation and precision of results
+ * @return int zero on success, one if the file could not be opened
+ */
+int BatchInput::run(const char *path, std::size_t threads, std::size_t cache_bytes, const FormatOptions &options)
+{
+    std::FILE *input = stdin;
+
+    if (path != nullptr)
+    {
+        input = std::fopen(path, "rb");
+
+        if (input == nullptr)
+        {
+            std::cerr << "could not open file: " << path << std::endl;
+            return 1;
+        }
+    }
+
+    std::unique_ptr<ResultCache> cache;
+
+    if (cache_bytes > 0)
+        cache = std::make_unique<ResultCache>(cache_bytes, 16, options);
+
+    // a single thread evaluates in place
+    if (threads > 1)
+    {
+        ThreadPool pool(threads);
+        read_lines(input, &pool, cache.get(), options);
+    }
+    else
+    {
+        read_lines(input, nullptr, cache.get(), options);
+    }
+
+    if (input != stdin)
+        std::fclose(input);
+
+    if (cache)
+    {
+        CacheStats stats = cache->stats();
+
+        std::cerr << "cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+                  << stats.evictions << " evictions" << std::endl;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Reads input in large blocks, evaluates every complete line and writes results once per block
+ * 
+ * @param input open input file
+ * @param pool threads to evaluate on, null to evaluate on the calling thread
+ * @param cache result cache, null to always evaluate
+ * @param options notation and precision of results
+ */
+void BatchInput::read_lines(std::FILE *input, ThreadPool *pool, ResultCache *cache, const FormatOptions &options)
+{
+    // larger blocks keep every thread busy
+    std::vector<char> block(BLOCK_SIZE * (pool != nullptr ? pool->size() : 1));
+    std::size_t filled = 0;
+
+    // lines of the current block and their results, reused between blocks
+    std::vector<std::string_view> lines;
+    std::vector<std::string> results;
+
+    std::size_t length;
+
+    // what follows a streamed line is not split into lines yet, even when the input has ended
+    bool unsplit = false;
+
+    while ((length = std::fread(block.data() + filled, 1, block.size() - filled, input)) > 0 || unsplit)
+    {
+        filled += length;
+        unsplit = false;
+
+        const char *start = block.data();
+        const char *end = block.data() + filled;
+
+        lines.clear();
+
+        while (const char *newline = static_cast<const char*>(std::memchr(start, '\n', end - start)))
+        {
+            lines.emplace_back(start, newline - start);
+            start = newline + 1;
+        }
+
+        evaluate_lines(lines, results, pool, cache, options);
+
+        // flush only at block boundaries
+        write(results);
+
+        // keep line split across two blocks
+        filled = end - start;
+        std::memmove(block.data(), start, filled);
+
+        // a line longer than the block is evaluated as it is read
+        if (filled == block.size())
+        {
+            stream_line(input, block, filled, results, options);
+            unsplit = filled > 0;
+        }
+    }
+
+    // last line without newline
+    if (filled > 0)
+    {
+        lines.clear();
+        lines.emplace_back(block.data(), filled);
+
+        evaluate_lines(lines, results, pool, cache, options);
+        write(results);
+    }
+}
+
+
+/**
+ * @brief Evaluates a line that does not fit the block one block at a time, so memory stays bounded by its nesting
+ * 
+ * Such lines bypass the result cache and are evaluated on the reading thread.
+ * 
+ * @param input open input file
+ * @param block holds the start of the line, receives what follows its newline
+ * @param filled bytes of the line in block, receives the bytes after its newline
+ * @param results receives the output of the line
+ * @param options notation and precision of results
+ */
+void BatchInput::stream_line(std::FILE *input, std::vector<char> &block, std::size_t &filled, std::vector<std::string> &results,
+                             const FormatOptions &options)
+{
+    STATS_START(start);
+
+    StreamParser parser;
+
+    // a carriage return at the end of a block is only part of the expression when more of the line follows
+    bool carriage = false;
+    const char *newline = nullptr;
+
+    while (newline == nullptr && filled > 0)
+    {
+        newline = static_cast<const char*>(std::memchr(block.data(), '\n', filled));
+        std::size_t length = (newline != nullptr) ? newline - block.data() : filled;
+
+        if (carriage && length > 0)
+            (void) parser.feed("\r");
+
+        carriage = length > 0 && block[length - 1] == '\r';
+        (void) parser.feed(std::string_view(block.data(), length - carriage));
+
+        if (newline != nullptr)
+        {
+            filled -= length + 1;
+            std::memmove(block.data(), newline + 1, filled);
+        }
+        else
+        {
+            filled = std::fread(block.data(), 1, block.size(), input);
+        }
+    }
+
+    results.assign(1, std::string());
+    (void) parser.finish(results[0], options);
+    results[0].push_back('\n');
+
+    STATS_LAP(start, EVALUATE);
+
+    write(results);
+}
+
+
+/**
+ * @brief Evaluates lines in chunks and stores each chunk's output in input order
+ * 
+ * @param lines expressions without newline
+ * @param results one output buffer per chunk of lines
+ * @param pool threads to evaluate on, null to evaluate on the calling thread
+ * @param cache result cache, null to always evaluate
+ * @param options notation and precision of results
+ */
+void BatchInput::evaluate_lines(const std::vector<std::string_view> &lines, std::vector<std::string> &results,
+                                ThreadPool *pool, ResultCache *cache, const FormatOptions &options)
+{
+    std::size_t chunks = (lines.size() + CHUNK_LINES - 1) / CHUNK_LINES;
+    results.resize(chunks);
+
+    for (std::size_t chunk = 0; chunk < chunks; chunk++)
+    {
+        std::function<void()> task = [&lines, &results, cache, &options, chunk]
+        {
+            std::string &out = results[chunk];
+            out.clear();
+
+            std::size_t last = std::min(lines.size(), (chunk + 1) * CHUNK_LINES);
+
+            for (std::size_t i = chunk * CHUNK_LINES; i < last; i++)
+                evaluate_line(lines[i], out, cache, options);
+        };
+
+        if (pool != nullptr)
+            pool->submit(std::move(task));
+        else
+            task();
+    }
+
+    if (pool != nullptr)
+        pool->wait();
+}
+
+
+/**
+ * @brief Evaluates one line and appends its result and a newline
+ * 
+ * @param line expression without newline
+ * @param out text the result is appended to
+ * @param cache result cache, null to always evaluate, its own options format cached results
+ * @param options notation and precision of results
+ */
+void BatchInput::evaluate_line(std::string_view line, std::string &out, ResultCache *cache, const FormatOptions &options)
+{
+    // accept windows line endings
+    if (line.size() > 0 && line.back() == '\r')
+        line.remove_suffix(1);
+
+    if (cache != nullptr)
+        cache->evaluate(line, out);
+    else
+        EvaluateExpression::evaluate(line, out, options);
+
+    out.push_back('\n');
+}
+
+
+/**
+ * @brief Writes chunk outputs in order and flushes
+ * 
+ * @param results one output buffer per chunk of lines
+ */
+void BatchInput::write(const std::vector<std::string> &results)
+{
+    for (const std::string &out : results)
+        std::fwrite(out.data(), 1, out.size(), stdout);
+
+    std::fflush(stdout);
+}
\ No newline at end of file
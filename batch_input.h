@@ -0,0 +1,27 @@
+#pragma once
+
+#include "thread_pool.h"
+#include "result_cache.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+
+class BatchInput
+{
+    public:
+        static int run(const char*, std::size_t, std::size_t, const FormatOptions&);
+        static void evaluate_lines(const std::vector<std::string_view>&, std::vector<std::string>&, ThreadPool*, ResultCache*,
+                                   const FormatOptions&);
+        static void evaluate_line(std::string_view, std::string&, ResultCache*, const FormatOptions&);
+
+    private:
+        static void read_lines(std::FILE*, ThreadPool*, ResultCache*, const FormatOptions&);
+        static void stream_line(std::FILE*, std::vector<char>&, std::size_t&, std::vector<std::string>&, const FormatOptions&);
+        static void write(const std::vector<std::string>&);
+};
\ No newline at end of file
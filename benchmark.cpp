@@ -0,0 +1,2253 @@
+#include "evaluate_expression.h"
+#include "expression_generator.h"
+#include "batch_input.h"
+#include "jit_program.h"
+#include "formula_graph.h"
+#include "static_program.h"
+#include "evaluation_context.h"
+#include "arena.h"
+#include "vector_math.h"
+#include "pipeline.h"
+#include "parallel_program.h"
+#include "program_store.h"
+#include "operator_registry.h"
+#include "stream_parser.h"
+#include <map>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+
+// expressions used for timing
+const std::vector<std::string> EXPRESSIONS = {"3 + 4 * 2 / (1 - 5)^(2^3)",
+                                              "sin(1)^2 + 2",
+                                              "(-sin 1 + 1) (1 / -cos 1)",
+                                              "--(--(log(--4)--(1)))"};
+
+// evaluations per expression
+const int ITERATIONS = 200000;
+
+// lines evaluated per thread count in the scaling benchmark
+const std::size_t BATCH_LINES = 500000;
+
+// formula and number of elements for the array benchmark
+const std::string COLUMN_EXPRESSION = "x * 2 + sin(x) / (1 + y^2)";
+const std::size_t COLUMN_SIZE = 1000000;
+
+// random expressions in the JIT differential check
+const int JIT_CORPUS = 20000;
+
+// approximate token counts of the parser scaling inputs
+const std::vector<std::size_t> PARSE_SIZES = {10000, 100000, 1000000};
+
+// expressions per profile of the synthetic suite and passes over them
+const int SUITE_CORPUS = 2000;
+const int SUITE_PASSES = 20;
+
+// defects appended to valid expressions for the error path benchmark, one per error code
+const std::vector<std::string> DEFECTS = {" / (2 - 2)", " + log(1 - 3)", " * (1 + 2", " + ()", " - -", " * / 2",
+                                          " $ 3", " + 1.2.3", " + sin", " 4", " + z"};
+
+// expressions in the error path corpora and passes over them
+const int INVALID_CORPUS = 3000;
+const int INVALID_PASSES = 20;
+
+// results written per notation in the formatting benchmark
+const std::size_t FORMAT_VALUES = 500000;
+
+// expressions in the repetitive corpus, copies of the repeated subterm in each and passes over them
+const int CSE_CORPUS = 2000;
+const int CSE_COPIES = 12;
+const int CSE_PASSES = 50;
+
+// independent columns of chained formulas in the formula benchmark, passes and single input changes
+const std::size_t SHEET_COLUMNS = 20;
+const std::size_t SHEET_ROWS = 100;
+const int SHEET_PASSES = 20;
+const int SHEET_UPDATES = 2000;
+
+// expressions every thread evaluates in its own context, and passes over them
+const int CONTEXT_CORPUS = 5000;
+const int CONTEXT_PASSES = 10;
+
+// expressions every thread evaluates through the arena, passes over them, and the large input it adapts to
+const int ARENA_CORPUS = 5000;
+const int ARENA_PASSES = 10;
+const std::size_t ARENA_LARGE = 1000000;
+
+// arguments per input range in the accuracy check of the vector kernels, and elements timed per function
+const std::size_t SIMD_SAMPLES = 200000;
+const std::size_t SIMD_ELEMENTS = 1000000;
+const int SIMD_PASSES = 20;
+
+// generated lines streamed through the pipeline, and copies of them in the long stream
+const std::size_t PIPELINE_LINES = 400000;
+const int PIPELINE_REPEATS = 5;
+
+// bracketed terms of the single huge expression evaluated on a thread pool, and timed runs per thread count
+const std::size_t PARALLEL_TERMS = 1000000;
+const int PARALLEL_PASSES = 5;
+
+// named formulas of the precompiled store, and cold starts timed for text and for the store
+const std::size_t STORE_FORMULAS = 100000;
+const int STORE_REPEATS = 5;
+
+// functions registered on top of the built in ones, name lookups timed per table, and expressions compiled per table
+const std::size_t REGISTRY_NATIVES = 1000;
+const int REGISTRY_LOOKUPS = 2000000;
+const int REGISTRY_CORPUS = 5000;
+
+// bytes of the generated expression evaluated whole and streamed, bytes streamed at a time, and brackets of the nested one
+const std::size_t STREAM_BYTES = 32 << 20;
+const std::size_t STREAM_CHUNK = 64 << 10;
+const std::size_t STREAM_LEVELS = 1000000;
+
+// heap allocations made by the process
+std::atomic<std::size_t> allocations{0};
+
+// the counting operators stay out of line, GCC warns about a mismatch where it inlines only one of a pair
+#define OUT_OF_LINE __attribute__((noinline))
+
+
+/**
+ * @brief Counts heap allocations
+ * 
+ * @param size bytes requested
+ * @return void* allocated memory
+ */
+OUT_OF_LINE void *operator new(std::size_t size)
+{
+    allocations++;
+
+    if (void *ptr = std::malloc(size))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+
+/**
+ * @brief Releases memory from the counting operator new
+ * 
+ * @param ptr allocated memory
+ */
+OUT_OF_LINE void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+
+/**
+ * @brief Releases memory from the counting operator new
+ * 
+ * @param ptr allocated memory
+ */
+OUT_OF_LINE void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+
+class Benchmark
+{
+    public:
+        static void stages();
+        static void scaling();
+        static void parsing();
+        static void columns();
+        static void jit();
+        static void suite();
+        static void invalid();
+        static void formatting();
+        static void formulas();
+        static void cse();
+        static void static_programs();
+        static void contexts();
+        static void arena();
+        static void simd();
+        static void pipeline();
+        static void parallel();
+        static void store();
+        static void registry();
+        static void streaming();
+
+        static bool save(const std::string&);
+
+    private:
+        static std::string outcome(const JitProgram*, const Program&, const double*);
+        static std::string shaped(const std::string&, std::size_t);
+        static double seconds_since(std::chrono::steady_clock::time_point);
+        static double ulps(double, long double);
+        static std::string isolated(const std::string&, bool, double&, double&);
+        static void report(const std::string&, const std::string&, double, const std::string&);
+
+        // measurements as scenario,metric,unit,value rows
+        static std::string rows;
+};
+
+
+std::string Benchmark::rows = "scenario,metric,unit,value\n";
+
+
+/**
+ * @brief Seconds elapsed since start
+ * 
+ * @param start time the measurement began
+ * @return double elapsed seconds
+ */
+double Benchmark::seconds_since(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+
+/**
+ * @brief Error of a result in units in the last place of the exact value
+ * 
+ * @param value computed result
+ * @param exact extended precision result
+ * @return double error in ulp, zero for matching infinities and NaN, infinity for other special values
+ */
+double Benchmark::ulps(double value, long double exact)
+{
+    if (std::isnan(value) || std::isnan(exact) || std::isinf(value) || std::isinf(exact))
+        return (std::isnan(value) && std::isnan(exact)) || value == exact ? 0 : std::numeric_limits<double>::infinity();
+
+    int exponent;
+    std::frexp(static_cast<double>(exact), &exponent);
+
+    return std::fabs(value - exact) / std::ldexp(1.0L, std::max(exponent - 53, -1074));
+}
+
+
+/**
+ * @brief Prints measurement and keeps it for the results file
+ * 
+ * @param scenario measured input
+ * @param metric measured quantity
+ * @param value measurement
+ * @param unit unit of the measurement
+ */
+void Benchmark::report(const std::string &scenario, const std::string &metric, double value, const std::string &unit)
+{
+    std::cout << "\t" << metric << ": " << value << " " << unit << std::endl;
+    rows += "\"" + scenario + "\"," + metric + "," + unit + "," + std::to_string(value) + "\n";
+}
+
+
+/**
+ * @brief Writes every measurement as CSV so two builds can be compared
+ * 
+ * @param path results file
+ * @return true file was written
+ * @return false file could not be opened
+ */
+bool Benchmark::save(const std::string &path)
+{
+    std::ofstream file(path);
+
+    if (!file)
+        return false;
+
+    file << rows;
+    return true;
+}
+
+
+/**
+ * @brief Times tokenizing, compiling and executing, and counts steady state allocations
+ */
+void Benchmark::stages()
+{
+    for (const std::string &expression : EXPRESSIONS)
+    {
+        std::cout << expression << std::endl;
+
+        std::vector<std::string> variables;
+        Program program;
+
+        // keep results alive so the loops are not optimized away
+        double total = 0;
+        Error error;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < ITERATIONS; i++)
+        {
+            Arena::Scope scope;
+            ScratchVector<Token> tokens;
+
+            error = EvaluateExpression::get_tokens(expression, tokens, variables);
+            total += tokens.size();
+        }
+
+        report(expression, "get_tokens", seconds_since(start) * 1e9 / ITERATIONS, "ns/eval");
+
+        start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < ITERATIONS; i++)
+        {
+            error = EvaluateExpression::compile(expression, program);
+            total += program.code.size();
+        }
+
+        report(expression, "compile", seconds_since(start) * 1e9 / ITERATIONS, "ns/eval");
+
+        // same program without the optimization pass
+        Program unoptimized;
+
+        {
+            Arena::Scope scope;
+            ScratchVector<Token> tokens;
+
+            error = EvaluateExpression::get_tokens(expression, tokens, variables);
+            error = EvaluateExpression::shunting_yard(tokens, unoptimized);
+        }
+
+        Program optimized = unoptimized;
+        report(expression, "optimize removed", EvaluateExpression::optimize(optimized), "instructions");
+
+        start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < ITERATIONS; i++)
+            total += EvaluateExpression::execute(unoptimized);
+
+        report(expression, "execute unoptimized", seconds_since(start) * 1e9 / ITERATIONS, "ns/eval");
+
+        start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < ITERATIONS; i++)
+            total += EvaluateExpression::execute(program);
+
+        report(expression, "execute", seconds_since(start) * 1e9 / ITERATIONS, "ns/eval");
+
+        // buffers are warm now, so compiling and executing again should not allocate
+        std::size_t before = allocations;
+
+        for (int i = 0; i < ITERATIONS; i++)
+        {
+            error = EvaluateExpression::compile(expression, program);
+            total += EvaluateExpression::execute(program);
+        }
+
+        report(expression, "allocations", static_cast<double>(allocations - before) / ITERATIONS, "per expression");
+
+        if (error || total != total)
+            std::cout << "\t(unexpected result)" << std::endl;
+    }
+}
+
+
+/**
+ * @brief Measures batch throughput from one thread up to every core
+ */
+void Benchmark::scaling()
+{
+    // synthetic batch built from the sample expressions
+    std::vector<std::string_view> lines;
+
+    for (std::size_t i = 0; i < BATCH_LINES; i++)
+        lines.push_back(EXPRESSIONS[i % EXPRESSIONS.size()]);
+
+    std::vector<std::string> results;
+    std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+
+    std::cout << "batch of " << BATCH_LINES << " lines" << std::endl;
+
+    for (std::size_t threads = 1; threads <= cores; threads *= 2)
+    {
+        ThreadPool pool(threads);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        BatchInput::evaluate_lines(lines, results, threads > 1 ? &pool : nullptr, nullptr, FormatOptions());
+        double seconds = seconds_since(start);
+
+        report("batch", std::to_string(threads) + " threads", BATCH_LINES / seconds, "lines/s");
+
+        // include the core count itself when it is not a power of two
+        if (threads < cores && threads * 2 > cores)
+            threads = cores / 2;
+    }
+
+    // repeated lines are answered from the cache after the first pass
+    ResultCache cache(64 << 20);
+    BatchInput::evaluate_lines(lines, results, nullptr, &cache, FormatOptions());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BatchInput::evaluate_lines(lines, results, nullptr, &cache, FormatOptions());
+    double seconds = seconds_since(start);
+
+    report("batch", "cached", BATCH_LINES / seconds, "lines/s");
+}
+
+
+/**
+ * @brief Builds a large expression of the given shape
+ * 
+ * @param shape "flat" for a long random sum without brackets, "nested" for brackets inside brackets,
+ *              "unary" for nested unary minus
+ * @param tokens approximate number of tokens
+ * @return std::string expression
+ */
+std::string Benchmark::shaped(const std::string &shape, std::size_t tokens)
+{
+    std::string expression;
+
+    if (shape == "flat")
+    {
+        GeneratorConfig config;
+        config.terms = tokens * 2 / 5;
+        config.function_share = 0;
+        config.bracket_share = 0;
+        config.power_share = 0;
+        config.variables = true;
+
+        ExpressionGenerator(config).next(expression);
+    }
+    else
+    {
+        // every level adds four tokens, unary minus adds the (-1 * ...) around it on top
+        std::size_t levels = tokens / 4;
+        const char *open = (shape == "nested") ? "(x+" : "x+-(";
+
+        for (std::size_t i = 0; i < levels; i++)
+            expression += open;
+
+        expression += "y";
+        expression.append(levels, ')');
+    }
+
+    return expression;
+}
+
+
+/**
+ * @brief Shows that compiling and executing stay linear in the number of tokens and the nesting depth
+ */
+void Benchmark::parsing()
+{
+    std::vector<std::string> variables;
+    Program program;
+    const double values[] = {0.5, 0.25};
+
+    for (const std::string shape : {"flat", "nested", "unary"})
+    {
+        std::cout << shape << " expressions" << std::endl;
+
+        double smallest = 0;
+        double largest = 0;
+        double total = 0;
+        Error error;
+
+        for (std::size_t size : PARSE_SIZES)
+        {
+            std::string expression = shaped(shape, size);
+            std::string scenario = shape + " " + std::to_string(size);
+
+            double token_count;
+
+            {
+                Arena::Scope scope;
+                ScratchVector<Token> tokens;
+
+                error = EvaluateExpression::get_tokens(expression, tokens, variables);
+                token_count = tokens.size();
+            }
+
+            // roughly the same amount of work at every size
+            int repeats = std::max<std::size_t>(1, 2 * PARSE_SIZES.back() / size);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for (int i = 0; i < repeats; i++)
+                error = EvaluateExpression::compile(expression, program);
+
+            double compile_ns = seconds_since(start) * 1e9 / (repeats * token_count);
+
+            start = std::chrono::steady_clock::now();
+
+            for (int i = 0; i < repeats; i++)
+                total += EvaluateExpression::execute(program, values);
+
+            double execute_ns = seconds_since(start) * 1e9 / (repeats * token_count);
+
+            std::cout << "  " << static_cast<std::size_t>(token_count) << " tokens" << std::endl;
+            report(scenario, "compile", compile_ns, "ns/token");
+            report(scenario, "execute", execute_ns, "ns/token");
+
+            if (smallest == 0)
+                smallest = compile_ns;
+
+            largest = compile_ns;
+        }
+
+        // linear parsing keeps the cost per token flat as the input grows a hundredfold
+        report(shape, "compile growth", largest / smallest, "largest/smallest ns/token");
+
+        if (error || total != total)
+            std::cout << "\t(unexpected result)" << std::endl;
+    }
+}
+
+
+/**
+ * @brief Compares evaluating a formula over arrays with building one expression string per element
+ */
+void Benchmark::columns()
+{
+    std::vector<double> x(COLUMN_SIZE);
+    std::vector<double> y(COLUMN_SIZE);
+    std::vector<double> out(COLUMN_SIZE);
+
+    for (std::size_t i = 0; i < COLUMN_SIZE; i++)
+    {
+        x[i] = i * 0.001;
+        y[i] = 1.0 / (i + 1);
+    }
+
+    std::cout << COLUMN_EXPRESSION << " over " << COLUMN_SIZE << " elements" << std::endl;
+
+    // one string per row with the values spelled out
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double total = 0;
+
+    for (std::size_t i = 0; i < COLUMN_SIZE; i++)
+    {
+        std::string x_text = std::to_string(x[i]);
+        std::string row = x_text + " * 2 + sin(" + x_text + ") / (1 + " + std::to_string(y[i]) + "^2)";
+
+        total += EvaluateExpression::execute(EvaluateExpression::compile(row));
+    }
+
+    double seconds = seconds_since(start);
+    report("columns", "string per row", COLUMN_SIZE / seconds, "elements/s");
+
+    // compiled once and run over the arrays
+    start = std::chrono::steady_clock::now();
+
+    Program program = EvaluateExpression::compile(COLUMN_EXPRESSION);
+    Error error = EvaluateExpression::execute(program, {{"x", x.data()}, {"y", y.data()}}, COLUMN_SIZE, out.data());
+
+    seconds = seconds_since(start);
+    report("columns", "arrays", COLUMN_SIZE / seconds, "elements/s");
+
+    if (error || total != total || out.back() != out.back())
+        std::cout << "\t(unexpected result)" << std::endl;
+}
+
+
+/**
+ * @brief Runs native code or the interpreter and describes the result exactly
+ * 
+ * @param jit native program, null for the interpreter
+ * @param program compiled expression
+ * @param variables values of x and y
+ * @return std::string result bits or error message
+ */
+std::string Benchmark::outcome(const JitProgram *jit, const Program &program, const double *variables)
+{
+    double result;
+    Error error = jit ? jit->execute(variables, result) : EvaluateExpression::execute(program, variables, result);
+
+    if (error)
+    {
+        std::string message;
+        EvaluateExpression::describe(error, {}, program, message);
+
+        return message + " at " + std::to_string(error.offset);
+    }
+
+    // every NaN counts as the same result
+    if (result != result)
+        return "nan";
+
+    std::uint64_t bits;
+    std::memcpy(&bits, &result, sizeof(bits));
+
+    return std::to_string(bits);
+}
+
+
+/**
+ * @brief Checks native code against the interpreter on random expressions and compares speed
+ */
+void Benchmark::jit()
+{
+    GeneratorConfig config;
+    config.terms = 3;
+    config.max_depth = 5;
+    config.bracket_share = 0.4;
+    config.function_share = 0.3;
+    config.power_share = 0.1;
+    config.unary_share = 0.2;
+    config.variables = true;
+
+    ExpressionGenerator generator(config);
+    const double points[][2] = {{0, 0}, {-0.0, 1}, {1.5, -2}, {-3, 0.25}, {100, 1e-3}};
+
+    int checked = 0;
+    int mismatches = 0;
+    bool native = false;
+
+    for (int i = 0; i < JIT_CORPUS; i++)
+    {
+        std::string expression = generator.next();
+        Program program;
+
+        if (EvaluateExpression::compile(expression, program))
+            continue;
+
+        JitProgram jit(program);
+        native = jit.compiled();
+
+        for (const double *point : points)
+        {
+            // variables in x, y order for every program
+            double variables[2];
+
+            for (std::size_t slot = 0; slot < program.variables.size(); slot++)
+                variables[slot] = point[program.variables[slot] == "x" ? 0 : 1];
+
+            checked++;
+
+            if (outcome(&jit, program, variables) != outcome(nullptr, program, variables))
+            {
+                if (mismatches++ < 5)
+                    std::cout << "\tmismatch: " << expression << std::endl;
+            }
+        }
+    }
+
+    std::cout << "jit " << (native ? "native" : "interpreter fallback") << ", " << checked << " evaluations" << std::endl;
+    report("jit", "mismatches", mismatches, "evaluations");
+
+    // per element speed over the array benchmark data
+    std::vector<double> x(COLUMN_SIZE);
+    std::vector<double> y(COLUMN_SIZE);
+    std::vector<double> out(COLUMN_SIZE);
+
+    for (std::size_t i = 0; i < COLUMN_SIZE; i++)
+    {
+        x[i] = i * 0.001;
+        y[i] = 1.0 / (i + 1);
+    }
+
+    Program program = EvaluateExpression::compile(COLUMN_EXPRESSION);
+    JitProgram jit(program);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < COLUMN_SIZE; i++)
+    {
+        double variables[2] = {x[i], y[i]};
+        out[i] = EvaluateExpression::execute(program, variables);
+    }
+
+    double seconds = seconds_since(start);
+    report("jit", "interpreter", COLUMN_SIZE / seconds, "elements/s");
+
+    start = std::chrono::steady_clock::now();
+    Error error = jit.execute({{"x", x.data()}, {"y", y.data()}}, COLUMN_SIZE, out.data());
+    seconds = seconds_since(start);
+
+    report("jit", "native", COLUMN_SIZE / seconds, "elements/s");
+
+    if (error)
+        std::cout << "\t(unexpected result)" << std::endl;
+}
+
+
+/**
+ * @brief Times every pipeline stage on synthetic corpora of different shapes
+ * 
+ * Stage times are taken by subtraction: tokenizing, then tokenizing and shunting yard,
+ * then the full compile, so each stage is timed over the same loop structure.
+ */
+void Benchmark::suite()
+{
+    std::map<std::string, GeneratorConfig> profiles;
+
+    profiles["short"].terms = 4;
+    profiles["short"].max_depth = 1;
+
+    profiles["long"].terms = 64;
+    profiles["long"].max_depth = 2;
+
+    profiles["deep"].terms = 3;
+    profiles["deep"].bracket_terms = 2;
+    profiles["deep"].max_depth = 12;
+    profiles["deep"].bracket_share = 0.6;
+
+    profiles["functions"].function_share = 0.5;
+    profiles["functions"].power_share = 0.2;
+
+    profiles["unary"].unary_share = 0.5;
+
+    for (const std::pair<const std::string, GeneratorConfig> &profile : profiles)
+    {
+        ExpressionGenerator generator(profile.second);
+        std::vector<std::string> corpus;
+
+        for (int i = 0; i < SUITE_CORPUS; i++)
+            corpus.push_back(generator.next());
+
+        std::vector<std::string> variables;
+        std::vector<Program> programs(corpus.size());
+        Error error;
+
+        // tokens in one pass over the corpus, and compiled programs for the execute stage
+        double token_count = 0;
+
+        for (std::size_t i = 0; i < corpus.size(); i++)
+        {
+            Arena::Scope scope;
+            ScratchVector<Token> tokens;
+
+            error = EvaluateExpression::get_tokens(corpus[i], tokens, variables);
+            token_count += tokens.size();
+
+            error = EvaluateExpression::compile(corpus[i], programs[i]);
+        }
+
+        std::cout << profile.first << ": " << token_count / corpus.size() << " tokens per expression" << std::endl;
+
+        double stage_seconds[3] = {0, 0, 0};
+        double execute_seconds = 0;
+        double total = 0;
+        int errors = 0;
+
+        Program program;
+
+        for (int pass = 0; pass < SUITE_PASSES; pass++)
+        {
+            for (int stage = 0; stage < 3; stage++)
+            {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+                for (const std::string &expression : corpus)
+                {
+                    Arena::Scope scope;
+                    ScratchVector<Token> tokens;
+
+                    if (stage < 2)
+                        error = EvaluateExpression::get_tokens(expression, tokens, variables);
+
+                    if (stage == 1)
+                        error = EvaluateExpression::shunting_yard(tokens, program);
+                    else if (stage == 2)
+                        error = EvaluateExpression::compile(expression, program);
+                }
+
+                stage_seconds[stage] += seconds_since(start);
+            }
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for (const Program &compiled : programs)
+            {
+                // random expressions overflow now and then, only finite results are summed
+                double value;
+
+                if (EvaluateExpression::execute(compiled, nullptr, value))
+                    errors++;
+                else if (std::isfinite(value))
+                    total += value;
+            }
+
+            execute_seconds += seconds_since(start);
+        }
+
+        double tokens_timed = token_count * SUITE_PASSES;
+
+        report(profile.first, "get_tokens", stage_seconds[0] * 1e9 / tokens_timed, "ns/token");
+        report(profile.first, "shunting_yard", (stage_seconds[1] - stage_seconds[0]) * 1e9 / tokens_timed, "ns/token");
+        report(profile.first, "optimize", (stage_seconds[2] - stage_seconds[1]) * 1e9 / tokens_timed, "ns/token");
+        report(profile.first, "execute", execute_seconds * 1e9 / tokens_timed, "ns/token");
+        report(profile.first, "math errors", static_cast<double>(errors) / SUITE_PASSES, "expressions");
+
+        // end to end through the text interface, buffers are warm after the first pass
+        std::string out;
+        out.reserve(1 << 20);
+
+        for (const std::string &expression : corpus)
+            EvaluateExpression::evaluate(expression, out);
+
+        std::size_t before = allocations;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (int pass = 0; pass < SUITE_PASSES; pass++)
+        {
+            out.clear();
+
+            for (const std::string &expression : corpus)
+                EvaluateExpression::evaluate(expression, out);
+        }
+
+        double seconds = seconds_since(start);
+        double evaluated = static_cast<double>(corpus.size()) * SUITE_PASSES;
+
+        report(profile.first, "allocations", (allocations - before) / evaluated, "per expression");
+        report(profile.first, "end to end", evaluated / seconds, "expressions/s");
+
+        if (error || total != total)
+            std::cout << "\t(unexpected result)" << std::endl;
+    }
+}
+
+
+/**
+ * @brief Compares throughput of malformed input through exceptions and through error codes
+ * 
+ * The exception path is the throwing compile and execute with a catch per expression,
+ * as evaluate worked before error codes. Both paths produce the same text.
+ */
+void Benchmark::invalid()
+{
+    GeneratorConfig config;
+    config.terms = 6;
+    config.max_depth = 2;
+
+    ExpressionGenerator generator(config);
+
+    // every expression malformed, and one in three as in user input
+    std::map<std::string, std::vector<std::string>> corpora;
+
+    for (int i = 0; i < INVALID_CORPUS; i++)
+    {
+        std::string expression = generator.next();
+
+        corpora["malformed"].push_back(expression + DEFECTS[i % DEFECTS.size()]);
+        corpora["mixed"].push_back(i % 3 == 0 ? corpora["malformed"].back() : expression);
+    }
+
+    for (const std::pair<const std::string, std::vector<std::string>> &corpus : corpora)
+    {
+        std::cout << corpus.first << " expressions" << std::endl;
+
+        std::string thrown;
+        std::string returned;
+        double seconds[2] = {0, 0};
+
+        for (int pass = 0; pass < INVALID_PASSES; pass++)
+        {
+            thrown.clear();
+            returned.clear();
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for (const std::string &expression : corpus.second)
+            {
+                try
+                {
+                    double value = EvaluateExpression::execute(EvaluateExpression::compile(expression));
+                    EvaluateExpression::format(value, FormatOptions(), thrown);
+                }
+                catch (const std::exception &e)
+                {
+                    thrown += "error: ";
+                    thrown += e.what();
+                }
+
+                thrown.push_back('\n');
+            }
+
+            seconds[0] += seconds_since(start);
+            start = std::chrono::steady_clock::now();
+
+            for (const std::string &expression : corpus.second)
+            {
+                EvaluateExpression::evaluate(expression, returned);
+                returned.push_back('\n');
+            }
+
+            seconds[1] += seconds_since(start);
+        }
+
+        double evaluated = static_cast<double>(corpus.second.size()) * INVALID_PASSES;
+
+        report(corpus.first, "exceptions", evaluated / seconds[0], "expressions/s");
+        report(corpus.first, "error codes", evaluated / seconds[1], "expressions/s");
+        report(corpus.first, "speedup", seconds[0] / seconds[1], "x");
+    }
+}
+
+
+/**
+ * @brief Compares writing results with to_string and endl against the to_chars formatter and one write
+ * 
+ * Output goes to /dev/null so only formatting and stream costs are measured. Shortest
+ * results are read back to check they round-trip.
+ */
+void Benchmark::formatting()
+{
+    // results of random expressions, the values the formatter sees in practice
+    GeneratorConfig config;
+    ExpressionGenerator generator(config);
+
+    std::vector<double> values;
+    Program program;
+
+    while (values.size() < FORMAT_VALUES)
+    {
+        double value;
+
+        if (!EvaluateExpression::compile(generator.next(), program) && !EvaluateExpression::execute(program, nullptr, value))
+            values.push_back(value);
+    }
+
+    std::cout << FORMAT_VALUES << " results" << std::endl;
+
+    std::ofstream null("/dev/null");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (double value : values)
+        null << std::to_string(value) << std::endl;
+
+    report("format", "to_string and endl", seconds_since(start) * 1e9 / values.size(), "ns/result");
+
+    const std::pair<std::string, FormatOptions> notations[] = {{"fixed", {Notation::FIXED, 6}},
+                                                               {"shortest", {Notation::SHORTEST, 0}},
+                                                               {"scientific", {Notation::SCIENTIFIC, 10}}};
+    std::string out;
+
+    for (const std::pair<std::string, FormatOptions> &notation : notations)
+    {
+        out.clear();
+        start = std::chrono::steady_clock::now();
+
+        for (double value : values)
+        {
+            EvaluateExpression::format(value, notation.second, out);
+            out.push_back('\n');
+        }
+
+        null.write(out.data(), out.size());
+        null.flush();
+
+        report("format", notation.first + " to_chars", seconds_since(start) * 1e9 / values.size(), "ns/result");
+    }
+
+    // shortest text must read back as the same double
+    std::size_t mismatches = 0;
+
+    for (double value : values)
+    {
+        out.clear();
+        EvaluateExpression::format(value, {Notation::SHORTEST, 0}, out);
+
+        double parsed;
+        std::from_chars(out.data(), out.data() + out.size(), parsed);
+
+        if (parsed != value && std::isfinite(value))
+            mismatches++;
+    }
+
+    report("format", "shortest round-trip mismatches", mismatches, "results");
+}
+
+
+/**
+ * @brief Compares changing one input of a formula sheet with evaluating the whole sheet again
+ * 
+ * Every column starts at its own input and each row uses the row above, so an input
+ * change dirties one column of the sheet.
+ */
+void Benchmark::formulas()
+{
+    // names are letters only
+    auto letters = [](std::size_t number)
+    {
+        std::string name;
+
+        do
+        {
+            name.push_back('a' + number % 26);
+            number /= 26;
+        } while (number > 0);
+
+        return name;
+    };
+
+    std::vector<std::string> sheet;
+
+    for (std::size_t column = 0; column < SHEET_COLUMNS; column++)
+        sheet.push_back("in_" + letters(column) + " = " + std::to_string(column + 1));
+
+    for (std::size_t row = 0; row < SHEET_ROWS; row++)
+    {
+        for (std::size_t column = 0; column < SHEET_COLUMNS; column++)
+        {
+            std::string above = (row == 0) ? "in_" + letters(column) : "c_" + letters(column) + "_" + letters(row - 1);
+
+            sheet.push_back("c_" + letters(column) + "_" + letters(row) + " = " + above + " * 1.01 + sin(in_" +
+                            letters(column) + ") / 100");
+        }
+    }
+
+    std::cout << sheet.size() << " formulas in " << SHEET_COLUMNS << " columns" << std::endl;
+
+    // every formula evaluated once, as when the whole sheet is sent again
+    std::string out;
+    bool failed = false;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int pass = 0; pass < SHEET_PASSES; pass++)
+    {
+        FormulaGraph fresh;
+
+        for (const std::string &line : sheet)
+        {
+            out.clear();
+            failed |= !fresh.evaluate(line, out);
+        }
+    }
+
+    double full = seconds_since(start) / SHEET_PASSES;
+    report("formulas", "whole sheet", full * 1e6, "us");
+
+    FormulaGraph graph;
+
+    for (const std::string &line : sheet)
+    {
+        out.clear();
+        failed |= !graph.evaluate(line, out);
+    }
+
+    std::size_t recomputed = 0;
+    std::size_t total = 0;
+    start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < SHEET_UPDATES; i++)
+    {
+        std::string text = std::to_string(i % 10);
+        Program program;
+
+        failed |= static_cast<bool>(EvaluateExpression::compile(text, program));
+        failed |= static_cast<bool>(graph.define("in_" + letters(i % SHEET_COLUMNS), text, std::move(program), recomputed));
+        total += recomputed;
+    }
+
+    double update = seconds_since(start) / SHEET_UPDATES;
+
+    report("formulas", "one input changed", update * 1e6, "us");
+    report("formulas", "recomputed", static_cast<double>(total) / SHEET_UPDATES, "formulas per change");
+    report("formulas", "speedup", full / update, "x");
+
+    if (failed)
+        std::cout << "\t(unexpected result)" << std::endl;
+}
+
+
+/**
+ * @brief Measures how much sharing repeated subterms shrinks programs and speeds them up
+ * 
+ * Every expression repeats one random subterm of x and y a dozen times, written as is,
+ * negated or in brackets, between other random terms. Shared programs are checked against
+ * the unshared ones in the interpreter, over arrays and as native code.
+ */
+void Benchmark::cse()
+{
+    GeneratorConfig config;
+    config.terms = 4;
+    config.max_depth = 2;
+    config.function_share = 0.3;
+    config.variables = true;
+
+    ExpressionGenerator generator(config);
+
+    std::vector<Program> plain(CSE_CORPUS);
+    std::vector<Program> shared(CSE_CORPUS);
+    double plain_size = 0;
+    double shared_size = 0;
+    int mismatches = 0;
+
+    const char *forms[] = {"(%)", "-(%)", "{%}"};
+    const double variables[] = {0.75, 1.25};
+
+    for (int i = 0; i < CSE_CORPUS; i++)
+    {
+        std::string repeated = generator.next();
+        std::string expression = generator.next();
+
+        for (int copy = 0; copy < CSE_COPIES; copy++)
+        {
+            std::string form = forms[copy % 3];
+            form.replace(form.find('%'), 1, repeated);
+
+            expression += (copy % 2 == 0 ? " + " : " * ") + form;
+        }
+
+        // same program without sharing
+        Error error;
+
+        {
+            Arena::Scope scope;
+            ScratchVector<Token> tokens;
+
+            error = EvaluateExpression::get_tokens(expression, tokens, plain[i].variables);
+
+            if (!error)
+                error = EvaluateExpression::shunting_yard(tokens, plain[i]);
+        }
+
+        if (!error)
+            error = EvaluateExpression::compile(expression, shared[i]);
+
+        if (error)
+        {
+            mismatches++;
+            continue;
+        }
+
+        EvaluateExpression::optimize(plain[i]);
+
+        plain_size += plain[i].code.size();
+        shared_size += shared[i].code.size();
+
+        double expected;
+        double result;
+        Error expected_error = EvaluateExpression::execute(plain[i], variables, expected);
+        error = EvaluateExpression::execute(shared[i], variables, result);
+
+        JitProgram jit(shared[i]);
+        double native;
+        Error native_error = jit.execute(variables, native);
+
+        double column;
+        std::vector<Binding> bindings;
+
+        for (std::size_t slot = 0; slot < shared[i].variables.size(); slot++)
+            bindings.push_back({shared[i].variables[slot], &variables[slot]});
+
+        Error column_error = EvaluateExpression::execute(shared[i], bindings, 1, &column);
+
+        // bit for bit, and every NaN counts as the same result
+        auto equal = [](double first, double second)
+        {
+            return (first != first && second != second) || std::memcmp(&first, &second, sizeof(first)) == 0;
+        };
+
+        bool same = expected_error.code == error.code && native_error.code == error.code && column_error.code == error.code &&
+                    (error || (equal(expected, result) && equal(result, native) && equal(result, column)));
+
+        if (!same && mismatches++ < 5)
+            std::cout << "\tmismatch: " << expression << std::endl;
+    }
+
+    std::cout << CSE_CORPUS << " expressions, " << CSE_COPIES << " copies of one subterm each" << std::endl;
+    report("cse", "instructions", plain_size / CSE_CORPUS, "per unshared program");
+    report("cse", "compression", plain_size / shared_size, "unshared/shared instructions");
+    report("cse", "mismatches", mismatches, "expressions");
+
+    double seconds[2] = {0, 0};
+    double total = 0;
+
+    for (int pass = 0; pass < CSE_PASSES; pass++)
+    {
+        for (int kind = 0; kind < 2; kind++)
+        {
+            const std::vector<Program> &programs = (kind == 0) ? plain : shared;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for (const Program &program : programs)
+            {
+                double value;
+
+                if (!EvaluateExpression::execute(program, variables, value) && std::isfinite(value))
+                    total += value;
+            }
+
+            seconds[kind] += seconds_since(start);
+        }
+    }
+
+    report("cse", "unshared execute", seconds[0] * 1e9 / (CSE_CORPUS * CSE_PASSES), "ns/expression");
+    report("cse", "shared execute", seconds[1] * 1e9 / (CSE_CORPUS * CSE_PASSES), "ns/expression");
+    report("cse", "speedup", seconds[0] / seconds[1], "x");
+
+    if (total != total)
+        std::cout << "\t(unexpected result)" << std::endl;
+}
+
+
+/**
+ * @brief Measures the parsing compile-time programs save
+ * 
+ * The formula is evaluated per request with compile and execute, and as a constexpr program
+ * that only binds its variables.
+ */
+void Benchmark::static_programs()
+{
+    // parsed, folded and checked by the compiler
+    constexpr auto formula = calc::compile("x * 2 + sin(x) / (1 + y^2)");
+
+    Program program;
+
+    // the same formula compiled per request and bound to a constexpr program
+    std::cout << COLUMN_EXPRESSION << std::endl;
+
+    double total = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        double value;
+        const double values[] = {i * 1e-5, 1.25};
+
+        if (!EvaluateExpression::compile(COLUMN_EXPRESSION, program) && !EvaluateExpression::execute(program, values, value))
+            total += value;
+    }
+
+    double runtime = seconds_since(start);
+    start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < ITERATIONS; i++)
+        total += formula(i * 1e-5, 1.25);
+
+    double constant = seconds_since(start);
+
+    report("static", "compile and execute", runtime * 1e9 / ITERATIONS, "ns/request");
+    report("static", "constexpr program", constant * 1e9 / ITERATIONS, "ns/request");
+    report("static", "speedup", runtime / constant, "x");
+
+    if (total != total)
+        std::cout << "\t(unexpected result)" << std::endl;
+}
+
+/**
+ * @brief Measures what reusing an evaluation context saves and checks contexts on several threads
+ * 
+ * A formula evaluated per request through one context compiles once and then only runs
+ * with new variables. Every thread then evaluates the corpus in a context of its own and
+ * must get the results of a single context.
+ */
+void Benchmark::contexts()
+{
+    std::cout << COLUMN_EXPRESSION << std::endl;
+
+    EvaluationContext context;
+    Program program;
+    double total = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        double value;
+        const double values[] = {i * 1e-5, 1.25};
+
+        if (!EvaluateExpression::compile(COLUMN_EXPRESSION, program) && !EvaluateExpression::execute(program, values, value))
+            total += value;
+    }
+
+    double fresh = seconds_since(start);
+    start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        const double values[] = {i * 1e-5, 1.25};
+        Result result = context.evaluate(COLUMN_EXPRESSION, values);
+
+        if (result)
+            total += result.value;
+    }
+
+    double reused = seconds_since(start);
+
+    report("context", "compile per call", fresh * 1e9 / ITERATIONS, "ns/request");
+    report("context", "reused context", reused * 1e9 / ITERATIONS, "ns/request");
+    report("context", "speedup", fresh / reused, "x");
+
+    GeneratorConfig config;
+    config.variables = true;
+
+    ExpressionGenerator generator(config);
+    std::vector<std::string> corpus(CONTEXT_CORPUS);
+    std::vector<Result> expected(CONTEXT_CORPUS);
+
+    const double variables[] = {0.75, 1.25};
+
+    for (int i = 0; i < CONTEXT_CORPUS; i++)
+    {
+        generator.next(corpus[i]);
+        expected[i] = context.evaluate(corpus[i], variables);
+    }
+
+    std::size_t threads = std::max(2u, std::thread::hardware_concurrency());
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> workers;
+
+    start = std::chrono::steady_clock::now();
+
+    for (std::size_t t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&]()
+        {
+            EvaluationContext local;
+
+            for (int pass = 0; pass < CONTEXT_PASSES; pass++)
+            {
+                for (int i = 0; i < CONTEXT_CORPUS; i++)
+                {
+                    Result result = local.evaluate(corpus[i], variables);
+
+                    bool same = result.error.code == expected[i].error.code &&
+                                (result.error || (result.value != result.value && expected[i].value != expected[i].value) ||
+                                 std::memcmp(&result.value, &expected[i].value, sizeof(double)) == 0);
+
+                    if (!same)
+                        mismatches++;
+                }
+            }
+        });
+    }
+
+    for (std::thread &worker : workers)
+        worker.join();
+
+    double seconds = seconds_since(start);
+
+    std::cout << threads << " threads, " << CONTEXT_CORPUS << " expressions" << std::endl;
+    report("context", "throughput", threads * CONTEXT_CORPUS * CONTEXT_PASSES / seconds, "expressions/s");
+    report("context", "mismatches", mismatches, "expressions");
+
+    if (total != total)
+        std::cout << "\t(unexpected result)" << std::endl;
+}
+
+
+/**
+ * @brief Counts allocator calls per evaluation and shows the arena of a thread following its inputs
+ * 
+ * Steady state evaluation should make no heap allocations and add no arena chunks, on one
+ * thread or many. A thread that evaluates one very large expression keeps a chunk large
+ * enough for it while such inputs are recent and shrinks back after many small ones.
+ */
+void Benchmark::arena()
+{
+    GeneratorConfig config;
+    ExpressionGenerator generator(config);
+    std::vector<std::string> corpus(ARENA_CORPUS);
+
+    for (int i = 0; i < ARENA_CORPUS; i++)
+        generator.next(corpus[i]);
+
+    std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+
+    for (std::size_t threads = 1; threads <= cores; threads *= 2)
+    {
+        std::vector<std::thread> workers;
+        std::atomic<std::size_t> warm{0};
+        std::atomic<bool> recorded{false};
+        std::atomic<std::size_t> steady_allocations{0};
+        std::atomic<std::uint64_t> steady_chunks{0};
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (std::size_t t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&]()
+            {
+                std::string out;
+                out.reserve(64);
+
+                for (int pass = 0; pass < ARENA_PASSES; pass++)
+                {
+                    // after the first pass every buffer has seen the whole corpus
+                    if (pass == 1)
+                    {
+                        if (++warm == threads)
+                        {
+                            steady_allocations = allocations.load();
+                            steady_chunks = Arena::snapshot().chunks;
+                            recorded = true;
+                        }
+
+                        while (!recorded)
+                            ;
+                    }
+
+                    for (const std::string &expression : corpus)
+                    {
+                        out.clear();
+                        EvaluateExpression::evaluate(expression, out);
+                    }
+                }
+            });
+        }
+
+        for (std::thread &worker : workers)
+            worker.join();
+
+        double seconds = seconds_since(start);
+        double steady = static_cast<double>(threads * ARENA_CORPUS * (ARENA_PASSES - 1));
+        std::string scenario = std::to_string(threads) + " threads";
+
+        std::cout << scenario << ", " << ARENA_CORPUS << " expressions" << std::endl;
+
+        report(scenario, "throughput", threads * ARENA_CORPUS * ARENA_PASSES / seconds, "expressions/s");
+        report(scenario, "heap allocations", (allocations - steady_allocations) / steady, "per expression");
+        report(scenario, "arena chunks", (Arena::snapshot().chunks - steady_chunks) / steady, "per expression");
+
+        if (threads < cores && threads * 2 > cores)
+            threads = cores / 2;
+    }
+
+    std::cout << "arena capacity of one thread" << std::endl;
+
+    // a fresh thread has a fresh arena
+    std::thread([&]()
+    {
+        std::string out;
+        std::string large = shaped("flat", ARENA_LARGE);
+        Arena &local = Arena::local();
+
+        for (const std::string &expression : corpus)
+        {
+            out.clear();
+            EvaluateExpression::evaluate(expression, out);
+        }
+
+        report("adaptive", "small inputs", local.capacity() / 1024.0, "KB");
+
+        out.clear();
+        EvaluateExpression::evaluate(large, out);
+        report("adaptive", "after " + std::to_string(ARENA_LARGE) + " tokens", local.capacity() / 1024.0, "KB");
+
+        for (const std::string &expression : corpus)
+        {
+            out.clear();
+            EvaluateExpression::evaluate(expression, out);
+        }
+
+        report("adaptive", "small inputs again", local.capacity() / 1024.0, "KB");
+    }).join();
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    report("process", "most arena memory", Arena::snapshot().peak_capacity / 1024.0, "KB");
+    report("process", "peak RSS", usage.ru_maxrss, "KB");
+}
+
+
+/**
+ * @brief Checks the vector kernels of every instruction set against extended precision and times them
+ * 
+ * Trigonometric arguments cover small and large ranges, the doubles closest to multiples of
+ * pi/2 where the argument reduction cancels most, tiny values and values beyond the reduced
+ * range. Logarithm arguments cover every exponent and the neighbourhood of 1. libm is
+ * measured the same way as the scalar kernels.
+ */
+void Benchmark::simd()
+{
+    std::mt19937_64 rng(20);
+    std::uniform_real_distribution<double> unit(0, 1);
+
+    std::vector<double> angles;
+    std::vector<double> positives;
+
+    for (std::size_t i = 0; i < SIMD_SAMPLES; i++)
+    {
+        angles.push_back(unit(rng) * 20 - 10);
+        angles.push_back((unit(rng) < 0.5 ? -1 : 1) * std::ldexp(1.0, -30 + static_cast<int>(unit(rng) * 51)) * (1 + unit(rng)));
+        angles.push_back(std::nearbyint(unit(rng) * 1300000) * 1.5707963267948966192313216916397514L);
+        angles.push_back(std::nextafter(angles.back(), 0.0));
+        angles.push_back(std::ldexp(unit(rng), -40));
+
+        positives.push_back(std::ldexp(0.5 + unit(rng) / 2, static_cast<int>(unit(rng) * 2044) - 1021));
+        positives.push_back(1 + (unit(rng) - 0.5) * 1e-3);
+        positives.push_back(unit(rng) * 1000);
+    }
+
+    const double infinity = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    for (double special : {0.0, -0.0, 1e7, -1e300, infinity, -infinity, nan})
+        angles.push_back(special);
+
+    for (double special : {0.0, 1.0, 10.0, 0x1p-1074, 0x1p-1030, infinity, nan, -1.0})
+        positives.push_back(special);
+
+    // kernel, arguments and extended precision reference of every function
+    struct Function
+    {
+        const char *name;
+        void (*MathKernels::*kernel)(double*, std::size_t);
+        const std::vector<double> *arguments;
+        long double (*exact)(long double);
+    };
+
+    const Function functions[] = {{"sin", &MathKernels::sin, &angles, sinl},
+                                  {"cos", &MathKernels::cos, &angles, cosl},
+                                  {"tan", &MathKernels::tan, &angles, tanl},
+                                  {"cot", &MathKernels::cot, &angles, [](long double x) { return 1 / tanl(x); }},
+                                  {"log", &MathKernels::log, &positives, log10l},
+                                  {"ln", &MathKernels::ln, &positives, logl}};
+
+    std::vector<double> values;
+    std::vector<double> timed(SIMD_ELEMENTS);
+
+    for (int target = 0; target < static_cast<int>(SimdTarget::COUNT); target++)
+    {
+        const MathKernels *kernels = VectorMath::kernels(static_cast<SimdTarget>(target));
+        std::string name = VectorMath::name(static_cast<SimdTarget>(target));
+
+        if (kernels == nullptr)
+        {
+            std::cout << name << ": not supported" << std::endl;
+            continue;
+        }
+
+        std::cout << name << (static_cast<SimdTarget>(target) == VectorMath::target() ? " (selected)" : "") << std::endl;
+
+        for (const Function &function : functions)
+        {
+            values = *function.arguments;
+            (kernels->*function.kernel)(values.data(), values.size());
+
+            double worst = 0;
+
+            for (std::size_t i = 0; i < values.size(); i++)
+                worst = std::max(worst, ulps(values[i], function.exact((*function.arguments)[i])));
+
+            // typical arguments: angles within a few turns, positive values up to a thousand
+            std::mt19937_64 typical(20);
+
+            for (std::size_t i = 0; i < SIMD_ELEMENTS; i++)
+                timed[i] = function.arguments == &angles ? unit(typical) * 20 - 10 : unit(typical) * 1000;
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            // blocks of the size the array executor uses, applied in a buffer that stays in cache
+            double block[256];
+            double total = 0;
+
+            for (int pass = 0; pass < SIMD_PASSES; pass++)
+            {
+                for (std::size_t first = 0; first < SIMD_ELEMENTS; first += 256)
+                {
+                    std::size_t n = std::min<std::size_t>(256, SIMD_ELEMENTS - first);
+                    std::copy(timed.begin() + first, timed.begin() + first + n, block);
+                    (kernels->*function.kernel)(block, n);
+                    total += block[0];
+                }
+            }
+
+            double seconds = seconds_since(start);
+
+            report(name + " " + function.name, std::string(function.name) + " max error", worst, "ulp");
+            report(name + " " + function.name, std::string(function.name) + " throughput", SIMD_ELEMENTS * SIMD_PASSES / seconds, "elements/s");
+
+            if (total != total)
+                std::cout << "\t(unexpected result)" << std::endl;
+        }
+    }
+}
+
+
+/**
+ * @brief Streams generated expressions through the batch reader and through the pipeline
+ * 
+ * Both read the same file and write to /dev/null. A stream several times as long is sent through
+ * a pipe to show that the buffers of the pipeline do not grow with the length of the stream.
+ */
+void Benchmark::pipeline()
+{
+    GeneratorConfig config;
+    ExpressionGenerator generator(config);
+    std::string text;
+    std::string line;
+
+    for (std::size_t i = 0; i < PIPELINE_LINES; i++)
+    {
+        generator.next(line);
+        text += line;
+        text.push_back('\n');
+    }
+
+    char path[] = "/tmp/calc_pipeline_XXXXXX";
+    int file = ::mkstemp(path);
+
+    if (file < 0 || ::write(file, text.data(), text.size()) != static_cast<ssize_t>(text.size()))
+    {
+        std::cerr << "could not write " << path << std::endl;
+        return;
+    }
+
+    ::close(file);
+
+    std::cout << "stream of " << PIPELINE_LINES << " lines" << std::endl;
+
+    // batch input writes to stdout, which goes to /dev/null while it runs
+    int null = ::open("/dev/null", O_WRONLY);
+    int saved = ::dup(STDOUT_FILENO);
+
+    std::cout.flush();
+    std::fflush(stdout);
+    ::dup2(null, STDOUT_FILENO);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    (void) BatchInput::run(path, 1, 0, FormatOptions());
+    double batch = seconds_since(start);
+
+    std::fflush(stdout);
+    ::dup2(saved, STDOUT_FILENO);
+    ::close(saved);
+
+    std::FILE *sink = ::fdopen(null, "w");
+
+    Pipeline timed((FormatOptions()));
+    int input = ::open(path, O_RDONLY);
+
+    start = std::chrono::steady_clock::now();
+    PipelineMetrics metrics = timed.process(input, sink);
+    double piped = seconds_since(start);
+
+    ::close(input);
+
+    report("pipeline", "batch input", PIPELINE_LINES / batch, "lines/s");
+    report("pipeline", "four stages", PIPELINE_LINES / piped, "lines/s");
+    report("pipeline", "speedup", batch / piped, "x");
+
+    for (std::size_t i = 0; i < static_cast<std::size_t>(PipelineStage::COUNT); i++)
+    {
+        std::string stage = Pipeline::name(static_cast<PipelineStage>(i));
+        const QueueMetrics &queue = metrics.queues[i];
+
+        report("pipeline", stage + " busy", 100.0 * metrics.stages[i].busy / (piped * 1e9), "%");
+        report("pipeline", stage + " input queue", static_cast<double>(queue.total) / std::max<std::uint64_t>(1, queue.samples),
+               "batches");
+    }
+
+    // a long stream from a pipe, the way unbounded stdin arrives
+    int ends[2];
+
+    if (::pipe(ends) != 0)
+    {
+        std::cerr << "could not create pipe" << std::endl;
+        std::fclose(sink);
+        ::unlink(path);
+        return;
+    }
+
+    std::thread producer([&]()
+    {
+        for (int i = 0; i < PIPELINE_REPEATS; i++)
+        {
+            for (std::size_t sent = 0; sent < text.size();)
+            {
+                ssize_t length = ::write(ends[1], text.data() + sent, text.size() - sent);
+
+                if (length <= 0)
+                    break;
+
+                sent += length;
+            }
+        }
+
+        ::close(ends[1]);
+    });
+
+    Pipeline streamed((FormatOptions()));
+    PipelineMetrics long_stream = streamed.process(ends[0], sink);
+
+    producer.join();
+    ::close(ends[0]);
+
+    report("pipeline", "buffers after " + std::to_string(metrics.lines) + " lines", metrics.buffer_bytes / 1024.0, "KB");
+    report("pipeline", "buffers after " + std::to_string(long_stream.lines) + " lines", long_stream.buffer_bytes / 1024.0, "KB");
+
+    std::fclose(sink);
+    ::unlink(path);
+}
+
+
+/**
+ * @brief Evaluates one expression of a million bracketed terms sequentially and on thread pools
+ * 
+ * Results must be bit-identical to the sequential interpreter on every thread count, and a
+ * failing term in the middle must report the same error.
+ */
+void Benchmark::parallel()
+{
+    GeneratorConfig config;
+    config.terms = 3;
+    config.max_depth = 2;
+    config.function_share = 0.3;
+    config.variables = true;
+
+    ExpressionGenerator generator(config);
+    std::string expression;
+    std::string term;
+    Program program;
+    double value;
+
+    // variables keep the terms from folding into constants, x and y are equal since their slots differ between terms
+    const double values[] = {0.5, 0.5};
+
+    // only terms that evaluate, so the whole sum does too
+    for (std::size_t i = 0; i < PARALLEL_TERMS;)
+    {
+        generator.next(term);
+
+        if (EvaluateExpression::compile(term, program) || EvaluateExpression::execute(program, values, value) || !std::isfinite(value))
+            continue;
+
+        if (i > 0)
+            expression += i % 2 == 0 ? " + " : " - ";
+
+        expression += "(" + term + ")";
+        i++;
+    }
+
+    std::cout << "sum of " << PARALLEL_TERMS << " terms, " << expression.size() / (1 << 20) << " MB" << std::endl;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Error error = EvaluateExpression::compile(expression, program);
+    report("parallel", "compile", seconds_since(start) * 1e3, "ms");
+
+    start = std::chrono::steady_clock::now();
+    ParallelProgram parallel(program);
+    report("parallel", "split", seconds_since(start) * 1e3, "ms");
+    report("parallel", "terms", parallel.terms(), "subtrees");
+    report("parallel", "tasks", parallel.tasks(), "tasks");
+
+    double sequential_result = 0;
+    double sequential = std::numeric_limits<double>::infinity();
+
+    for (int pass = 0; pass < PARALLEL_PASSES; pass++)
+    {
+        start = std::chrono::steady_clock::now();
+        error = EvaluateExpression::execute(program, values, sequential_result);
+        sequential = std::min(sequential, seconds_since(start));
+    }
+
+    report("parallel", "sequential execute", sequential * 1e3, "ms");
+
+    // the skeleton runs on the calling thread after the waves and bounds the speedup
+    double skeleton = std::numeric_limits<double>::infinity();
+
+    {
+        Arena::Scope scope;
+        double *stack = scope.allocate<double>(parallel.skeleton.stack_size + parallel.skeleton.temporaries);
+        std::fill(stack, stack + parallel.skeleton.stack_size + parallel.skeleton.temporaries, 1.0);
+
+        for (int pass = 0; pass < PARALLEL_PASSES; pass++)
+        {
+            const Instruction *code = parallel.skeleton.code.data();
+
+            start = std::chrono::steady_clock::now();
+            (void) EvaluateExpression::run(code, code + parallel.skeleton.code.size(), nullptr, stack,
+                                           stack + parallel.skeleton.stack_size, value);
+            skeleton = std::min(skeleton, seconds_since(start));
+        }
+    }
+
+    report("parallel", "skeleton", skeleton * 1e3, "ms");
+    report("parallel", "speedup bound", sequential / skeleton, "x");
+
+    std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t mismatches = error ? 1 : 0;
+
+    for (std::size_t threads = 1; threads <= cores; threads *= 2)
+    {
+        ThreadPool pool(threads);
+        double best = std::numeric_limits<double>::infinity();
+
+        for (int pass = 0; pass < PARALLEL_PASSES; pass++)
+        {
+            double result = 0;
+
+            start = std::chrono::steady_clock::now();
+            Error failure = parallel.execute(&pool, values, result);
+            best = std::min(best, seconds_since(start));
+
+            // same bits as the sequential interpreter, whatever the thread count
+            if (failure || std::memcmp(&result, &sequential_result, sizeof(double)) != 0)
+                mismatches++;
+        }
+
+        report("parallel", std::to_string(threads) + " threads", best * 1e3, "ms");
+        report("parallel", std::to_string(threads) + " threads speedup", sequential / best, "x");
+
+        // include the core count itself when it is not a power of two
+        if (threads < cores && threads * 2 > cores)
+            threads = cores / 2;
+    }
+
+    report("parallel", "mismatches", mismatches, "runs");
+
+    // a division by zero halfway through is the first error in both
+    std::size_t middle = expression.size() / 2;
+    middle = expression.find(" + ", middle);
+    expression.insert(middle, " + 1 / (3 - 3)");
+
+    Error expected = EvaluateExpression::compile(expression, program);
+    double ignored;
+
+    if (!expected)
+        expected = EvaluateExpression::execute(program, values, ignored);
+
+    ThreadPool pool(cores);
+    Error actual = ParallelProgram(program).execute(&pool, values, ignored);
+
+    report("parallel", "error mismatches", actual.code != expected.code || actual.offset != expected.offset, "errors");
+}
+
+
+/**
+ * @brief Compares the cold start of a formula file parsed as text with a precompiled store
+ * 
+ * A cold start reads every formula and evaluates each once. Parsing compiles the text into
+ * programs, the store is mapped, checked and executed in place.
+ */
+void Benchmark::store()
+{
+    GeneratorConfig config;
+    config.variables = true;
+
+    ExpressionGenerator generator(config);
+    std::string text;
+    std::string line;
+
+    std::vector<std::string> names(STORE_FORMULAS);
+
+    // names are letters only, every tenth formula has a syntax error
+    for (std::size_t i = 0; i < STORE_FORMULAS; i++)
+    {
+        for (std::size_t rest = i; rest > 0 || names[i].empty(); rest /= 26)
+            names[i].insert(names[i].begin(), static_cast<char>('a' + rest % 26));
+
+        generator.next(line);
+        text += "f" + names[i] + " = " + line + (i % 10 == 9 ? " * (1 +" : "") + "\n";
+    }
+
+    char formulas[] = "/tmp/calc_formulas_XXXXXX";
+    int file = ::mkstemp(formulas);
+
+    if (file < 0 || ::write(file, text.data(), text.size()) != static_cast<ssize_t>(text.size()))
+    {
+        std::cerr << "could not write " << formulas << std::endl;
+        return;
+    }
+
+    ::close(file);
+
+    std::string path = std::string(formulas) + ".store";
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    StoreStatus status = ProgramStore::precompile(formulas, path.c_str());
+    double precompile = seconds_since(start);
+
+    if (status != StoreStatus::OK)
+    {
+        std::cerr << "could not precompile: " << STORE_MESSAGES[static_cast<int>(status)] << std::endl;
+        ::unlink(formulas);
+        return;
+    }
+
+    struct stat info;
+    ::stat(path.c_str(), &info);
+
+    std::cout << STORE_FORMULAS << " formulas, " << text.size() / 1024 << " KB of text" << std::endl;
+
+    report("store", "precompile", precompile * 1e3, "ms");
+    report("store", "store size", info.st_size / 1024.0, "KB");
+
+    // x and y of every formula, in whatever order it reads them
+    const double values[] = {0.5, 0.5};
+
+    double parsed = std::numeric_limits<double>::infinity();
+    double mapped = std::numeric_limits<double>::infinity();
+    std::size_t parse_allocations = 0;
+    std::size_t store_allocations = 0;
+    std::vector<double> results(STORE_FORMULAS);
+    std::vector<Error> errors(STORE_FORMULAS);
+
+    for (int repeat = 0; repeat < STORE_REPEATS; repeat++)
+    {
+        std::size_t before = allocations;
+        start = std::chrono::steady_clock::now();
+
+        {
+            std::ifstream input(formulas);
+            std::vector<std::string> parsed_names;
+            std::vector<Program> programs;
+            std::size_t i = 0;
+
+            while (std::getline(input, line))
+            {
+                std::string_view name = line;
+                std::string_view expression = line;
+                EvaluateExpression::assignment(line, name, expression);
+
+                parsed_names.emplace_back(name);
+                programs.emplace_back();
+                errors[i] = EvaluateExpression::compile(expression, programs.back());
+
+                if (!errors[i])
+                    errors[i] = EvaluateExpression::execute(programs.back(), values, results[i]);
+
+                i++;
+            }
+        }
+
+        parsed = std::min(parsed, seconds_since(start));
+        parse_allocations = allocations - before;
+
+        before = allocations;
+        start = std::chrono::steady_clock::now();
+
+        {
+            ProgramStore store;
+            status = store.open(path.c_str());
+
+            for (std::size_t i = 0; i < store.size(); i++)
+                errors[i] = store.execute(i, values, results[i]);
+        }
+
+        mapped = std::min(mapped, seconds_since(start));
+        store_allocations = allocations - before;
+
+        if (repeat == 0)
+            report("store", "failed formulas", std::count_if(errors.begin(), errors.end(), [](const Error &error) { return bool(error); }),
+                   "formulas");
+    }
+
+    report("store", "parse text", parsed * 1e3, "ms");
+    report("store", "mapped store", mapped * 1e3, "ms");
+    report("store", "speedup", parsed / mapped, "x");
+    report("store", "parse allocations", static_cast<double>(parse_allocations) / STORE_FORMULAS, "per formula");
+    report("store", "store allocations", static_cast<double>(store_allocations) / STORE_FORMULAS, "per formula");
+
+    // checking the store against its formula file hashes the text as well
+    {
+        ProgramStore store;
+
+        start = std::chrono::steady_clock::now();
+        status = store.open(path.c_str(), formulas);
+        report("store", "open checked against source", seconds_since(start) * 1e3, "ms");
+    }
+
+    ::unlink(path.c_str());
+    ::unlink(formulas);
+}
+
+
+/**
+ * @brief Times function name lookup and compiling with the built in functions and after registering many natives
+ */
+void Benchmark::registry()
+{
+    // every function name and words the tokenizer looks up that are not functions
+    std::vector<std::string> words = {"x", "y", "sine", "lns", "maximum"};
+
+    // names a linear scan compares against, as the comparison chain the tokenizer used before
+    std::vector<std::string> known;
+
+    for (const FunctionEntry &entry : FUNCTIONS)
+        known.emplace_back(entry.name);
+
+    words.insert(words.end(), known.begin(), known.end());
+
+    GeneratorConfig config;
+    config.function_share = 0.3;
+    config.variables = true;
+
+    ExpressionGenerator generator(config);
+    std::vector<std::string> corpus(REGISTRY_CORPUS);
+
+    // generated terms inside natives with one and two arguments
+    for (std::string &expression : corpus)
+        expression = "max(" + generator.next() + ", sqrt(abs(" + generator.next() + "))) - exp(min(x, y))";
+
+    auto measure = [&](const std::string &table)
+    {
+        std::size_t found = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < REGISTRY_LOOKUPS; i++)
+            found += OperatorRegistry::find(words[i % words.size()]) != nullptr;
+
+        report("registry", "lookup " + table, seconds_since(start) * 1e9 / REGISTRY_LOOKUPS, "ns");
+
+        start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < REGISTRY_LOOKUPS; i++)
+            found += std::find(known.begin(), known.end(), words[i % words.size()]) != known.end();
+
+        report("registry", "linear scan " + table, seconds_since(start) * 1e9 / REGISTRY_LOOKUPS, "ns");
+
+        Program program;
+        std::size_t failed = 0;
+        start = std::chrono::steady_clock::now();
+
+        for (const std::string &expression : corpus)
+            failed += bool(EvaluateExpression::compile(expression, program));
+
+        report("registry", "compile " + table, REGISTRY_CORPUS / seconds_since(start), "expressions/s");
+
+        if (found == 0 || failed == REGISTRY_CORPUS)
+            std::cout << "\tnothing found" << std::endl;
+    };
+
+    measure("built in");
+
+    std::size_t rejected = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // letter names as the tokenizer reads them, alternating arity
+    for (std::size_t i = 0; i < REGISTRY_NATIVES; i++)
+    {
+        std::string name = "native";
+
+        for (std::size_t rest = i; rest > 0 || name.size() == 6; rest /= 26)
+            name += static_cast<char>('a' + rest % 26);
+
+        NativeFunction function = i % 2 ? [](const double *operands) { return operands[0] - operands[1]; }
+                                         : [](const double *operands) { return operands[0] * 2; };
+
+        if (!OperatorRegistry::add(name, 1 + i % 2, function) && OperatorRegistry::find(name) == nullptr)
+            rejected++;
+
+        known.push_back(name);
+    }
+
+    report("registry", "registration", seconds_since(start) * 1e6 / REGISTRY_NATIVES, "us per function");
+    report("registry", "rejected registrations", rejected, "functions");
+
+    measure("registered");
+}
+
+
+/**
+ * @brief Evaluates an expression file in a child process, whole or streamed, so its peak memory is its own
+ * 
+ * @param path expression file
+ * @param streamed read through StreamParser instead of into one string for evaluate
+ * @param seconds receives the time from opening the file to the result
+ * @param growth receives the peak resident memory above what the child started with, in KB
+ * @return std::string result or error message, empty when the child failed
+ */
+std::string Benchmark::isolated(const std::string &path, bool streamed, double &seconds, double &growth)
+{
+    int channel[2];
+
+    if (::pipe(channel) != 0)
+        return {};
+
+    pid_t child = ::fork();
+
+    if (child == 0)
+    {
+        ::close(channel[0]);
+
+        long size = 0;
+        long resident = 0;
+        std::ifstream("/proc/self/statm") >> size >> resident;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::string out;
+
+        if (streamed)
+        {
+            std::FILE *input = std::fopen(path.c_str(), "rb");
+            std::vector<char> chunk(STREAM_CHUNK);
+            std::size_t length;
+            StreamParser parser;
+
+            while ((length = std::fread(chunk.data(), 1, chunk.size(), input)) > 0)
+                (void) parser.feed(std::string_view(chunk.data(), length));
+
+            (void) parser.finish(out);
+            std::fclose(input);
+        }
+        else
+        {
+            std::ifstream input(path, std::ios::binary);
+            std::string text((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+            EvaluateExpression::evaluate(text, out);
+        }
+
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+
+        double measured[] = {seconds_since(start), usage.ru_maxrss - resident * (::sysconf(_SC_PAGESIZE) / 1024.0)};
+        bool sent = ::write(channel[1], measured, sizeof(measured)) == sizeof(measured) &&
+                    ::write(channel[1], out.data(), out.size()) == static_cast<ssize_t>(out.size());
+
+        ::_exit(sent ? 0 : 1);
+    }
+
+    ::close(channel[1]);
+
+    double measured[2] = {0, 0};
+    std::string out;
+    char buffer[256];
+    ssize_t length = ::read(channel[0], measured, sizeof(measured));
+
+    while ((length = ::read(channel[0], buffer, sizeof(buffer))) > 0)
+        out.append(buffer, length);
+
+    ::close(channel[0]);
+
+    int status = 0;
+
+    if (child < 0 || ::waitpid(child, &status, 0) != child || status != 0)
+        return {};
+
+    seconds = measured[0];
+    growth = measured[1];
+
+    return out;
+}
+
+
+/**
+ * @brief Compares evaluating a large expression from one string with streaming it through StreamParser,
+ * in time and peak memory
+ */
+void Benchmark::streaming()
+{
+    // sums and differences only, longer mixes of every operator almost surely divide by zero somewhere
+    GeneratorConfig config;
+    config.bracket_share = 0.3;
+    config.function_share = 0;
+    config.power_share = 0;
+    config.product_share = 0;
+    config.unary_share = 0.2;
+
+    ExpressionGenerator generator(config);
+    std::string flat;
+    std::string line;
+
+    while (flat.size() < STREAM_BYTES)
+    {
+        generator.next(line);
+        flat += flat.empty() ? line : " + " + line;
+    }
+
+    // memory of the stream grows with nesting, so the nested expression needs more of it
+    std::string nested;
+
+    for (std::size_t i = 0; i < STREAM_LEVELS; i++)
+        nested += "(1.5+";
+
+    nested += "1";
+    nested.append(STREAM_LEVELS, ')');
+
+    for (const std::pair<const char*, std::string*> &shape : {std::make_pair("flat", &flat), std::make_pair("nested", &nested)})
+    {
+        char path[] = "/tmp/calc_stream_XXXXXX";
+        int file = ::mkstemp(path);
+        const std::string &text = *shape.second;
+
+        if (file < 0 || ::write(file, text.data(), text.size()) != static_cast<ssize_t>(text.size()))
+        {
+            std::cerr << "could not write " << path << std::endl;
+            return;
+        }
+
+        ::close(file);
+
+        std::string scenario = std::string("stream ") + shape.first;
+        std::cout << shape.first << " expression, " << text.size() / 1024 << " KB" << std::endl;
+
+        double whole_seconds = 0;
+        double whole_growth = 0;
+        double stream_seconds = 0;
+        double stream_growth = 0;
+
+        std::string whole = isolated(path, false, whole_seconds, whole_growth);
+        std::string streamed = isolated(path, true, stream_seconds, stream_growth);
+
+        std::cout << "	result: " << streamed << std::endl;
+        report(scenario, "mismatches", whole.empty() || whole != streamed, "results");
+        report(scenario, "whole text", whole_seconds * 1e3, "ms");
+        report(scenario, "streamed", stream_seconds * 1e3, "ms");
+        report(scenario, "whole text memory", whole_growth / 1024, "MB");
+        report(scenario, "streamed memory", stream_growth / 1024, "MB");
+
+        ::unlink(path);
+    }
+}
+
+/**
+ * @brief Runs evaluation benchmarks
+ * 
+ * @param argc number of arguments
+ * @param argv names of sections to run (default all) and "--out file" for CSV results
+ * @return int zero, one for an unknown section or unwritable results file
+ */
+int main(int argc, char *argv[])
+{
+    const std::map<std::string, void (*)()> sections = {{"stages", Benchmark::stages},
+                                                        {"scaling", Benchmark::scaling},
+                                                        {"parsing", Benchmark::parsing},
+                                                        {"columns", Benchmark::columns},
+                                                        {"jit", Benchmark::jit},
+                                                        {"suite", Benchmark::suite},
+                                                        {"invalid", Benchmark::invalid},
+                                                        {"format", Benchmark::formatting},
+                                                        {"formulas", Benchmark::formulas},
+                                                        {"cse", Benchmark::cse},
+                                                        {"static", Benchmark::static_programs},
+                                                        {"context", Benchmark::contexts},
+                                                        {"arena", Benchmark::arena},
+                                                        {"simd", Benchmark::simd},
+                                                        {"pipeline", Benchmark::pipeline},
+                                                        {"parallel", Benchmark::parallel},
+                                                        {"store", Benchmark::store},
+                                                        {"registry", Benchmark::registry},
+                                                        {"streaming", Benchmark::streaming}};
+
+    std::vector<std::string> selected;
+    std::string out;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--out" && i + 1 < argc)
+            out = argv[++i];
+        else
+            selected.push_back(argv[i]);
+    }
+
+    if (selected.size() == 0)
+    {
+        for (const std::pair<const std::string, void (*)()> &section : sections)
+            selected.push_back(section.first);
+    }
+
+    for (const std::string &name : selected)
+    {
+        if (sections.find(name) == sections.end())
+        {
+            std::cerr << "unknown benchmark: " << name << std::endl;
+            return 1;
+        }
+
+        sections.at(name)();
+    }
+
+    if (out.size() > 0 && !Benchmark::save(out))
+    {
+        std::cerr << "could not write results: " << out << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
\ No newline at end of file
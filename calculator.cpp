@@ -1,13 +1,103 @@
 #include "handle_input.h"
+#include "batch_input.h"
+#include "pipeline.h"
+#include "server.h"
+#include "stats.h"
 
 
 /**
  * @brief Runs text based calculator
  * 
- * @return int zero
+ * @param argc number of arguments
+ * @param argv "--batch [file] [--threads N] [--cache MB]" evaluates a file or stdin line by line without prompts,
+ *             "--batch [file] --pipeline" reads, compiles, evaluates and writes on concurrent threads instead,
+ *             it has one thread per stage and no cache, so it rejects --threads and --cache,
+ *             "--serve port|socket [--threads N] [--cache MB]" answers lines from clients until interrupted,
+ *             both also take "--format shortest|fixed|scientific" and "--precision N" for results,
+ *             "--stats file" writes latency and error statistics to file on exit
+ * @return int zero, one if the input or address could not be used
  */
-int main()
+int main(int argc, char *argv[])
 {
+    // statistics file written on exit
+    std::string stats_path;
+
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (std::string(argv[i]) == "--stats")
+            stats_path = argv[i + 1];
+    }
+
+    // batch and server mode
+    if (argc > 1 && (std::string(argv[1]) == "--batch" || std::string(argv[1]) == "--serve"))
+    {
+        const char *path = nullptr;
+        std::size_t threads = 1;
+        std::size_t cache_bytes = 0;
+        bool pipeline = false;
+        bool pool_options = false;
+        FormatOptions options;
+
+        for (int i = 2; i < argc; i++)
+        {
+            // zero threads uses every core
+            if (std::string(argv[i]) == "--threads" && i + 1 < argc)
+            {
+                threads = std::strtoul(argv[++i], nullptr, 10);
+                pool_options = true;
+            }
+            else if (std::string(argv[i]) == "--cache" && i + 1 < argc)
+            {
+                cache_bytes = std::strtoul(argv[++i], nullptr, 10) << 20;
+                pool_options = true;
+            }
+            else if (std::string(argv[i]) == "--format" && i + 1 < argc)
+                options.notation = (std::string(argv[++i]) == "shortest") ? Notation::SHORTEST :
+                                   (std::string(argv[i]) == "scientific") ? Notation::SCIENTIFIC : Notation::FIXED;
+            else if (std::string(argv[i]) == "--precision" && i + 1 < argc)
+                options.precision = std::atoi(argv[++i]);
+            else if (std::string(argv[i]) == "--stats" && i + 1 < argc)
+                i++;
+            else if (std::string(argv[i]) == "--pipeline")
+                pipeline = true;
+            else
+                path = argv[i];
+        }
+
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+
+        int status;
+
+        if (pipeline && (pool_options || std::string(argv[1]) != "--batch"))
+        {
+            std::cerr << "--pipeline only goes with --batch and takes no --threads or --cache" << std::endl;
+            status = 1;
+        }
+        else if (pipeline)
+        {
+            status = Pipeline::run(path, options);
+        }
+        else if (std::string(argv[1]) == "--batch")
+        {
+            status = BatchInput::run(path, threads, cache_bytes, options);
+        }
+        else if (path != nullptr)
+        {
+            status = Server::run(path, threads, cache_bytes, options);
+        }
+        else
+        {
+            std::cerr << "--serve needs a port number or socket path" << std::endl;
+            status = 1;
+        }
+
+        if (!stats_path.empty() && !Stats::dump(stats_path))
+            std::cerr << "cannot write statistics to " << stats_path << std::endl;
+
+        return status;
+    }
+
     // print manual
     HandleInput::manual();
 
@@ -20,5 +110,8 @@ int main()
         HandleInput::check_input(input, run_calc);
     }
 
+    if (!stats_path.empty() && !Stats::dump(stats_path))
+        std::cerr << "cannot write statistics to " << stats_path << std::endl;
+
     return 0;
 }
\ No newline at end of file
@@ -1,62 +1,60 @@
 #include "evaluate_expression.h"
+#include "grammar.h"
+#include "stats.h"
+#include "vector_math.h"
+#include "operator_registry.h"
 
-// scientific functions
-const std::string SIN = "sin";
-const std::string COS = "cos";
-const std::string TAN = "tan";
-const std::string COT = "cot";
-const std::string LOG = "log";
-const std::string LN = "ln";
+// elements evaluated together by the array version of execute
+const std::size_t BLOCK_SIZE = 256;
 
-// highest precedence level for left associated operators
-const int LEFT_ASSOC = 2;
+// distinct variables looked up by linear scan before switching to a hash table
+const std::size_t SCAN_VARIABLES = 16;
 
-// highest precendece level for operators which need two numbers
-const int TAKES_TWO = 3;
+// shorter code is left alone by share, its repeats are too small to pay for SAVE and FETCH
+const std::size_t SHARE_MIN_CODE = 8;
 
-// operators with precedence
-const std::map<std::string, int> OP_PREC = {{"+", 1}, {"-", 1}, {"*", 2}, {"/", 2},
-                                            {"^", 3}, {SIN, 4}, {COS, 4}, {TAN, 4},
-                                            {COT, 4}, {LOG, 4}, {LN, 4}};
+// written instead of a result that overflowed to infinity
+const std::string_view OVERFLOW_MESSAGE = "overflow: the result could not be calculated... Rounding to inf.";
 
-
-/**
- * @brief Ensures string is a valid number
- * 
- * @param str strring to be tested
- * @return true string is a valid number
- * @return false string is not a valid number
- */
-bool EvaluateExpression::is_num(std::string str)
-{
-    try
-    {
-        double test = std::stod(str);
-        return true;
-    }
-    catch (std::invalid_argument)
-    {
-        return false;
-    }
-}
+// most decimals written by format, so every result fits FORMAT_BUFFER
+const int MAX_PRECISION = 40;
+const std::size_t FORMAT_BUFFER = 400;
 
 
 /**
- * @brief Evaluates infix notation mathematical expressions
+ * @brief Evaluates infix notation expression and appends the result or error message to out
  * 
  * @param expression infix notation expression
+ * @param out text the result is appended to
+ * @param options notation and precision of the result
  */
-void EvaluateExpression::evaluate(std::string expression)
+void EvaluateExpression::evaluate(std::string_view expression, std::string &out, const FormatOptions &options)
 {
-    // try evaluating expression
-    try
+    // program buffer is reused between expressions
+    thread_local Program program;
+
+    STATS_START(start);
+
+    double result;
+    Error error = compile(expression, program);
+
+    if (!error)
+        error = execute(program, nullptr, result);
+
+    if (error)
     {
-        std::cout << "Result: " << rpn(shunting_yard(get_tokens(expression))) << std::endl;
+        STATS_ERROR(error.code);
+
+        // messages never contain the offset, so cached results stay valid for equal text
+        out += "error: ";
+        describe(error, expression, program, out);
     }
-    catch(const std::exception& e)
+    else
     {
-        std::cerr << e.what() << std::endl;
+        format(result, options, out);
     }
+
+    STATS_LAP(start, EVALUATE);
 }
 
 
@@ -64,516 +62,925 @@ void EvaluateExpression::evaluate(std::string expression)
  * @brief Parses infix notation equation into tokens
  * 
  * @param expression infix notation expression
- * @return std::vector<std::string> expression parsed into tokens
+ * @param tokens buffer that receives the expression parsed into tokens
+ * @param variables receives the names of variables in order of first use
+ * @return Error first error found, if any
  */
-std::vector<std::string> EvaluateExpression::get_tokens(std::string expression)
+Error EvaluateExpression::get_tokens(std::string_view expression, ScratchVector<Token> &tokens, std::vector<std::string> &variables)
 {
-    // tokens should be broken into operators, numbers, or functions
-    std::vector<std::string> tokens;
-
-    // unary operator checks
-    bool allow_binary = false;
-    bool unary_needs_num = false;
-    std::stack<int> bracket_after;
-    bracket_after.push(0);
+    // tokens should be broken into operators, numbers, variables, or brackets
+    tokens.clear();
+    variables.clear();
 
-    // number of brackets/parentheses left open
-    int open_brackets = 0;
-    int open_parenthesis = 0;
+    Tokenizer<ScratchVector<int>> grammar;
 
-    // whether the brackets/parentheses need to be filled or not
-    bool need_fill = false;
+    // variable names as they appear in the expression, hashed once there are many
+    ScratchVector<std::string_view> names;
+    ScratchMap<std::string_view, std::uint32_t> slots;
 
     // get tokens
-    for (int i = 0; i < expression.length(); i++)
+    for (std::size_t i = 0; i < expression.length(); i++)
     {
+        CharClass kind = character(expression[i]).kind;
+
         // check for blank space
-        if (expression[i] != ' ')
+        if (kind == CharClass::BLANK)
+            continue;
+
+        if (Error error = grammar.next(expression[i]))
+            return error;
+
+        if (kind != CharClass::DIGIT && kind != CharClass::LETTER)
         {
-            // check for number
-            if (isdigit(expression[i]) || expression[i] == '.')
-            {
-                // brackets/parentheses no longer empty
-                if (need_fill)
-                    need_fill = false;
+            if (Error error = grammar.symbol(expression[i], i, tokens))
+                return error;
 
-                // allow binary operators
-                allow_binary = true;
+            continue;
+        }
 
-                int len = 1;
+        std::size_t len = 1;
 
-                // get length of number
-                while (isdigit(expression[i+len]) || expression[i+len] == '.')
-                    len++;
-                
-                // get number as string
-                std::string toke = expression.substr(i, len);
+        // get length of number or name
+        while (i + len < expression.length() && character(expression[i+len]).kind == kind)
+            len++;
 
-                // ensure string is valid number
-                if (is_num(toke))
-                {
-                    tokens.push_back(toke);
-                    i += len - 1;
+        // check for number
+        if (kind == CharClass::DIGIT)
+        {
+            // ensure number is valid and parse it once
+            double value;
+            const char *end = expression.data() + i + len;
+            std::from_chars_result parsed = std::from_chars(expression.data() + i, end, value);
 
-                    // close parenthesis around (-1 * x)
-                    if (unary_needs_num)
-                    {
-                        unary_needs_num = false;
+            if (parsed.ec != std::errc() || parsed.ptr != end)
+                return {ErrorCode::INVALID_NUMBER, static_cast<std::uint32_t>(i)};
 
-                        while (bracket_after.top() > 0)
-                        {
-                            tokens.push_back(")");
-                            bracket_after.top()--;
-                        }
-                    }
-                }
-                else
-                {
-                    throw std::invalid_argument("invalid number: " + toke);
-                }
-            }
-            // check for unary operator
-            else if (expression[i] == '-' && !allow_binary)
-            {
-                // change unary to (-1 * x)
-                tokens.push_back("(");
-                tokens.push_back("-1");
-                tokens.push_back("*");
+            grammar.value({TokenKind::NUMBER, OpCode::PUSH, value, i}, i + len - 1, tokens);
+        }
+        // check for function or variable name
+        else
+        {
+            std::string_view name = expression.substr(i, len);
 
-                if (bracket_after.size() > 0)
-                {
-                    bracket_after.top()++;
-                }
-                else
-                {
-                    break;
-                }
-                
-                unary_needs_num = true;  
-            }
-            // check for binary operator
-            else if (expression[i] == '*' || expression[i] == '/')
+            if (const FunctionEntry *function = OperatorRegistry::find(name))
             {
-                if (allow_binary)
-                {
-                    tokens.push_back(expression.substr(i, 1));
-                    allow_binary = false;
-                }
-                else
-                {
-                    std::string err_message = "invalid expression: invalid use of \"";
-                    err_message.push_back(expression[i]);
-                    err_message += ("\"");
-                    throw std::invalid_argument(err_message);
-                }
+                grammar.function({TokenKind::OPERATOR, function->op, 0, i, function->slot}, tokens);
             }
-            else if (expression[i] == '+' || expression[i] == '-')
+            else
             {
-                if (allow_binary)
+                // variables are numbered in order of first use
+                std::size_t slot = 0;
+
+                if (names.size() <= SCAN_VARIABLES)
                 {
-                    tokens.push_back(expression.substr(i, 1));
-                    allow_binary = false;
+                    while (slot < names.size() && names[slot] != name)
+                        slot++;
                 }
                 else
                 {
-                    std::string err_message = "invalid expression: invalid use of \"";
-                    err_message.push_back(expression[i]);
-                    err_message += ("\"");
-                    throw std::invalid_argument(err_message);
-                }
-            }
-            // check for parenthesis/bracket
-            else if (expression[i] == '(')
-            {
-                // check last token for bracket
-                if (tokens.size() > 0 && (tokens.back() == ")" || tokens.back() == "}"))
-                {
-                    tokens.push_back("*");
-                }
+                    // fill the table the first time it is needed
+                    if (slots.empty())
+                    {
+                        for (std::size_t known = 0; known < names.size(); known++)
+                            slots.emplace(names[known], static_cast<std::uint32_t>(known));
+                    }
 
-                tokens.push_back("(");
-                open_parenthesis++;
-                need_fill = true;
-                allow_binary = false;
-                unary_needs_num = false;
-                bracket_after.push(0);
-            }
-            else if (expression[i] == ')')
-            {
-                // invalid expression
-                if (need_fill)
-                {
-                    throw std::invalid_argument("invalid expression: empty brackets");
+                    ScratchMap<std::string_view, std::uint32_t>::iterator found = slots.find(name);
+                    slot = (found != slots.end()) ? found->second : names.size();
                 }
 
-                // allow binary operators
-                allow_binary = true;
-
-                tokens.push_back(")");
-                open_parenthesis--;
-
-                while (bracket_after.top() > 0)
+                if (slot == names.size())
                 {
-                    tokens.push_back(")");
-                    bracket_after.top()--;
-                }
+                    names.push_back(name);
+                    variables.emplace_back(name);
 
-                if (bracket_after.size() > 0)
-                {
-                    bracket_after.pop();
-                }
-            }
-            else if (expression[i] == '{')
-            {
-                // check last token for bracket
-                if (tokens.size() > 0 && (tokens.back() == ")" || tokens.back() == "}"))
-                {
-                    tokens.push_back("*");
+                    if (!slots.empty())
+                        slots.emplace(name, static_cast<std::uint32_t>(slot));
                 }
 
-                tokens.push_back("{");
-                open_brackets++;
-                need_fill = true;
-                allow_binary = false;
-                unary_needs_num = false;
-                bracket_after.push(0);
+                grammar.value({TokenKind::VARIABLE, OpCode::LOAD, 0, i, static_cast<std::uint32_t>(slot)}, i + len - 1, tokens);
             }
-            else if (expression[i] == '}')
-            {
-                // invalid expression
-                if (need_fill)
-                {
-                    throw std::invalid_argument("invalid expression: empty brackets");
-                }
+        }
 
-                // allow binary operators
-                allow_binary = true;
+        i += len - 1;
+    }
 
-                tokens.push_back("}");
-                open_brackets--;
+    // add final parenthesis and check for errors
+    return grammar.finish(expression.length(), tokens);
+}
 
-                while (bracket_after.top() > 0)
-                {
-                    tokens.push_back(")");
-                    bracket_after.top()--;
-                }
 
-                if (bracket_after.size() > 0)
-                {
-                    bracket_after.pop();
-                }
-            }
-            // check for function
-            else if (expression[i] == '^')
-            {
-                tokens.push_back("^");
-                need_fill = true;
-                allow_binary = false;
-            }
-            else if (expression.substr(i, 3) == SIN)
-            {
-                tokens.push_back(SIN);
-                need_fill = true;
-                allow_binary = false;
-                i += 2;
-            }
-            else if (expression.substr(i, 3) == COS)
-            {
-                tokens.push_back(COS);
-                need_fill = true;
-                allow_binary = false;
-                i += 2;
-            }
-            else if (expression.substr(i, 3) == TAN)
-            {
-                tokens.push_back(TAN);
-                need_fill = true;
-                allow_binary = false;
-                i += 2;
-            }
-            else if (expression.substr(i, 3) == COT)
-            {
-                tokens.push_back(COT);
-                need_fill = true;
-                allow_binary = false;
-                i += 2;
-            }
-            else if (expression.substr(i, 3) == LOG)
-            {
-                tokens.push_back(LOG);
-                need_fill = true;
-                allow_binary = false;
-                i += 2;
-            }
-            else if (expression.substr(i, 2) == LN)
-            {
-                tokens.push_back(LN);
-                need_fill = true;
-                allow_binary = false;
-                i += 1;
-            }
-            // invalid expression
-            else 
-            {
-                std::string err_message = "invalid expression: unknown operator \"";
-                err_message.push_back(expression[i]);
-                err_message += ("\"");
-                throw std::invalid_argument(err_message);
-            }
-        }
-    }
+/**
+ * @brief Transforms infix notation tokens to a postfix program using the Shunting Yard algorithm
+ * 
+ * @param tokens infix notation expression parsed into tokens
+ * @param program buffer that receives the postfix program
+ * @return Error first error found, if any
+ */
+Error EvaluateExpression::shunting_yard(const ScratchVector<Token> &tokens, Program &program)
+{
+    program.code.clear();
+    program.stack_size = 0;
+
+    Arena::Scope scope;
+    ShuntingYard<ScratchVector<Token>> operators;
 
-    // add final parenthesis
-    if (bracket_after.size() > 0)
+    // current size of the value stack
+    std::size_t depth = 0;
+
+    auto output = [&](const Token &token) { return PostfixCode::emit(token, program.code, depth, program.stack_size); };
+
+    for (const Token &token : tokens)
     {
-       while (bracket_after.top() > 0)
-        {
-            tokens.push_back(")");
-            bracket_after.top()--;
-        } 
+        if (Error error = operators.push(token, output))
+            return error;
     }
 
-    // check for errors
-    if (open_parenthesis != 0 || open_brackets != 0)
-        throw std::invalid_argument("invalid expression: unclosed brackets");
-    else if (unary_needs_num)
-        throw std::invalid_argument("invalid expression: invalid use of unary operator");
+    // pop remaining items from the operator stack into the program
+    if (Error error = operators.finish(output))
+        return error;
 
-    return tokens;
+    // check for extra operators
+    if (depth != 1)
+        return {ErrorCode::INVALID_EXPRESSION, static_cast<std::uint32_t>(tokens.empty() ? 0 : tokens.back().offset)};
+
+    return {};
 }
 
 
 /**
- * @brief Transforms infix notation epxressions to posfix notation using the Shunting Yard algorithm
+ * @brief Compiles infix notation expression into a reusable postfix program
  * 
- * @param tokens infix notation expression parsed into tokens
- * @return std::queue<std::string> postfix notation expression
+ * @param expression infix notation expression
+ * @return Program compiled expression
+ * @throws std::invalid_argument with the error message for invalid expressions
+ */
+Program EvaluateExpression::compile(std::string_view expression)
+{
+    Program program;
+
+    if (Error error = compile(expression, program))
+        raise(error, expression, program);
+
+    return program;
+}
+
+
+/**
+ * @brief Compiles infix notation expression into an existing program, reusing its storage
+ * 
+ * @param expression infix notation expression
+ * @param program program that receives the compiled expression
+ * @return Error first syntax error, if any
  */
-std::queue<std::string> EvaluateExpression::shunting_yard(std::vector<std::string> tokens)
+Error EvaluateExpression::compile(std::string_view expression, Program &program)
 {
-    // operator stack and output queue
-    std::stack<std::string> opStack;
-    std::queue<std::string> outQueue;
+    // tokens and the scratch memory of every stage come from the arena of this thread
+    Arena::Scope scope;
+    ScratchVector<Token> tokens;
+
+    // about one token per two characters, a token is 32 bytes so reserving one per character would
+    // hold 32 times the input, more tokens grow the vector
+    tokens.reserve(expression.length() / 2 + 8);
 
-    while (tokens.size() > 0)
+    STATS_START(lap);
+
+    Error error = get_tokens(expression, tokens, program.variables);
+    STATS_TOKENS(tokens.size());
+    STATS_LAP(lap, TOKENIZE);
+
+    if (error)
+        return error;
+
+    error = shunting_yard(tokens, program);
+    STATS_LAP(lap, SHUNTING_YARD);
+
+    if (error)
+        return error;
+
+    optimize(program);
+    share(program);
+    STATS_LAP(lap, OPTIMIZE);
+
+    return {};
+}
+
+
+/**
+ * @brief Folds constant subexpressions and removes redundant instructions from a program
+ * 
+ * Constants are folded unless the operation would fail, so division by zero and
+ * negative logarithms still fail when the program runs. (-1 * x) becomes a negation
+ * and double negations cancel out. x * 1, 1 * x, x / 1, x ^ 1 and x - 0 become x.
+ * x + 0 is kept since it turns -0 into 0.
+ * 
+ * @param program program to simplify in place
+ * @return std::size_t number of instructions removed
+ */
+std::size_t EvaluateExpression::optimize(Program &program)
+{
+    Arena::Scope scope;
+    ScratchVector<PostfixCode::Operand> operands;
+
+    // every constant operation folds to what it computes when the program runs
+    auto exact = [](const Instruction &instr, double first, double second, double &result)
     {
-        std::string token = tokens.front();
-        tokens.erase(tokens.begin());
+        result = fold(instr, first, second);
+        return true;
+    };
+
+    return PostfixCode::optimize(program.code, operands, exact, program.stack_size);
+}
 
-        // token is number
-        if (is_num(token))
+
+/**
+ * @brief Evaluates repeated subexpressions once by hash-consing the program into a DAG
+ * 
+ * Structurally identical subtrees become one node. The code stays in postfix order: the
+ * first copy of a repeated subtree is followed by SAVE into a temporary and every later
+ * copy is replaced by FETCH of it. Runs after optimize, so the (-1 * x) rewrites are
+ * already NEG and every copy of -x is the same node. Numbers and variables are repeated
+ * rather than fetched since loading them costs the same.
+ * 
+ * @param program optimized program to rewrite in place
+ * @return std::size_t number of subtrees replaced by FETCH
+ */
+std::size_t EvaluateExpression::share(Program &program)
+{
+    // DAG node: opcode with operand nodes, or opcode with slot and value bits for leaves
+    struct Node
+    {
+        std::uint64_t key;
+        std::uint64_t operand;
+        std::uint32_t position;
+        std::uint32_t fetches;
+        std::uint32_t temporary;
+    };
+
+    // value on the stack while sharing: its node and where its code starts
+    struct Operand
+    {
+        std::uint32_t node;
+        std::uint32_t start;
+    };
+
+    Arena::Scope scope;
+    ScratchVector<Node> nodes;
+    ScratchVector<Operand> operands;
+    ScratchVector<std::uint32_t> saved;
+
+    // open addressing table of node index + 1, zero marks an empty bucket
+    ScratchVector<std::uint32_t> table;
+
+    std::vector<Instruction> &code = program.code;
+    program.temporaries = 0;
+
+    if (code.size() < SHARE_MIN_CODE)
+        return 0;
+
+    std::size_t capacity = SHARE_MIN_CODE * 2;
+
+    while (capacity < code.size() * 2)
+        capacity *= 2;
+
+    nodes.reserve(code.size());
+    operands.reserve(program.stack_size);
+    table.assign(capacity, 0);
+
+    // shared code is written over the front of the original code
+    std::size_t size = 0;
+
+    for (std::size_t i = 0; i < code.size(); i++)
+    {
+        Instruction instr = code[i];
+        std::uint64_t key = static_cast<std::uint64_t>(instr.op);
+        std::uint64_t operand = 0;
+        std::uint32_t start = size;
+        bool leaf = instr.op == OpCode::PUSH || instr.op == OpCode::LOAD;
+
+        if (leaf)
         {
-            outQueue.push(token);
+            key |= static_cast<std::uint64_t>(instr.slot) << 8;
+            std::memcpy(&operand, &instr.value, sizeof(operand));
         }
-        // token is operator
-        else if (OP_PREC.find(token) != OP_PREC.end())
+        else if (OPERATORS[static_cast<int>(instr.op)].arity == 2)
         {
-            while (opStack.size() > 0)
-            {
-                std::map<std::string, int>::const_iterator stack_pos = OP_PREC.find(opStack.top());
-                std::map<std::string, int>::const_iterator pos = OP_PREC.find(token);
+            operand = operands.back().node;
+            operands.pop_back();
 
-                // pop from op_stack if not left parenthesis and top of op_stack has greater precedence
-                // or if same precedence and token is left associative
-                if (stack_pos->first != "(")
-                {
-                    if ((pos->second < stack_pos->second) ||
-                        (stack_pos->second == pos->second && pos->second <= LEFT_ASSOC))
-                    {
-                        outQueue.push(stack_pos->first);
-                        opStack.pop();
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
-                else
-                {
-                    break;
-                }
-            }
+            key |= static_cast<std::uint64_t>(operands.back().node) << 8;
+            start = operands.back().start;
+            operands.pop_back();
+        }
+        else
+        {
+            key |= static_cast<std::uint64_t>(operands.back().node) << 8;
+            start = operands.back().start;
+            operands.pop_back();
+        }
 
-            opStack.push(token);
+        // calls of different natives are different nodes
+        if (instr.op == OpCode::CALL1 || instr.op == OpCode::CALL2)
+            key |= static_cast<std::uint64_t>(instr.slot) << 40;
+
+        std::uint64_t hash = (key * 0x9E3779B97F4A7C15ull) ^ (operand * 0xC2B2AE3D27D4EB4Full);
+        std::size_t bucket = (hash ^ (hash >> 29)) & (capacity - 1);
+
+        while (table[bucket] != 0 && (nodes[table[bucket] - 1].key != key || nodes[table[bucket] - 1].operand != operand))
+            bucket = (bucket + 1) & (capacity - 1);
+
+        std::uint32_t node;
+
+        if (table[bucket] == 0)
+        {
+            node = nodes.size();
+            table[bucket] = node + 1;
+            nodes.push_back({key, operand, static_cast<std::uint32_t>(size), 0, 0});
+            code[size++] = instr;
         }
-        else if (token == "(" || token == "{")
+        else if (leaf)
         {
-            opStack.push(token);
+            node = table[bucket] - 1;
+            code[size++] = instr;
         }
-        else if (token == ")" || token == "}")
+        else
         {
-            // get closing bracket/parenthesis
-            std::string closing;
+            // later copy, drop its code along with the fetches inside it
+            node = table[bucket] - 1;
 
-            if (token == ")")
-                closing = "(";
-            else
-                closing = "{";
-
-            while (opStack.top() != closing)
+            for (std::size_t j = start; j < size; j++)
             {
-                outQueue.push(opStack.top());
-                opStack.pop();
+                if (code[j].op == OpCode::FETCH)
+                    nodes[code[j].slot].fetches--;
             }
 
-            opStack.pop();
+            size = start;
+            code[size++] = {OpCode::FETCH, node, 0};
+            nodes[node].fetches++;
+        }
+
+        operands.push_back({node, start});
+    }
+
+    // nodes are created in code order, so temporaries are numbered in code order too
+    saved.clear();
+
+    for (std::uint32_t node = 0; node < nodes.size(); node++)
+    {
+        if (nodes[node].fetches > 0)
+        {
+            nodes[node].temporary = saved.size();
+            saved.push_back(node);
+        }
+    }
+
+    if (saved.empty())
+        return 0;
+
+    program.temporaries = saved.size();
+
+    // insert SAVE after every first copy, moving code back to front
+    std::size_t fetched = 0;
+    std::size_t write = size + saved.size();
+    code.resize(write);
+
+    for (std::size_t i = size; i-- > 0;)
+    {
+        Instruction instr = code[i];
+
+        if (instr.op == OpCode::FETCH)
+        {
+            instr.slot = nodes[instr.slot].temporary;
+            fetched++;
         }
-        // invalid expression
-        else 
+
+        if (saved.size() > 0 && nodes[saved.back()].position == i)
         {
-            throw std::invalid_argument("invalid expression: unknown operator " + token);
+            code[--write] = {OpCode::SAVE, nodes[saved.back()].temporary, 0};
+            saved.pop_back();
         }
+
+        code[--write] = instr;
     }
 
-    // pop remaining items from the operator stack into output queue
-    while (opStack.size() > 0)
+    return fetched;
+}
+
+
+/**
+ * @brief Applies operator to constant operands
+ * 
+ * @param instr operator
+ * @param first left or only operand
+ * @param second right operand of binary operators
+ * @return double result
+ */
+double EvaluateExpression::fold(const Instruction &instr, double first, double second)
+{
+    const double operands[] = {first, second};
+
+    switch (instr.op)
     {
-        outQueue.push(opStack.top());
-        opStack.pop();
+        case OpCode::ADD:
+            return first + second;
+        case OpCode::SUB:
+            return first - second;
+        case OpCode::MUL:
+            return first * second;
+        case OpCode::DIV:
+            return first / second;
+        case OpCode::POW:
+            return pow(first, second);
+        case OpCode::SIN:
+            return sin(first);
+        case OpCode::COS:
+            return cos(first);
+        case OpCode::TAN:
+            return tan(first);
+        case OpCode::COT:
+            return 1 / tan(first);
+        case OpCode::LOG:
+            return log10(first);
+        case OpCode::LN:
+            return log(first);
+        case OpCode::NEG:
+            return -first;
+        case OpCode::CALL1:
+        case OpCode::CALL2:
+            return OperatorRegistry::native(instr.slot)(operands);
+        default:
+            return first;
     }
+}
+
 
-    return outQueue;
+/**
+ * @brief Runs a compiled program without variables on a fixed-size value stack
+ * 
+ * @param program compiled expression
+ * @return double answer to expression
+ * @throws std::invalid_argument with the error message when the program fails
+ */
+double EvaluateExpression::execute(const Program &program)
+{
+    return execute(program, nullptr);
 }
 
 
 /**
- * @brief Uses Reverse Polish Notation (RPN) to evaluate mathematical expressions
+ * @brief Runs a compiled program on a fixed-size value stack
  * 
- * @param output output queue from Shunting Yard algorithm
+ * @param program compiled expression
+ * @param variables one value per variable in Program::variables order, may be null without variables
  * @return double answer to expression
+ * @throws std::invalid_argument with the error message when the program fails
  */
-std::string EvaluateExpression::rpn(std::queue<std::string> output)
+double EvaluateExpression::execute(const Program &program, const double *variables)
 {
-    std::stack<double> opStack;
+    double result;
+
+    if (Error error = execute(program, variables, result))
+        raise(error, {}, program);
 
-    while (output.size() > 0)
+    return result;
+}
+
+
+/**
+ * @brief Runs a compiled program on a fixed-size value stack without throwing
+ * 
+ * @param program compiled expression
+ * @param variables one value per variable in Program::variables order, may be null without variables
+ * @param result receives the answer to expression
+ * @return Error division by zero, negative logarithm or a missing variable, if any
+ */
+Error EvaluateExpression::execute(const Program &program, const double *variables, double &result)
+{
+    if (variables == nullptr && program.variables.size() > 0)
+        return {ErrorCode::UNKNOWN_VARIABLE, 0};
+
+    // value stack and temporaries are sized by the compiler
+    Arena::Scope scope;
+    double *values = scope.allocate<double>(program.stack_size + program.temporaries);
+
+    STATS_START(start);
+    Error error = run(program.code.data(), program.code.data() + program.code.size(), variables, values,
+                      values + program.stack_size, result);
+    STATS_LAP(start, EXECUTE);
+
+    return error;
+}
+
+
+/**
+ * @brief Runs a range of instructions that leaves at least one value on the stack
+ * 
+ * @param begin first instruction
+ * @param end past the last instruction
+ * @param variables one value per variable in Program::variables order
+ * @param values value stack, large enough for the instructions
+ * @param temporaries values of SAVE and FETCH
+ * @param result receives the value on top of the stack at the end
+ * @return Error division by zero or negative logarithm, if any
+ */
+Error EvaluateExpression::run(const Instruction *begin, const Instruction *end, const double *variables, double *values,
+                              double *temporaries, double &result)
+{
+    double *top = values - 1;
+
+    for (const Instruction *instr = begin; instr != end; instr++)
     {
-        std::string token = output.front();
-        output.pop();
+        switch (instr->op)
+        {
+            case OpCode::PUSH:
+                *++top = instr->value;
+                break;
+            case OpCode::LOAD:
+                *++top = variables[instr->slot];
+                break;
+            case OpCode::ADD:
+                top[-1] += top[0];
+                top--;
+                break;
+            case OpCode::SUB:
+                top[-1] -= top[0];
+                top--;
+                break;
+            case OpCode::MUL:
+                top[-1] *= top[0];
+                top--;
+                break;
+            case OpCode::DIV:
+                if (top[0] == 0)
+                    return {ErrorCode::DIVISION_BY_ZERO, instr->slot};
+
+                top[-1] /= top[0];
+                top--;
+                break;
+            case OpCode::POW:
+                top[-1] = pow(top[-1], top[0]);
+                top--;
+                break;
+            case OpCode::SIN:
+                *top = sin(*top);
+                break;
+            case OpCode::COS:
+                *top = cos(*top);
+                break;
+            case OpCode::TAN:
+                *top = tan(*top);
+                break;
+            case OpCode::COT:
+                *top = 1 / tan(*top);
+                break;
+            case OpCode::LOG:
+                if (*top < 0)
+                    return {ErrorCode::NEGATIVE_LOGARITHM, instr->slot};
+
+                *top = log10(*top);
+                break;
+            case OpCode::LN:
+                if (*top < 0)
+                    return {ErrorCode::NEGATIVE_LOGARITHM, instr->slot};
+
+                *top = log(*top);
+                break;
+            case OpCode::NEG:
+                *top = -*top;
+                break;
+            case OpCode::SAVE:
+                temporaries[instr->slot] = *top;
+                break;
+            case OpCode::FETCH:
+                *++top = temporaries[instr->slot];
+                break;
+            case OpCode::CALL1:
+                *top = OperatorRegistry::native(instr->slot)(top);
+                break;
+            case OpCode::CALL2:
+                top[-1] = OperatorRegistry::native(instr->slot)(top - 1);
+                top--;
+                break;
+        }
+    }
+
+    result = *top;
+
+    return {};
+}
+
 
-        // check for operator, else number
-        if (OP_PREC.find(token) != OP_PREC.end())
+/**
+ * @brief Runs a compiled program over arrays of variable values, one block of elements at a time
+ * 
+ * Every instruction is applied to a whole block before the next one, so the inner
+ * loops are simple array loops the compiler can vectorize. The scientific functions
+ * run on the kernels of VectorMath and may differ from execute by their error bounds.
+ * 
+ * @param program compiled expression
+ * @param bindings array for every variable of the program
+ * @param count number of elements in every array
+ * @param out receives count results
+ * @return Error first error of any element, out is incomplete then
+ */
+Error EvaluateExpression::execute(const Program &program, const std::vector<Binding> &bindings, std::size_t count, double *out)
+{
+    Arena::Scope scope;
+
+    // variable arrays in slot order
+    ScratchVector<const double*> columns;
+
+    if (Error error = bind(program, bindings, columns))
+        return error;
+
+    // value stack and temporaries hold one block per entry
+    double *values = scope.allocate<double>((program.stack_size + program.temporaries) * BLOCK_SIZE);
+
+    // scientific functions of the widest instruction set of this CPU
+    const MathKernels &math = VectorMath::kernels();
+    double *temporaries = values + program.stack_size * BLOCK_SIZE;
+
+    for (std::size_t first = 0; first < count; first += BLOCK_SIZE)
+    {
+        std::size_t n = std::min(BLOCK_SIZE, count - first);
+        double *top = values - BLOCK_SIZE;
+
+        for (const Instruction &instr : program.code)
         {
-            std::map<std::string, int>::const_iterator pos = OP_PREC.find(token);
-            double result;
+            double *second = top;
+            bool invalid = false;
 
-            if (pos->second <= TAKES_TWO)
+            switch (instr.op)
             {
-                if (opStack.size() >= 2)
-                {
-                    double second = opStack.top();
-                    opStack.pop();
-                    double first = opStack.top();
-                    opStack.pop();
+                case OpCode::PUSH:
+                    top += BLOCK_SIZE;
+                    std::fill(top, top + n, instr.value);
+                    break;
+                case OpCode::LOAD:
+                    top += BLOCK_SIZE;
+                    std::copy(columns[instr.slot] + first, columns[instr.slot] + first + n, top);
+                    break;
+                case OpCode::ADD:
+                    top -= BLOCK_SIZE;
+                    for (std::size_t j = 0; j < n; j++)
+                        top[j] += second[j];
+                    break;
+                case OpCode::SUB:
+                    top -= BLOCK_SIZE;
+                    for (std::size_t j = 0; j < n; j++)
+                        top[j] -= second[j];
+                    break;
+                case OpCode::MUL:
+                    top -= BLOCK_SIZE;
+                    for (std::size_t j = 0; j < n; j++)
+                        top[j] *= second[j];
+                    break;
+                case OpCode::DIV:
+                    for (std::size_t j = 0; j < n; j++)
+                        invalid |= second[j] == 0;
 
-                    if (token == "+")
-                    {
-                        result = first + second;
-                    }
-                    else if (token == "-")
-                    {
-                        result = first - second;
-                    }
-                    else if (token == "*")
-                    {
-                        result = first * second;
-                    }
-                    else if (token == "/")
-                    {
-                        if (second != 0)
-                        {
-                            result = first / second;
-                        }
-                        else
-                        {
-                            throw std::invalid_argument("invalid expression: division by zero");
-                        }
-                    }
-                    else if (token == "^")
-                    {
-                        result = pow(first, second);
-                    }
-                }
-                else
+                    if (invalid)
+                        return {ErrorCode::DIVISION_BY_ZERO, instr.slot};
+
+                    top -= BLOCK_SIZE;
+                    for (std::size_t j = 0; j < n; j++)
+                        top[j] /= second[j];
+                    break;
+                case OpCode::POW:
+                    top -= BLOCK_SIZE;
+                    for (std::size_t j = 0; j < n; j++)
+                        top[j] = pow(top[j], second[j]);
+                    break;
+                case OpCode::SIN:
+                    math.sin(top, n);
+                    break;
+                case OpCode::COS:
+                    math.cos(top, n);
+                    break;
+                case OpCode::TAN:
+                    math.tan(top, n);
+                    break;
+                case OpCode::COT:
+                    math.cot(top, n);
+                    break;
+                case OpCode::LOG:
+                case OpCode::LN:
+                    for (std::size_t j = 0; j < n; j++)
+                        invalid |= top[j] < 0;
+
+                    if (invalid)
+                        return {ErrorCode::NEGATIVE_LOGARITHM, instr.slot};
+
+                    if (instr.op == OpCode::LOG)
+                        math.log(top, n);
+                    else
+                        math.ln(top, n);
+                    break;
+                case OpCode::NEG:
+                    for (std::size_t j = 0; j < n; j++)
+                        top[j] = -top[j];
+                    break;
+                case OpCode::SAVE:
+                    std::copy(top, top + n, temporaries + instr.slot * BLOCK_SIZE);
+                    break;
+                case OpCode::FETCH:
+                    top += BLOCK_SIZE;
+                    std::copy(temporaries + instr.slot * BLOCK_SIZE, temporaries + instr.slot * BLOCK_SIZE + n, top);
+                    break;
+                case OpCode::CALL1:
                 {
-                    throw std::invalid_argument("invalid expression: insufficient number of values for operator");
+                    NativeFunction function = OperatorRegistry::native(instr.slot);
+
+                    for (std::size_t j = 0; j < n; j++)
+                        top[j] = function(top + j);
+                    break;
                 }
-            }
-            else
-            {
-                if (opStack.size() >= 1)
+                case OpCode::CALL2:
                 {
-                    double first = opStack.top();
-                    opStack.pop();
+                    NativeFunction function = OperatorRegistry::native(instr.slot);
+                    top -= BLOCK_SIZE;
 
-                    if (token == SIN)
-                    {
-                        result = sin(first);
-                    }
-                    else if (token == COS)
-                    {
-                        result = cos(first);
-                    }
-                    else if (token == TAN)
-                    {
-                        result = tan(first);
-                    }
-                    else if (token == COT)
+                    // operands of one element sit a block apart
+                    for (std::size_t j = 0; j < n; j++)
                     {
-                        result = 1 / tan(first);
+                        const double operands[] = {top[j], second[j]};
+                        top[j] = function(operands);
                     }
-                    else if (token == LOG)
-                    {
-                        if (first >= 0)
-                        {
-                            result = log10(first);
-                        }
-                        else
-                        {
-                            throw std::invalid_argument("invalid expression: negative logarithm");
-                        }
-                    }
-                    else if (token == LN)
-                    {
-                        if (first >= 0)
-                        {
-                            result = log(first);
-                        }
-                        else
-                        {
-                            throw std::invalid_argument("invalid expression: negative logarithm");
-                        }
-                    }
-                }
-                else
-                {
-                    throw std::invalid_argument("invalid expression: insufficient number of values for operator");
+                    break;
                 }
             }
-
-            opStack.push(result);
         }
-        else
+
+        std::copy(top, top + n, out + first);
+    }
+
+    return {};
+}
+
+
+/**
+ * @brief Finds the array of every variable of a program
+ * 
+ * @param program compiled expression
+ * @param bindings arrays by variable name
+ * @param columns receives one array per variable in Program::variables order
+ * @return Error first variable without an array, if any
+ */
+Error EvaluateExpression::bind(const Program &program, const std::vector<Binding> &bindings, ScratchVector<const double*> &columns)
+{
+    columns.assign(program.variables.size(), nullptr);
+
+    for (std::size_t slot = 0; slot < program.variables.size(); slot++)
+    {
+        for (const Binding &binding : bindings)
         {
-            // ensure string is valid number
-            if (is_num(token))
-            {
-                opStack.push(std::stod(token));
-            }
-            else
-            {
-                throw std::invalid_argument("invalid number: " + token);
-            }
+            if (binding.name == program.variables[slot])
+                columns[slot] = binding.values;
         }
+
+        if (columns[slot] == nullptr)
+            return {ErrorCode::UNKNOWN_VARIABLE, static_cast<std::uint32_t>(slot)};
     }
 
-    // check for extra operators
-    if (opStack.size() != 1)
-        throw std::invalid_argument("invalid expression");
+    return {};
+}
+
+
+/**
+ * @brief Appends the message of an error, naming the offending operator, number or variable
+ * 
+ * @param error error reported by compile or execute
+ * @param expression expression the error was found in, only needed for syntax errors
+ * @param program program the error was found in, only needed for unknown variables
+ * @param out text the message is appended to
+ */
+void EvaluateExpression::describe(const Error &error, std::string_view expression, const Program &program, std::string &out)
+{
+    out += ERROR_MESSAGES[static_cast<int>(error.code)];
+
+    if ((error.code == ErrorCode::INVALID_OPERATOR_USE || error.code == ErrorCode::UNKNOWN_OPERATOR) &&
+        error.offset < expression.length())
+    {
+        std::size_t len = 1;
+
+        // a function is named in full
+        while (character(expression[error.offset]).kind == CharClass::LETTER && error.offset + len < expression.length() &&
+               character(expression[error.offset + len]).kind == CharClass::LETTER)
+            len++;
+
+        out += expression.substr(error.offset, len);
+        out.push_back('"');
+    }
+    else if (error.code == ErrorCode::INVALID_NUMBER && error.offset < expression.length())
+    {
+        std::size_t len = 1;
 
+        while (error.offset + len < expression.length() && character(expression[error.offset + len]).kind == CharClass::DIGIT)
+            len++;
+
+        out += expression.substr(error.offset, len);
+    }
+    else if ((error.code == ErrorCode::UNKNOWN_VARIABLE || error.code == ErrorCode::CIRCULAR_REFERENCE) &&
+             error.offset < program.variables.size())
+    {
+        out += program.variables[error.offset];
+        out.push_back('"');
+    }
+}
+
+
+/**
+ * @brief Splits "name = expression" into the assigned name and its expression
+ * 
+ * The name follows the same rules as variables in get_tokens and cannot be a function.
+ * Any other use of "=" is left to the tokenizer, which reports it as an unknown operator.
+ * 
+ * @param line input line
+ * @param name receives the assigned name
+ * @param expression receives the text after "="
+ * @return true line is an assignment
+ * @return false line is a plain expression
+ */
+bool EvaluateExpression::assignment(std::string_view line, std::string_view &name, std::string_view &expression)
+{
+    std::size_t start = 0;
+
+    while (start < line.length() && line[start] == ' ')
+        start++;
+
+    std::size_t end = start;
+
+    while (end < line.length() && (isalpha(line[end]) || line[end] == '_'))
+        end++;
+
+    std::size_t equals = end;
+
+    while (equals < line.length() && line[equals] == ' ')
+        equals++;
+
+    if (end == start || equals == line.length() || line[equals] != '=')
+        return false;
+
+    name = line.substr(start, end - start);
+
+    if (OperatorRegistry::find(name) != nullptr)
+        return false;
+
+    expression = line.substr(equals + 1);
+    return true;
+}
+
+
+/**
+ * @brief Throws an error as std::invalid_argument, for callers that prefer exceptions
+ * 
+ * @param error error reported by compile or execute
+ * @param expression expression the error was found in
+ * @param program program the error was found in
+ */
+void EvaluateExpression::raise(const Error &error, std::string_view expression, const Program &program)
+{
+    std::string message;
+    describe(error, expression, program, message);
+
+    throw std::invalid_argument(message);
+}
+
+
+/**
+ * @brief Appends result as text, reporting overflow
+ * 
+ * Numbers are written by std::to_chars into a stack buffer, so nothing is allocated
+ * once out has grown and the text does not depend on the locale.
+ * 
+ * @param result answer to expression
+ * @param options notation and precision
+ * @param out text the result is appended to
+ */
+void EvaluateExpression::format(double result, const FormatOptions &options, std::string &out)
+{
     // check for overflow
-    if (opStack.top() == std::numeric_limits<double>::infinity())
-        return "overflow: the result could not be calculated... Rounding to " + std::to_string(opStack.top()) + ".";
+    if (result == std::numeric_limits<double>::infinity())
+    {
+        out += OVERFLOW_MESSAGE;
+        return;
+    }
+
+    char buffer[FORMAT_BUFFER];
+    std::to_chars_result written;
+
+    if (options.notation == Notation::SHORTEST)
+    {
+        written = std::to_chars(buffer, buffer + FORMAT_BUFFER, result);
+    }
+    else
+    {
+        int precision = std::clamp(options.precision, 0, MAX_PRECISION);
+        std::chars_format notation = (options.notation == Notation::FIXED) ? std::chars_format::fixed
+                                                                            : std::chars_format::scientific;
+
+        written = std::to_chars(buffer, buffer + FORMAT_BUFFER, result, notation, precision);
+    }
 
-    return std::to_string(opStack.top());
+    out.append(buffer, written.ptr);
 }
\ No newline at end of file
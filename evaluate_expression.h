@@ -1,21 +1,174 @@
-#include <map>
+#pragma once
+
+#include "arena.h"
 #include <cmath>
 #include <limits>
-#include <stack>
-#include <queue>
+#include <cstdint>
+#include <algorithm>
 #include <vector>
 #include <string>
-#include <iostream>
+#include <string_view>
+#include <unordered_map>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+
+// instructions of a compiled expression, CALL1 and CALL2 run a native function of OperatorRegistry
+enum class OpCode
+{
+    PUSH, LOAD, ADD, SUB, MUL, DIV, POW, SIN, COS, TAN, COT, LOG, LN, NEG, SAVE, FETCH, CALL1, CALL2
+};
+
+
+// values an instruction takes from the stack, and its precedence and associativity as an operator.
+// Leaves take nothing, SAVE only annotates the value on top and functions bind tightest
+struct OperatorInfo
+{
+    int arity;
+    int precedence;
+    bool right_associative;
+};
+
+
+// operator of every OpCode
+constexpr OperatorInfo OPERATORS[] = {{0, 0, false}, {0, 0, false}, {2, 1, false}, {2, 1, false}, {2, 2, false},
+                                      {2, 2, false}, {2, 3, true}, {1, 4, true}, {1, 4, true}, {1, 4, true},
+                                      {1, 4, true}, {1, 4, true}, {1, 4, true}, {1, 4, true}, {0, 0, false},
+                                      {0, 0, false}, {1, 4, true}, {2, 4, true}};
+
+
+// function name and the instruction it compiles to, slot is the native function of CALL1 and CALL2
+struct FunctionEntry
+{
+    std::string_view name;
+    OpCode op;
+    std::uint32_t slot;
+};
+
+
+// functions every OperatorRegistry starts with, natives in slot order
+constexpr FunctionEntry FUNCTIONS[] = {{"sin", OpCode::SIN, 0}, {"cos", OpCode::COS, 0}, {"tan", OpCode::TAN, 0},
+                                       {"cot", OpCode::COT, 0}, {"log", OpCode::LOG, 0}, {"ln", OpCode::LN, 0},
+                                       {"sqrt", OpCode::CALL1, 0}, {"exp", OpCode::CALL1, 1}, {"abs", OpCode::CALL1, 2},
+                                       {"min", OpCode::CALL2, 3}, {"max", OpCode::CALL2, 4}};
+
+
+// kinds of tokens produced by the tokenizer
+enum class TokenKind
+{
+    NUMBER, VARIABLE, OPERATOR, OPEN_PARENTHESIS, CLOSE_PARENTHESIS, OPEN_BRACKET, CLOSE_BRACKET, SEPARATOR
+};
+
+
+// single token, value is only used by numbers and slot by variables and native functions
+struct Token
+{
+    TokenKind kind;
+    OpCode op;
+    double value;
+    std::size_t offset;
+    std::uint32_t slot = 0;
+};
+
+
+// errors reported by the evaluation pipeline, NONE when it succeeded
+enum class ErrorCode
+{
+    NONE, DIVISION_BY_ZERO, NEGATIVE_LOGARITHM, UNCLOSED_BRACKETS, EMPTY_BRACKETS, UNARY_OPERATOR, INVALID_OPERATOR_USE,
+    UNKNOWN_OPERATOR, INVALID_NUMBER, MISSING_VALUES, INVALID_EXPRESSION, UNKNOWN_VARIABLE, CIRCULAR_REFERENCE, COUNT
+};
+
+
+// error code and the source offset it was found at, the variable slot for UNKNOWN_VARIABLE and CIRCULAR_REFERENCE
+struct [[nodiscard]] Error
+{
+    ErrorCode code = ErrorCode::NONE;
+    std::uint32_t offset = 0;
+
+    constexpr explicit operator bool() const { return code != ErrorCode::NONE; }
+};
+
+
+// message of every ErrorCode, describe appends the offending text to some of them
+constexpr std::string_view ERROR_MESSAGES[] = {"", "invalid expression: division by zero", "invalid expression: negative logarithm",
+                                               "invalid expression: unclosed brackets", "invalid expression: empty brackets",
+                                               "invalid expression: invalid use of unary operator",
+                                               "invalid expression: invalid use of \"", "invalid expression: unknown operator \"",
+                                               "invalid number: ", "invalid expression: insufficient number of values for operator",
+                                               "invalid expression", "invalid expression: unknown variable \"",
+                                               "invalid expression: circular reference through \""};
+
+
+// single instruction, value is only used by PUSH, slot is the variable of LOAD, the temporary of SAVE
+// and FETCH, the native function of CALL1 and CALL2, and the source offset of other operators
+struct Instruction
+{
+    OpCode op;
+    std::uint32_t slot;
+    double value;
+};
+
+
+// postfix program produced by EvaluateExpression::compile
+struct Program
+{
+    std::vector<Instruction> code;
+    std::vector<std::string> variables;
+    std::size_t stack_size = 0;
+    std::size_t temporaries = 0;
+};
+
+
+// notation of formatted results, SHORTEST is the shortest text that reads back as the same double
+enum class Notation
+{
+    SHORTEST, FIXED, SCIENTIFIC
+};
+
+
+// how results are written as text, precision is the number of decimals and is ignored by SHORTEST
+struct FormatOptions
+{
+    Notation notation = Notation::FIXED;
+    int precision = 6;
+};
+
+
+// array of values for one variable
+struct Binding
+{
+    std::string_view name;
+    const double *values;
+};
 
 
 class EvaluateExpression
 {
     public:
-        static void evaluate(std::string);
+        static void evaluate(std::string_view, std::string&, const FormatOptions& = FormatOptions());
+        static Program compile(std::string_view);
+        static Error compile(std::string_view, Program&);
+        static std::size_t optimize(Program&);
+        static std::size_t share(Program&);
+        static double execute(const Program&);
+        static double execute(const Program&, const double*);
+        static Error execute(const Program&, const double*, double&);
+        static Error execute(const Program&, const std::vector<Binding>&, std::size_t, double*);
+        static Error bind(const Program&, const std::vector<Binding>&, ScratchVector<const double*>&);
+        static void describe(const Error&, std::string_view, const Program&, std::string&);
+        static void format(double, const FormatOptions&, std::string&);
+        static bool assignment(std::string_view, std::string_view&, std::string_view&);
 
     private:
-        static bool is_num(std::string);
-        static std::vector<std::string> get_tokens(std::string);
-        static std::queue<std::string> shunting_yard(std::vector<std::string>);
-        static std::string rpn(std::queue<std::string>);
+        friend class Benchmark;
+        friend class ParallelProgram;
+        friend class ProgramStore;
+        friend class StreamParser;
+
+        static Error get_tokens(std::string_view, ScratchVector<Token>&, std::vector<std::string>&);
+        static Error shunting_yard(const ScratchVector<Token>&, Program&);
+        static double fold(const Instruction&, double, double);
+        static Error run(const Instruction*, const Instruction*, const double*, double*, double*, double&);
+        [[noreturn]] static void raise(const Error&, std::string_view, const Program&);
 };
\ No newline at end of file
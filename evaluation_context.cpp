@@ -0,0 +1,164 @@
+#include "evaluation_context.h"
+#include "stats.h"
+
+
+/**
+ * @brief Creates a context with no program or formulas
+ * 
+ * @param options notation and precision of results written as text
+ */
+EvaluationContext::EvaluationContext(const FormatOptions &options) : format(options)
+{
+}
+
+
+/**
+ * @brief Evaluates an infix notation expression, reusing the program when the text has not changed
+ * 
+ * @param expression infix notation expression
+ * @param variables one value per variable in order of first use, may be null without variables
+ * @return Result answer to expression or the first error
+ */
+Result EvaluationContext::evaluate(std::string_view expression, const double *variables)
+{
+    STATS_START(start);
+
+    Result result;
+    result.error = compile(expression);
+
+    if (!result.error)
+        result = execute(variables);
+
+    if (result.error)
+        STATS_ERROR(result.error.code);
+
+    STATS_LAP(start, EVALUATE);
+
+    return result;
+}
+
+
+/**
+ * @brief Evaluates an assignment or expression and appends the result or error message as text
+ * 
+ * Once a formula is assigned, every line goes through the formulas of this context, so
+ * later expressions can use their names.
+ * 
+ * @param line assignment or infix notation expression
+ * @param out text the result or error message is appended to
+ * @return true out holds a result
+ * @return false out holds an error message
+ */
+bool EvaluationContext::evaluate(std::string_view line, std::string &out)
+{
+    std::string_view name;
+    std::string_view expression;
+
+    if (formulas.size() > 0 || EvaluateExpression::assignment(line, name, expression))
+        return formulas.evaluate(line, out, format);
+
+    Result result = evaluate(line);
+
+    if (result.error)
+    {
+        EvaluateExpression::describe(result.error, source, compiled, out);
+        return false;
+    }
+
+    EvaluateExpression::format(result.value, format, out);
+    return true;
+}
+
+
+/**
+ * @brief Compiles an expression into the program of this context, nothing to do for the same text again
+ * 
+ * @param expression infix notation expression
+ * @return Error first syntax error, if any
+ */
+Error EvaluationContext::compile(std::string_view expression)
+{
+    if (compiled_once && expression == source)
+        return compile_error;
+
+    source.assign(expression);
+    compile_error = EvaluateExpression::compile(source, compiled);
+    compiled_once = true;
+
+    return compile_error;
+}
+
+
+/**
+ * @brief Runs the last compiled program
+ * 
+ * @param variables one value per variable in order of first use, may be null without variables
+ * @return Result answer to expression, the syntax error if it did not compile
+ */
+Result EvaluationContext::execute(const double *variables) const
+{
+    Result result;
+
+    if (!compiled_once)
+        result.error = {ErrorCode::INVALID_EXPRESSION, 0};
+    else if (compile_error)
+        result.error = compile_error;
+    else
+        result.error = EvaluateExpression::execute(compiled, variables, result.value);
+
+    return result;
+}
+
+
+/**
+ * @brief Finds where the value of a variable goes in the array given to evaluate and execute
+ * 
+ * @param name variable name
+ * @return std::size_t slot, the number of variables when the program does not use name
+ */
+std::size_t EvaluationContext::slot(std::string_view name) const
+{
+    std::size_t slot = 0;
+
+    while (slot < compiled.variables.size() && compiled.variables[slot] != name)
+        slot++;
+
+    return slot;
+}
+
+
+/**
+ * @brief Message of an error found in the last compiled expression
+ * 
+ * @param error error returned for that expression
+ * @return std::string_view message, valid until the next call
+ */
+std::string_view EvaluationContext::message(const Error &error)
+{
+    text.clear();
+    EvaluateExpression::describe(error, source, compiled, text);
+
+    return text;
+}
+
+
+/**
+ * @brief Last compiled program, for the array executor or JitProgram
+ * 
+ * @return const Program& compiled expression
+ */
+const Program &EvaluationContext::program() const
+{
+    return compiled;
+}
+
+
+/**
+ * @brief Notation and precision of results written as text
+ * 
+ * @return const FormatOptions& format options
+ */
+const FormatOptions &EvaluationContext::options() const
+{
+    return format;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "evaluate_expression.h"
+#include "formula_graph.h"
+#include <string>
+#include <cstdint>
+#include <string_view>
+
+
+// answer to an expression, value is only set when there is no error
+struct Result
+{
+    double value = 0;
+    Error error;
+
+    explicit operator bool() const { return !error; }
+};
+
+
+// state reused between evaluations: the compiled program, formulas and message text. A context
+// is used by one thread at a time, contexts share nothing and run on any number of threads at once
+class EvaluationContext
+{
+    public:
+        explicit EvaluationContext(const FormatOptions& = FormatOptions());
+
+        Result evaluate(std::string_view, const double* = nullptr);
+        bool evaluate(std::string_view, std::string&);
+        Error compile(std::string_view);
+        Result execute(const double* = nullptr) const;
+
+        std::size_t slot(std::string_view) const;
+        std::string_view message(const Error&);
+        const Program &program() const;
+        const FormatOptions &options() const;
+
+    private:
+        // last compiled expression and its syntax error, compile is skipped when the same text comes again
+        std::string source;
+        Program compiled;
+        Error compile_error;
+        bool compiled_once = false;
+
+        FormulaGraph formulas;
+        FormatOptions format;
+        std::string text;
+};
\ No newline at end of file
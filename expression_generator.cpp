@@ -0,0 +1,117 @@
+#include "expression_generator.h"
+
+// building blocks of generated expressions
+const char *NUMBERS[] = {"1", "2", "3.5", "0.25", "7", "10", "42", "1.5", "9", "0.5"};
+const char *VARIABLES[] = {"x", "y"};
+const char *FUNCTIONS[] = {"sin", "cos", "tan", "cot", "log", "ln"};
+
+
+/**
+ * @brief Creates generator, equal configs produce equal sequences
+ * 
+ * @param settings shape of generated expressions
+ */
+ExpressionGenerator::ExpressionGenerator(const GeneratorConfig &settings) : config(settings), rng(settings.seed)
+{
+}
+
+
+/**
+ * @brief Generates the next expression
+ * 
+ * @return std::string infix notation expression
+ */
+std::string ExpressionGenerator::next()
+{
+    std::string expression;
+    next(expression);
+
+    return expression;
+}
+
+
+/**
+ * @brief Generates the next expression into an existing string
+ * 
+ * @param expression receives the infix notation expression
+ */
+void ExpressionGenerator::next(std::string &expression)
+{
+    expression.clear();
+    sum(expression, config.terms, 0);
+}
+
+
+/**
+ * @brief Appends terms joined by binary operators
+ * 
+ * @param out expression being built
+ * @param terms number of operands
+ * @param depth current bracket depth
+ */
+void ExpressionGenerator::sum(std::string &out, std::size_t terms, int depth)
+{
+    for (std::size_t i = 0; i < terms; i++)
+    {
+        if (i > 0)
+        {
+            if (chance(config.power_share))
+                out += "^";
+            else if (chance(config.product_share))
+                out += (rng() % 4 == 0) ? " / " : " * ";
+            else
+                out += (rng() % 2 == 0) ? " + " : " - ";
+        }
+
+        operand(out, depth);
+    }
+}
+
+
+/**
+ * @brief Appends number, variable, function call or bracketed subexpression
+ * 
+ * @param out expression being built
+ * @param depth current bracket depth
+ */
+void ExpressionGenerator::operand(std::string &out, int depth)
+{
+    if (chance(config.unary_share))
+        out += "-";
+
+    if (depth < config.max_depth && chance(config.function_share))
+    {
+        out += FUNCTIONS[rng() % 6];
+        out += "(";
+        sum(out, 1 + rng() % config.bracket_terms, depth + 1);
+        out += ")";
+    }
+    else if (depth < config.max_depth && chance(config.bracket_share))
+    {
+        bool braces = rng() % 4 == 0;
+
+        out += braces ? "{" : "(";
+        sum(out, 1 + rng() % config.bracket_terms, depth + 1);
+        out += braces ? "}" : ")";
+    }
+    else if (config.variables && rng() % 2 == 0)
+    {
+        out += VARIABLES[rng() % 2];
+    }
+    else
+    {
+        out += NUMBERS[rng() % 10];
+    }
+}
+
+
+/**
+ * @brief Random decision
+ * 
+ * @param share probability of true
+ * @return true with probability share
+ */
+bool ExpressionGenerator::chance(double share)
+{
+    return std::uniform_real_distribution<double>(0, 1)(rng) < share;
+}
\ No newline at end of file
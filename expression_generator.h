@@ -0,0 +1,40 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <cstdint>
+
+
+// shape of generated expressions
+struct GeneratorConfig
+{
+    std::uint32_t seed = 480;
+    std::size_t terms = 8;
+    std::size_t bracket_terms = 3;
+    int max_depth = 3;
+    double bracket_share = 0.2;
+    double function_share = 0.1;
+    double power_share = 0.05;
+    double product_share = 0.4;
+    double unary_share = 0.1;
+    bool variables = false;
+};
+
+
+// seeded source of synthetic infix expressions for benchmarks
+class ExpressionGenerator
+{
+    public:
+        explicit ExpressionGenerator(const GeneratorConfig&);
+
+        std::string next();
+        void next(std::string&);
+
+    private:
+        void sum(std::string&, std::size_t, int);
+        void operand(std::string&, int);
+        bool chance(double);
+
+        GeneratorConfig config;
+        std::mt19937 rng;
+};
\ No newline at end of file
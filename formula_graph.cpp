@@ -0,0 +1,324 @@
+#include "formula_graph.h"
+#include "stats.h"
+
+
+/**
+ * @brief Evaluates an assignment or an expression that may use defined names
+ * 
+ * "name = expression" defines or changes a formula and reports it with the number of
+ * formulas recomputed, anything else is evaluated with the current formula values.
+ * 
+ * @param line assignment or infix notation expression
+ * @param out text the result or error message is appended to
+ * @param options notation and precision of the result
+ * @return true out holds a result
+ * @return false out holds an error message
+ */
+bool FormulaGraph::evaluate(std::string_view line, std::string &out, const FormatOptions &options)
+{
+    std::string_view name;
+    std::string_view expression = line;
+    bool assigning = EvaluateExpression::assignment(line, name, expression);
+
+    Program program;
+    Error error = EvaluateExpression::compile(expression, program);
+
+    if (!error && assigning)
+    {
+        std::size_t recomputed = 0;
+        error = define(name, expression, std::move(program), recomputed);
+
+        if (!error)
+        {
+            const Node &assigned = nodes[index.find(std::string(name))->second];
+
+            if (assigned.error)
+            {
+                describe(assigned, out);
+            }
+            else
+            {
+                out += name;
+                out += " = ";
+                EvaluateExpression::format(assigned.value, options, out);
+            }
+
+            out += " (" + std::to_string(recomputed) + (recomputed == 1 ? " formula" : " formulas") + " recomputed)";
+            return !assigned.error;
+        }
+    }
+    else if (!error)
+    {
+        values.resize(program.variables.size());
+
+        for (std::size_t slot = 0; slot < program.variables.size(); slot++)
+        {
+            std::unordered_map<std::string, std::size_t>::iterator found = index.find(program.variables[slot]);
+
+            if (found == index.end() || !nodes[found->second].defined)
+            {
+                error = {ErrorCode::UNKNOWN_VARIABLE, static_cast<std::uint32_t>(slot)};
+                break;
+            }
+
+            // a failed formula fails every expression that uses it
+            const Node &input = nodes[found->second];
+
+            if (input.error)
+            {
+                STATS_ERROR(input.error.code);
+                describe(input, out);
+                return false;
+            }
+
+            values[slot] = input.value;
+        }
+
+        double result;
+
+        if (!error)
+            error = EvaluateExpression::execute(program, values.data(), result);
+
+        if (!error)
+        {
+            EvaluateExpression::format(result, options, out);
+            return true;
+        }
+    }
+
+    STATS_ERROR(error.code);
+    EvaluateExpression::describe(error, expression, program, out);
+
+    return false;
+}
+
+
+/**
+ * @brief Defines or changes a formula and recomputes everything that depends on it
+ * 
+ * Names the formula uses become nodes even before they are defined, formulas using an
+ * undefined name report it as an unknown variable until it is. A definition that would
+ * make the formula depend on itself is rejected and the previous one is kept.
+ * 
+ * @param name formula name
+ * @param text infix notation expression of the formula
+ * @param program compiled text, only moved from when the definition is accepted
+ * @param recomputed receives the number of formulas recomputed, including this one
+ * @return Error circular reference through the variable slot that closes the cycle, if any
+ */
+Error FormulaGraph::define(std::string_view name, std::string_view text, Program &&program, std::size_t &recomputed)
+{
+    recomputed = 0;
+
+    std::size_t target = node(name);
+    std::vector<std::size_t> inputs;
+
+    for (const std::string &variable : program.variables)
+        inputs.push_back(node(variable));
+
+    if (Error error = cycle(target, inputs))
+        return error;
+
+    Node &formula = nodes[target];
+
+    for (std::size_t input : formula.inputs)
+    {
+        std::vector<std::size_t> &dependents = nodes[input].dependents;
+        dependents.erase(std::find(dependents.begin(), dependents.end(), target));
+    }
+
+    for (std::size_t input : inputs)
+        nodes[input].dependents.push_back(target);
+
+    formula.text = text;
+    formula.program = std::move(program);
+    formula.inputs = std::move(inputs);
+    formula.defined = true;
+
+    recomputed = recompute(target);
+    return {};
+}
+
+
+/**
+ * @brief Number of names known, defined or only referenced
+ * 
+ * @return std::size_t number of nodes
+ */
+std::size_t FormulaGraph::size() const
+{
+    return nodes.size();
+}
+
+
+/**
+ * @brief Finds the node of a name, adding an undefined one the first time it is seen
+ * 
+ * @param name formula name
+ * @return std::size_t node index
+ */
+std::size_t FormulaGraph::node(std::string_view name)
+{
+    std::pair<std::unordered_map<std::string, std::size_t>::iterator, bool> inserted = index.emplace(name, nodes.size());
+
+    if (inserted.second)
+    {
+        nodes.emplace_back();
+        nodes.back().name = name;
+    }
+
+    return inserted.first->second;
+}
+
+
+/**
+ * @brief Checks whether new inputs of a formula would depend on the formula itself
+ * 
+ * Inputs are searched upstream with one shared visited mark, a node that does not
+ * lead back to the target from one input cannot from another either.
+ * 
+ * @param target formula being defined
+ * @param inputs node of every variable of the new definition
+ * @return Error circular reference through the first input leading back to target, if any
+ */
+Error FormulaGraph::cycle(std::size_t target, const std::vector<std::size_t> &inputs)
+{
+    traversal++;
+
+    for (std::size_t slot = 0; slot < inputs.size(); slot++)
+    {
+        order.assign(1, inputs[slot]);
+
+        while (order.size() > 0)
+        {
+            std::size_t current = order.back();
+            order.pop_back();
+
+            if (current == target)
+                return {ErrorCode::CIRCULAR_REFERENCE, static_cast<std::uint32_t>(slot)};
+
+            if (nodes[current].mark == traversal)
+                continue;
+
+            nodes[current].mark = traversal;
+            order.insert(order.end(), nodes[current].inputs.begin(), nodes[current].inputs.end());
+        }
+    }
+
+    return {};
+}
+
+
+/**
+ * @brief Recomputes a formula and everything downstream of it, each once and after its inputs
+ * 
+ * Dirty nodes are collected first, then recomputed in topological order by counting
+ * the dirty inputs each one still waits for.
+ * 
+ * @param changed formula that was defined or changed
+ * @return std::size_t number of formulas recomputed
+ */
+std::size_t FormulaGraph::recompute(std::size_t changed)
+{
+    traversal++;
+
+    order.assign(1, changed);
+    nodes[changed].mark = traversal;
+
+    for (std::size_t i = 0; i < order.size(); i++)
+    {
+        for (std::size_t dependent : nodes[order[i]].dependents)
+        {
+            if (nodes[dependent].mark != traversal)
+            {
+                nodes[dependent].mark = traversal;
+                order.push_back(dependent);
+            }
+        }
+    }
+
+    for (std::size_t dirty : order)
+    {
+        Node &formula = nodes[dirty];
+        formula.pending = 0;
+
+        for (std::size_t input : formula.inputs)
+        {
+            if (nodes[input].mark == traversal)
+                formula.pending++;
+        }
+    }
+
+    // the changed formula has no dirty inputs, so it comes first
+    std::size_t recomputed = 0;
+
+    order.assign(1, changed);
+
+    while (order.size() > 0)
+    {
+        std::size_t current = order.back();
+        order.pop_back();
+
+        update(current);
+        recomputed++;
+
+        for (std::size_t dependent : nodes[current].dependents)
+        {
+            if (--nodes[dependent].pending == 0)
+                order.push_back(dependent);
+        }
+    }
+
+    return recomputed;
+}
+
+
+/**
+ * @brief Evaluates one formula from the current values of its inputs
+ * 
+ * @param id formula node
+ */
+void FormulaGraph::update(std::size_t id)
+{
+    Node &formula = nodes[id];
+
+    formula.error = {};
+    formula.source = id;
+    values.resize(formula.inputs.size());
+
+    for (std::size_t slot = 0; slot < formula.inputs.size(); slot++)
+    {
+        const Node &input = nodes[formula.inputs[slot]];
+
+        if (!input.defined)
+        {
+            formula.error = {ErrorCode::UNKNOWN_VARIABLE, static_cast<std::uint32_t>(slot)};
+            return;
+        }
+
+        // errors pass downstream with the formula they were found in
+        if (input.error)
+        {
+            formula.error = input.error;
+            formula.source = input.source;
+            return;
+        }
+
+        values[slot] = input.value;
+    }
+
+    formula.error = EvaluateExpression::execute(formula.program, values.data(), formula.value);
+}
+
+
+/**
+ * @brief Appends the error message of a formula
+ * 
+ * @param formula formula with an error
+ * @param out text the message is appended to
+ */
+void FormulaGraph::describe(const Node &formula, std::string &out) const
+{
+    const Node &source = nodes[formula.source];
+    EvaluateExpression::describe(formula.error, source.text, source.program, out);
+}
\ No newline at end of file
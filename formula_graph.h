@@ -0,0 +1,55 @@
+#pragma once
+
+#include "evaluate_expression.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+
+// named formulas that reference each other, a change recomputes only the formulas downstream of it
+class FormulaGraph
+{
+    public:
+        bool evaluate(std::string_view, std::string&, const FormatOptions& = FormatOptions());
+        Error define(std::string_view, std::string_view, Program&&, std::size_t&);
+        std::size_t size() const;
+
+    private:
+        // one formula, or a name that is referenced but not defined yet
+        struct Node
+        {
+            std::string name;
+            std::string text;
+            Program program;
+            bool defined = false;
+
+            // node of every program variable in slot order, and the formulas that use this one
+            std::vector<std::size_t> inputs;
+            std::vector<std::size_t> dependents;
+
+            // result, or the error and the node whose formula it was found in
+            double value = 0;
+            Error error;
+            std::size_t source = 0;
+
+            // last traversal that visited the node, and its dirty inputs not yet recomputed
+            std::uint64_t mark = 0;
+            std::size_t pending = 0;
+        };
+
+        std::size_t node(std::string_view);
+        Error cycle(std::size_t, const std::vector<std::size_t>&);
+        std::size_t recompute(std::size_t);
+        void update(std::size_t);
+        void describe(const Node&, std::string&) const;
+
+        std::vector<Node> nodes;
+        std::unordered_map<std::string, std::size_t> index;
+        std::uint64_t traversal = 0;
+
+        // buffers reused between updates
+        std::vector<std::size_t> order;
+        std::vector<double> values;
+};
\ No newline at end of file
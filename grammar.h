@@ -0,0 +1,735 @@
+#pragma once
+
+#include "evaluate_expression.h"
+#include <array>
+#include <limits>
+#include <cstdint>
+
+
+// tokenizer, Shunting Yard and postfix code steps shared by EvaluateExpression, StreamParser and
+// calc::StaticProgram. Each reads characters its own way, parses numbers, looks names up and folds
+// constants with what it has at hand, and feeds the result through the same grammar, so errors and
+// offsets agree everywhere
+
+// what the tokenizer does with a character, numbers take dots and names take underscores
+enum class CharClass : std::uint8_t
+{
+    UNKNOWN, BLANK, DIGIT, LETTER, SYMBOL
+};
+
+
+// class of a character and the token a single character symbol makes
+struct CharEntry
+{
+    CharClass kind;
+    TokenKind token;
+    OpCode op;
+};
+
+
+/**
+ * @brief Builds the table of every character, anything not listed is an unknown operator
+ * 
+ * @return std::array<CharEntry, 256> entry of every unsigned char
+ */
+constexpr std::array<CharEntry, 256> character_table()
+{
+    std::array<CharEntry, 256> table = {};
+
+    for (CharEntry &entry : table)
+        entry = {CharClass::UNKNOWN, TokenKind::OPERATOR, OpCode::PUSH};
+
+    table[' '].kind = CharClass::BLANK;
+    table['.'].kind = CharClass::DIGIT;
+    table['_'].kind = CharClass::LETTER;
+
+    for (char c = '0'; c <= '9'; c++)
+        table[static_cast<unsigned char>(c)].kind = CharClass::DIGIT;
+
+    for (char c = 'a'; c <= 'z'; c++)
+    {
+        table[static_cast<unsigned char>(c)].kind = CharClass::LETTER;
+        table[static_cast<unsigned char>(c - 'a' + 'A')].kind = CharClass::LETTER;
+    }
+
+    table['+'] = {CharClass::SYMBOL, TokenKind::OPERATOR, OpCode::ADD};
+    table['-'] = {CharClass::SYMBOL, TokenKind::OPERATOR, OpCode::SUB};
+    table['*'] = {CharClass::SYMBOL, TokenKind::OPERATOR, OpCode::MUL};
+    table['/'] = {CharClass::SYMBOL, TokenKind::OPERATOR, OpCode::DIV};
+    table['^'] = {CharClass::SYMBOL, TokenKind::OPERATOR, OpCode::POW};
+    table['('] = {CharClass::SYMBOL, TokenKind::OPEN_PARENTHESIS, OpCode::PUSH};
+    table[')'] = {CharClass::SYMBOL, TokenKind::CLOSE_PARENTHESIS, OpCode::PUSH};
+    table['{'] = {CharClass::SYMBOL, TokenKind::OPEN_BRACKET, OpCode::PUSH};
+    table['}'] = {CharClass::SYMBOL, TokenKind::CLOSE_BRACKET, OpCode::PUSH};
+    table[','] = {CharClass::SYMBOL, TokenKind::SEPARATOR, OpCode::PUSH};
+
+    return table;
+}
+
+
+// entry of every character, index with the character as unsigned char
+constexpr std::array<CharEntry, 256> CHARACTERS = character_table();
+
+
+/**
+ * @brief Entry of a character
+ * 
+ * @param c any character
+ * @return const CharEntry& its class and symbol token
+ */
+constexpr const CharEntry &character(char c)
+{
+    return CHARACTERS[static_cast<unsigned char>(c)];
+}
+
+
+// state of the tokenizer between tokens. Numbers, functions and variables are handed in whole, symbols
+// one character at a time, and tokens go to a sink with push_back. Stack holds ints for each bracket level
+template <typename Stack>
+class Tokenizer
+{
+    public:
+        constexpr Tokenizer();
+
+        constexpr void reset();
+        constexpr Error next(char) const;
+
+        template <typename Sink>
+        constexpr void value(const Token&, std::size_t, Sink&);
+
+        template <typename Sink>
+        constexpr void function(const Token&, Sink&);
+
+        template <typename Sink>
+        constexpr Error symbol(char, std::size_t, Sink&);
+
+        template <typename Sink>
+        constexpr Error finish(std::size_t, Sink&);
+
+    private:
+        template <typename Sink>
+        constexpr void push(const Token&, Sink&);
+
+        template <typename Sink>
+        constexpr void close_unary(std::size_t, Sink&);
+
+        // unary operator checks
+        bool allow_binary = false;
+        bool unary_needs_num = false;
+
+        // whether the brackets/parentheses need to be filled or not
+        bool need_fill = false;
+
+        // number of brackets/parentheses left open
+        int open_brackets = 0;
+        int open_parenthesis = 0;
+
+        // parentheses to close around (-1 * x) for each bracket level
+        Stack bracket_after;
+
+        // separators still expected for each bracket level, brackets of a function of two take one
+        Stack separators;
+
+        // nothing before the first token, no bracket to multiply and no function waiting for operands
+        Token last = {TokenKind::SEPARATOR, OpCode::PUSH, 0, 0};
+};
+
+
+/**
+ * @brief Creates a tokenizer waiting for the first token
+ */
+template <typename Stack>
+constexpr Tokenizer<Stack>::Tokenizer()
+{
+    reset();
+}
+
+
+/**
+ * @brief Starts a new expression, keeping the memory of the stacks
+ */
+template <typename Stack>
+constexpr void Tokenizer<Stack>::reset()
+{
+    allow_binary = false;
+    unary_needs_num = false;
+    need_fill = false;
+    open_brackets = 0;
+    open_parenthesis = 0;
+
+    bracket_after.clear();
+    bracket_after.push_back(0);
+    separators.clear();
+    separators.push_back(0);
+
+    last = {TokenKind::SEPARATOR, OpCode::PUSH, 0, 0};
+}
+
+
+/**
+ * @brief Checks that a character other than blank space may follow the last token
+ * 
+ * @param c next character that is not blank space
+ * @return Error invalid use of a function of two whose operands do not follow in brackets
+ */
+template <typename Stack>
+constexpr Error Tokenizer<Stack>::next(char c) const
+{
+    // operands of a function of two follow it in brackets
+    if (last.op == OpCode::CALL2 && c != '(' && c != '{')
+        return {ErrorCode::INVALID_OPERATOR_USE, static_cast<std::uint32_t>(last.offset)};
+
+    return {};
+}
+
+
+/**
+ * @brief Takes a number or variable
+ * 
+ * @param token NUMBER or VARIABLE token with its value or slot
+ * @param end offset of the last character of the number or name
+ * @param sink receives the token and the parentheses it closes
+ */
+template <typename Stack>
+template <typename Sink>
+constexpr void Tokenizer<Stack>::value(const Token &token, std::size_t end, Sink &sink)
+{
+    // brackets/parentheses no longer empty
+    need_fill = false;
+
+    // allow binary operators
+    allow_binary = true;
+
+    push(token, sink);
+
+    // close parenthesis around (-1 * x)
+    if (unary_needs_num)
+    {
+        unary_needs_num = false;
+        close_unary(end, sink);
+    }
+}
+
+
+/**
+ * @brief Takes a function name
+ * 
+ * @param token OPERATOR token of the function with its native slot
+ * @param sink receives the token
+ */
+template <typename Stack>
+template <typename Sink>
+constexpr void Tokenizer<Stack>::function(const Token &token, Sink &sink)
+{
+    push(token, sink);
+    need_fill = true;
+    allow_binary = false;
+}
+
+
+/**
+ * @brief Takes an operator, bracket or separator character
+ * 
+ * @param c character other than blank space, digits, dots, letters and underscores
+ * @param offset position of the character in the expression
+ * @param sink receives the tokens of the character
+ * @return Error first error found, if any
+ */
+template <typename Stack>
+template <typename Sink>
+constexpr Error Tokenizer<Stack>::symbol(char c, std::size_t offset, Sink &sink)
+{
+    const CharEntry &entry = character(c);
+    std::uint32_t at = static_cast<std::uint32_t>(offset);
+
+    // invalid expression
+    if (entry.kind != CharClass::SYMBOL)
+        return {ErrorCode::UNKNOWN_OPERATOR, at};
+
+    // check for unary operator
+    if (entry.op == OpCode::SUB && !allow_binary)
+    {
+        // change unary to (-1 * x)
+        push({TokenKind::OPEN_PARENTHESIS, OpCode::PUSH, 0, offset}, sink);
+        push({TokenKind::NUMBER, OpCode::PUSH, -1, offset}, sink);
+        push({TokenKind::OPERATOR, OpCode::MUL, 0, offset}, sink);
+
+        bracket_after.back()++;
+        unary_needs_num = true;
+    }
+    // check for power, which may follow anything
+    else if (entry.op == OpCode::POW)
+    {
+        push({TokenKind::OPERATOR, OpCode::POW, 0, offset}, sink);
+        need_fill = true;
+        allow_binary = false;
+    }
+    // check for binary operator
+    else if (entry.token == TokenKind::OPERATOR)
+    {
+        if (!allow_binary)
+            return {ErrorCode::INVALID_OPERATOR_USE, at};
+
+        push({TokenKind::OPERATOR, entry.op, 0, offset}, sink);
+        allow_binary = false;
+    }
+    // check for parenthesis/bracket
+    else if (entry.token == TokenKind::OPEN_PARENTHESIS || entry.token == TokenKind::OPEN_BRACKET)
+    {
+        // check last token for bracket
+        if (last.kind == TokenKind::CLOSE_PARENTHESIS || last.kind == TokenKind::CLOSE_BRACKET)
+            push({TokenKind::OPERATOR, OpCode::MUL, 0, offset}, sink);
+
+        bool call = last.op == OpCode::CALL2;
+        separators.push_back(call ? OPERATORS[static_cast<int>(OpCode::CALL2)].arity - 1 : 0);
+
+        push({entry.token, OpCode::PUSH, 0, offset}, sink);
+
+        if (entry.token == TokenKind::OPEN_PARENTHESIS)
+            open_parenthesis++;
+        else
+            open_brackets++;
+
+        need_fill = true;
+        allow_binary = false;
+        unary_needs_num = false;
+        bracket_after.push_back(0);
+    }
+    else if (entry.token == TokenKind::CLOSE_PARENTHESIS || entry.token == TokenKind::CLOSE_BRACKET)
+    {
+        // invalid expression
+        if (need_fill)
+            return {ErrorCode::EMPTY_BRACKETS, at};
+
+        // function of two given one operand
+        if (separators.back() > 0)
+            return {ErrorCode::MISSING_VALUES, at};
+
+        push({entry.token, OpCode::PUSH, 0, offset}, sink);
+
+        if (entry.token == TokenKind::CLOSE_PARENTHESIS)
+            open_parenthesis--;
+        else
+            open_brackets--;
+
+        // closing more than was opened
+        if (open_parenthesis < 0 || open_brackets < 0)
+            return {ErrorCode::UNCLOSED_BRACKETS, at};
+
+        // allow binary operators
+        allow_binary = true;
+
+        bracket_after.pop_back();
+        separators.pop_back();
+
+        close_unary(offset, sink);
+    }
+    // separator between the operands of a function
+    else
+    {
+        // only the brackets of a function call separate operands
+        if (separators.back() == 0)
+            return {ErrorCode::UNKNOWN_OPERATOR, at};
+
+        if (!allow_binary)
+            return {ErrorCode::INVALID_OPERATOR_USE, at};
+
+        push({TokenKind::SEPARATOR, OpCode::PUSH, 0, offset}, sink);
+        separators.back()--;
+        need_fill = true;
+        allow_binary = false;
+    }
+
+    return {};
+}
+
+
+/**
+ * @brief Ends the expression, closing the parentheses of a trailing unary minus
+ * 
+ * @param length length of the whole expression
+ * @param sink receives the closing parentheses
+ * @return Error unclosed brackets or a unary minus without operand, if any
+ */
+template <typename Stack>
+template <typename Sink>
+constexpr Error Tokenizer<Stack>::finish(std::size_t length, Sink &sink)
+{
+    // add final parenthesis
+    close_unary(length, sink);
+
+    // check for errors
+    if (open_parenthesis != 0 || open_brackets != 0)
+        return {ErrorCode::UNCLOSED_BRACKETS, static_cast<std::uint32_t>(length)};
+    else if (unary_needs_num)
+        return {ErrorCode::UNARY_OPERATOR, static_cast<std::uint32_t>(length)};
+
+    return {};
+}
+
+
+/**
+ * @brief Hands a token to the sink and remembers it
+ * 
+ * @param token next token
+ * @param sink receives the token
+ */
+template <typename Stack>
+template <typename Sink>
+constexpr void Tokenizer<Stack>::push(const Token &token, Sink &sink)
+{
+    last = token;
+    sink.push_back(token);
+}
+
+
+/**
+ * @brief Closes the parentheses opened around (-1 * x) on the current bracket level
+ * 
+ * @param offset position the parentheses are closed at
+ * @param sink receives the closing parentheses
+ */
+template <typename Stack>
+template <typename Sink>
+constexpr void Tokenizer<Stack>::close_unary(std::size_t offset, Sink &sink)
+{
+    while (bracket_after.back() > 0)
+    {
+        push({TokenKind::CLOSE_PARENTHESIS, OpCode::PUSH, 0, offset}, sink);
+        bracket_after.back()--;
+    }
+}
+
+
+// operators waiting for their operands while tokens are turned into postfix order by the Shunting Yard
+// algorithm. Values and operators leave through an output called with each token, whose error stops
+// the conversion. Stack holds Tokens
+template <typename Stack>
+class ShuntingYard
+{
+    public:
+        constexpr void reset();
+
+        template <typename Output>
+        constexpr Error push(const Token&, Output&);
+
+        template <typename Output>
+        constexpr Error finish(Output&);
+
+    private:
+        template <typename Output>
+        constexpr Error reduce(Output&);
+
+        Stack operators;
+};
+
+
+/**
+ * @brief Starts a new expression, keeping the memory of the stack
+ */
+template <typename Stack>
+constexpr void ShuntingYard<Stack>::reset()
+{
+    operators.clear();
+}
+
+
+/**
+ * @brief Takes the next token of the expression
+ * 
+ * @param token next token
+ * @param output called with every value and operator in postfix order
+ * @return Error first error of the output or an unclosed bracket, if any
+ */
+template <typename Stack>
+template <typename Output>
+constexpr Error ShuntingYard<Stack>::push(const Token &token, Output &output)
+{
+    // token is number or variable
+    if (token.kind == TokenKind::NUMBER || token.kind == TokenKind::VARIABLE)
+        return output(token);
+
+    // token is operator
+    if (token.kind == TokenKind::OPERATOR)
+    {
+        const OperatorInfo &info = OPERATORS[static_cast<int>(token.op)];
+
+        while (operators.size() > 0 && operators.back().kind == TokenKind::OPERATOR)
+        {
+            int stack_prec = OPERATORS[static_cast<int>(operators.back().op)].precedence;
+
+            // pop from the stack if its top has greater precedence
+            // or if same precedence and token is left associative
+            if (info.precedence > stack_prec || (stack_prec == info.precedence && info.right_associative))
+                break;
+
+            if (Error error = output(operators.back()))
+                return error;
+
+            operators.pop_back();
+        }
+
+        operators.push_back(token);
+    }
+    else if (token.kind == TokenKind::OPEN_PARENTHESIS || token.kind == TokenKind::OPEN_BRACKET)
+    {
+        operators.push_back(token);
+    }
+    else
+    {
+        // finish the operand or bracket, the bracket of a function stays open at a separator
+        if (Error error = reduce(output))
+            return error;
+
+        if (token.kind == TokenKind::SEPARATOR)
+            return {};
+
+        // get closing bracket/parenthesis
+        TokenKind closing = (token.kind == TokenKind::CLOSE_PARENTHESIS) ? TokenKind::OPEN_PARENTHESIS
+                                                                          : TokenKind::OPEN_BRACKET;
+
+        // brackets/parentheses must be closed in order
+        if (operators.size() == 0 || operators.back().kind != closing)
+            return {ErrorCode::UNCLOSED_BRACKETS, static_cast<std::uint32_t>(token.offset)};
+
+        operators.pop_back();
+    }
+
+    return {};
+}
+
+
+/**
+ * @brief Ends the expression, passing the operators still waiting to the output
+ * 
+ * @param output called with every operator left, an open bracket is handed over as well
+ * @return Error first error of the output, if any
+ */
+template <typename Stack>
+template <typename Output>
+constexpr Error ShuntingYard<Stack>::finish(Output &output)
+{
+    while (operators.size() > 0)
+    {
+        if (Error error = output(operators.back()))
+            return error;
+
+        operators.pop_back();
+    }
+
+    return {};
+}
+
+
+/**
+ * @brief Passes the operators above the innermost open bracket to the output
+ * 
+ * @param output called with every operator
+ * @return Error first error of the output, if any
+ */
+template <typename Stack>
+template <typename Output>
+constexpr Error ShuntingYard<Stack>::reduce(Output &output)
+{
+    while (operators.size() > 0 && operators.back().kind == TokenKind::OPERATOR)
+    {
+        if (Error error = output(operators.back()))
+            return error;
+
+        operators.pop_back();
+    }
+
+    return {};
+}
+
+// slot of PUSH instructions the optimizer has removed but not yet compacted
+constexpr std::uint32_t REMOVED = std::numeric_limits<std::uint32_t>::max();
+
+
+// steps from Shunting Yard output to finished postfix code. Code is a vector of Instructions with
+// push_back, resize and indexing, Operands a stack of Operand for the optimizer
+class PostfixCode
+{
+    public:
+        // value on the stack while simplifying: where its code starts and whether it is constant
+        struct Operand
+        {
+            std::size_t start;
+            bool constant;
+            double value;
+        };
+
+        template <typename Code>
+        static constexpr Error emit(const Token&, Code&, std::size_t&, std::size_t&);
+
+        template <typename Code, typename Operands, typename Fold>
+        static constexpr std::size_t optimize(Code&, Operands&, const Fold&, std::size_t&);
+};
+
+
+/**
+ * @brief Appends number, variable or operator token to code and checks operator arity
+ * 
+ * @param token number, variable or operator token
+ * @param code code being built
+ * @param depth current size of the value stack
+ * @param stack_size most values on the stack so far
+ * @return Error missing operands or an unclosed bracket, if any
+ */
+template <typename Code>
+constexpr Error PostfixCode::emit(const Token &token, Code &code, std::size_t &depth, std::size_t &stack_size)
+{
+    if (token.kind == TokenKind::NUMBER || token.kind == TokenKind::VARIABLE)
+    {
+        code.push_back({token.op, token.slot, token.value});
+        depth++;
+
+        if (depth > stack_size)
+            stack_size = depth;
+    }
+    else if (token.kind == TokenKind::OPERATOR)
+    {
+        std::size_t takes = OPERATORS[static_cast<int>(token.op)].arity;
+
+        if (depth < takes)
+            return {ErrorCode::MISSING_VALUES, static_cast<std::uint32_t>(token.offset)};
+
+        // native functions cannot fail and keep their slot instead of the offset
+        bool call = token.op == OpCode::CALL1 || token.op == OpCode::CALL2;
+        code.push_back({token.op, call ? token.slot : static_cast<std::uint32_t>(token.offset), 0});
+        depth -= takes - 1;
+    }
+    else
+    {
+        return {ErrorCode::UNCLOSED_BRACKETS, static_cast<std::uint32_t>(token.offset)};
+    }
+
+    return {};
+}
+
+
+/**
+ * @brief Folds constant subexpressions and removes redundant instructions
+ * 
+ * Constants are folded unless the operation would fail, so division by zero and negative
+ * logarithms still fail when the code runs, and fold may refuse others. (-1 * x) becomes a
+ * negation and double negations cancel out. x * 1, 1 * x, x / 1, x ^ 1 and x - 0 become x.
+ * x + 0 is kept since it turns -0 into 0.
+ * 
+ * @param code code to simplify in place
+ * @param operands empty stack for the values of the code
+ * @param fold called as fold(instr, first, second, result), false leaves the operation in the code
+ * @param stack_size receives the most values on the stack while the simplified code runs
+ * @return std::size_t number of instructions removed
+ */
+template <typename Code, typename Operands, typename Fold>
+constexpr std::size_t PostfixCode::optimize(Code &code, Operands &operands, const Fold &fold, std::size_t &stack_size)
+{
+    // simplified code is written over the front of the original code
+    std::size_t length = code.size();
+    std::size_t size = 0;
+
+    // removed left operands still in the code
+    std::size_t marked = 0;
+
+    for (std::size_t i = 0; i < length; i++)
+    {
+        Instruction instr = code[i];
+
+        if (instr.op == OpCode::PUSH || instr.op == OpCode::LOAD)
+        {
+            operands.push_back({size, instr.op == OpCode::PUSH, instr.value});
+            code[size++] = instr;
+            continue;
+        }
+
+        bool binary = OPERATORS[static_cast<int>(instr.op)].arity == 2;
+
+        Operand second = {size, true, 0};
+
+        if (binary)
+        {
+            second = operands.back();
+            operands.pop_back();
+        }
+
+        Operand &first = operands.back();
+
+        // fold constants unless the operation reports an error
+        bool fails = (instr.op == OpCode::DIV && second.value == 0) ||
+                     ((instr.op == OpCode::LOG || instr.op == OpCode::LN) && first.value < 0);
+        double folded = 0;
+
+        if (first.constant && second.constant && !fails && fold(instr, first.value, second.value, folded))
+        {
+            first.value = folded;
+            code[first.start] = {OpCode::PUSH, 0, first.value};
+            size = first.start + 1;
+            continue;
+        }
+
+        bool negate = false;
+
+        // drop constant right operand
+        if (binary && second.constant &&
+            ((second.value == 1 && (instr.op == OpCode::MUL || instr.op == OpCode::DIV || instr.op == OpCode::POW)) ||
+             (second.value == 0 && !std::signbit(second.value) && instr.op == OpCode::SUB) ||
+             (second.value == -1 && instr.op == OpCode::MUL)))
+        {
+            negate = second.value == -1;
+            size = second.start;
+        }
+        // drop constant left operand, it is marked and compacted at the end so nesting stays linear
+        else if (binary && first.constant && instr.op == OpCode::MUL && (first.value == 1 || first.value == -1))
+        {
+            negate = first.value == -1;
+            code[first.start].slot = REMOVED;
+            marked++;
+        }
+        else
+        {
+            code[size++] = instr;
+            first.constant = false;
+            continue;
+        }
+
+        first.constant = false;
+
+        // -(-x) is x
+        if (negate && code[size - 1].op == OpCode::NEG)
+            size--;
+        else if (negate)
+            code[size++] = {OpCode::NEG, 0, 0};
+    }
+
+    if (marked > 0)
+    {
+        std::size_t kept = 0;
+
+        for (std::size_t i = 0; i < size; i++)
+        {
+            if (code[i].op != OpCode::PUSH || code[i].slot != REMOVED)
+                code[kept++] = code[i];
+        }
+
+        size = kept;
+    }
+
+    code.resize(size);
+
+    // simplified code never needs more stack than before, recount it
+    std::size_t depth = 0;
+    stack_size = 0;
+
+    for (std::size_t i = 0; i < size; i++)
+    {
+        if (code[i].op == OpCode::PUSH || code[i].op == OpCode::LOAD)
+            depth++;
+        else if (OPERATORS[static_cast<int>(code[i].op)].arity == 2)
+            depth--;
+
+        stack_size = std::max(stack_size, depth);
+    }
+
+    return length - size;
+}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "handle_input.h"
-#include "evaluate_expression.h"
+#include "evaluation_context.h"
+#include "stats.h"
 
 
 /**
@@ -19,7 +20,7 @@ std::string HandleInput::get_input()
 
 
 /**
- * @brief Checks input and either prints the user manual or expression evaluation
+ * @brief Checks input and either prints the user manual, statistics, a formula assignment or expression evaluation
  * 
  * @param expression user input
  */
@@ -29,13 +30,27 @@ void HandleInput::check_input(std::string expression, bool &run_calc)
     {
         manual();
     }
+    else if (expression == "stats")
+    {
+        Stats::print(std::cout);
+    }
     else if (expression == "exit")
     {
         run_calc = false;
     }
     else
     {
-        EvaluateExpression::evaluate(expression);
+        // formulas and the last program stay in the context for the whole session
+        static EvaluationContext context;
+        static std::string out;
+
+        // cout is flushed by the next read from cin, so no flush per result
+        out.clear();
+
+        if (context.evaluate(expression, out))
+            std::cout << "Result: " << out << '\n';
+        else
+            std::cerr << out << '\n';
     }
 }
 
@@ -62,6 +77,11 @@ void HandleInput::manual()
     std::cout << "\t\tcot = cotangent" << std::endl;
     std::cout << "\t\tlog = logarithm base 10" << std::endl;
     std::cout << "\t\tln = natural logarithm" << std::endl;
+    std::cout << "\t\tsqrt = square root" << std::endl;
+    std::cout << "\t\texp = power of e" << std::endl;
+    std::cout << "\t\tabs = absolute value" << std::endl;
+    std::cout << "\t\tmin(a, b) = smaller of two values" << std::endl;
+    std::cout << "\t\tmax(a, b) = larger of two values" << std::endl;
 
     // brakcets
     std::cout << "\n\tAvailable Brackets:" << std::endl;
@@ -72,6 +92,7 @@ void HandleInput::manual()
     std::cout << "\n\tWarnings:" << std::endl;
     std::cout << "\t\tOperators must be formatted exactly as shown above." << std::endl;
     std::cout << "\t\tIncorrect syntax will lead to an error message." << std::endl;
+    std::cout << "\t\tSeparate chained functions with spaces or brackets, e.g. log log 10; loglog 10 reads as the variable loglog." << std::endl;
 
     // expample expressions
     std::cout << "\n\tExample Expressions:" << std::endl;
@@ -80,8 +101,16 @@ void HandleInput::manual()
     std::cout << "\t\t(-sin 1 + 1) (1 / -cos 1)" << std::endl;
     std::cout << "\t\t--(--(log(--4)--(1)))" << std::endl;
 
+    // formulas
+    std::cout << "\n\tFormulas:" << std::endl;
+    std::cout << "\t\tname = expression defines a formula, later expressions and formulas can use its name." << std::endl;
+    std::cout << "\t\tChanging a formula recomputes only the formulas that depend on it." << std::endl;
+    std::cout << "\t\tNames are letters and underscores, e.g. rate = 0.05 and total = 100 (1 + rate)^2" << std::endl;
+
     // help info
     std::cout << "\n\tAdditional Options:" << std::endl;
     std::cout << "\t\tTo see this manual again type \"help\"." << std::endl;
+    std::cout << "\t\tTo see latency and error statistics type \"stats\"." << std::endl;
     std::cout << "\t\tTo exit this calculator type \"exit\"." << std::endl;
+    std::cout << "\t\tcalculator --batch file --pipeline runs one thread per stage without a cache, --threads and --cache are rejected with it." << std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,448 @@
+#include "jit_program.h"
+#include "operator_registry.h"
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+// libm functions called by the generated code
+typedef double (*Unary)(double);
+typedef double (*Binary)(double, double);
+
+// error codes written by the generated code
+const int DIVISION_BY_ZERO = 1;
+const int NEGATIVE_LOGARITHM = 2;
+
+// largest native stack frame, a bigger one could step over the guard page below the thread stack
+const std::size_t MAX_FRAME = 4096;
+
+
+/**
+ * @brief Translates program to native code, keeping the interpreter as fallback
+ * 
+ * Deeply nested programs whose value stack and temporaries do not fit in MAX_FRAME
+ * stay on the interpreter, which keeps its stack on the heap.
+ * 
+ * @param source compiled expression
+ */
+JitProgram::JitProgram(const Program &source) : program(source)
+{
+#if JIT_SUPPORTED
+    if ((program.stack_size + program.temporaries) * 8 > MAX_FRAME)
+        return;
+
+    generate();
+
+    std::size_t page = sysconf(_SC_PAGESIZE);
+    memory_size = (code.size() + page - 1) / page * page;
+    memory = mmap(nullptr, memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (memory == MAP_FAILED)
+    {
+        memory = nullptr;
+        return;
+    }
+
+    std::memcpy(memory, code.data(), code.size());
+
+    // never writable and executable at the same time
+    if (mprotect(memory, memory_size, PROT_READ | PROT_EXEC) != 0)
+        return;
+
+    function = reinterpret_cast<Function>(memory);
+#endif
+}
+
+
+/**
+ * @brief Releases the executable buffer
+ */
+JitProgram::~JitProgram()
+{
+#if JIT_SUPPORTED
+    if (memory != nullptr)
+        munmap(memory, memory_size);
+#endif
+}
+
+
+/**
+ * @brief Whether native code is used instead of the interpreter
+ * 
+ * @return true native code was generated
+ * @return false the interpreter is used
+ */
+bool JitProgram::compiled() const
+{
+    return function != nullptr;
+}
+
+
+/**
+ * @brief Runs the native code, or the interpreter when it is not available
+ * 
+ * @param variables one value per variable in Program::variables order, may be null without variables
+ * @return double answer to expression
+ * @throws std::invalid_argument with the error message when the program fails
+ */
+double JitProgram::execute(const double *variables) const
+{
+    double result;
+
+    // the interpreter throws the same error with its message
+    if (execute(variables, result))
+        return EvaluateExpression::execute(program, variables);
+
+    return result;
+}
+
+
+/**
+ * @brief Runs the native code without throwing, or the interpreter when it is not available
+ * 
+ * The native code only reports which error happened, the rare failing call is run
+ * again by the interpreter to find where.
+ * 
+ * @param variables one value per variable in Program::variables order, may be null without variables
+ * @param result receives the answer to expression
+ * @return Error division by zero, negative logarithm or a missing variable, if any
+ */
+Error JitProgram::execute(const double *variables, double &result) const
+{
+    if (function == nullptr || (variables == nullptr && program.variables.size() > 0))
+        return EvaluateExpression::execute(program, variables, result);
+
+    int error = 0;
+    result = function(variables, &error);
+
+    if (error != 0)
+        return EvaluateExpression::execute(program, variables, result);
+
+    return {};
+}
+
+
+/**
+ * @brief Runs the native code for every element of the variable arrays
+ * 
+ * @param bindings array for every variable of the program
+ * @param count number of elements in every array
+ * @param out receives count results
+ * @return Error first error of any element, out is incomplete then
+ */
+Error JitProgram::execute(const std::vector<Binding> &bindings, std::size_t count, double *out) const
+{
+    if (function == nullptr)
+        return EvaluateExpression::execute(program, bindings, count, out);
+
+    Arena::Scope scope;
+    ScratchVector<const double*> columns;
+
+    if (Error error = EvaluateExpression::bind(program, bindings, columns))
+        return error;
+
+    // variables of one element
+    double *row = scope.allocate<double>(columns.size());
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        for (std::size_t slot = 0; slot < columns.size(); slot++)
+            row[slot] = columns[slot][i];
+
+        if (Error error = execute(row, out[i]))
+            return error;
+    }
+
+    return {};
+}
+
+
+/**
+ * @brief Emits SSE2 code for the program
+ * 
+ * The value stack lives in the native stack frame, entry k at [rsp + 8k], followed by
+ * the temporaries of shared subexpressions. rbx holds the variables and r12 the error
+ * pointer, both survive the libm and native calls.
+ */
+void JitProgram::generate()
+{
+    // temporaries follow the value stack, keep rsp 16 byte aligned at calls
+    frame = ((program.stack_size + program.temporaries) * 8 + 15) / 16 * 16 + 8;
+
+    bytes({0x53});                              // push rbx
+    bytes({0x41, 0x54});                        // push r12
+    bytes({0x48, 0x81, 0xEC});                  // sub rsp, frame
+    imm32(frame);
+    bytes({0x48, 0x89, 0xFB});                  // mov rbx, rdi
+    bytes({0x49, 0x89, 0xF4});                  // mov r12, rsi
+
+    // jumps to the error exits
+    std::vector<std::size_t> division_errors;
+    std::vector<std::size_t> logarithm_errors;
+
+    std::size_t depth = 0;
+
+    for (const Instruction &instr : program.code)
+    {
+        std::size_t top = depth - 1;
+        std::uint64_t bits;
+
+        switch (instr.op)
+        {
+            case OpCode::PUSH:
+                std::memcpy(&bits, &instr.value, sizeof(bits));
+                bytes({0x48, 0xB8});            // mov rax, value
+                imm64(bits);
+                bytes({0x48, 0x89, 0x84, 0x24}); // mov [rsp + 8 * depth], rax
+                imm32(depth * 8);
+                depth++;
+                break;
+            case OpCode::LOAD:
+                bytes({0xF2, 0x0F, 0x10, 0x83}); // movsd xmm0, [rbx + 8 * slot]
+                imm32(instr.slot * 8);
+                stack_slot(0xF2, 0x11, 0, depth);
+                depth++;
+                break;
+            case OpCode::ADD:
+            case OpCode::SUB:
+            case OpCode::MUL:
+            case OpCode::DIV:
+                if (instr.op == OpCode::DIV)
+                {
+                    // zero divisor, NaN compares unordered and is allowed
+                    stack_slot(0xF2, 0x10, 1, top);
+                    bytes({0x66, 0x0F, 0x57, 0xD2}); // xorpd xmm2, xmm2
+                    bytes({0x66, 0x0F, 0x2E, 0xCA}); // ucomisd xmm1, xmm2
+                    bytes({0x7A, 0x07});        // jp ok
+                    bytes({0x75, 0x05});        // jne ok
+                    division_errors.push_back(jump({0xE9}));
+                }
+
+                stack_slot(0xF2, 0x10, 0, top - 1);
+
+                if (instr.op == OpCode::ADD)
+                    stack_slot(0xF2, 0x58, 0, top);
+                else if (instr.op == OpCode::SUB)
+                    stack_slot(0xF2, 0x5C, 0, top);
+                else if (instr.op == OpCode::MUL)
+                    stack_slot(0xF2, 0x59, 0, top);
+                else
+                    stack_slot(0xF2, 0x5E, 0, top);
+
+                stack_slot(0xF2, 0x11, 0, top - 1);
+                depth--;
+                break;
+            case OpCode::POW:
+                stack_slot(0xF2, 0x10, 0, top - 1);
+                stack_slot(0xF2, 0x10, 1, top);
+                call(reinterpret_cast<std::uint64_t>(static_cast<Binary>(pow)));
+                stack_slot(0xF2, 0x11, 0, top - 1);
+                depth--;
+                break;
+            case OpCode::SIN:
+            case OpCode::COS:
+            case OpCode::TAN:
+            case OpCode::COT:
+                stack_slot(0xF2, 0x10, 0, top);
+
+                if (instr.op == OpCode::SIN)
+                    call(reinterpret_cast<std::uint64_t>(static_cast<Unary>(sin)));
+                else if (instr.op == OpCode::COS)
+                    call(reinterpret_cast<std::uint64_t>(static_cast<Unary>(cos)));
+                else
+                    call(reinterpret_cast<std::uint64_t>(static_cast<Unary>(tan)));
+
+                if (instr.op == OpCode::COT)
+                {
+                    double one = 1;
+                    std::memcpy(&bits, &one, sizeof(bits));
+                    bytes({0x66, 0x0F, 0x28, 0xC8}); // movapd xmm1, xmm0
+                    bytes({0x48, 0xB8});        // mov rax, 1.0
+                    imm64(bits);
+                    bytes({0x66, 0x48, 0x0F, 0x6E, 0xC0}); // movq xmm0, rax
+                    bytes({0xF2, 0x0F, 0x5E, 0xC1}); // divsd xmm0, xmm1
+                }
+
+                stack_slot(0xF2, 0x11, 0, top);
+                break;
+            case OpCode::LOG:
+            case OpCode::LN:
+                // negative argument, NaN compares unordered and is allowed
+                stack_slot(0xF2, 0x10, 0, top);
+                bytes({0x66, 0x0F, 0x57, 0xC9}); // xorpd xmm1, xmm1
+                bytes({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+                bytes({0x7A, 0x06});            // jp ok
+                logarithm_errors.push_back(jump({0x0F, 0x82}));
+
+                if (instr.op == OpCode::LOG)
+                    call(reinterpret_cast<std::uint64_t>(static_cast<Unary>(log10)));
+                else
+                    call(reinterpret_cast<std::uint64_t>(static_cast<Unary>(log)));
+
+                stack_slot(0xF2, 0x11, 0, top);
+                break;
+            case OpCode::NEG:
+                stack_slot(0xF2, 0x10, 0, top);
+                bytes({0x48, 0xB8});            // mov rax, sign bit
+                imm64(0x8000000000000000ull);
+                bytes({0x66, 0x48, 0x0F, 0x6E, 0xC8}); // movq xmm1, rax
+                bytes({0x66, 0x0F, 0x57, 0xC1}); // xorpd xmm0, xmm1
+                stack_slot(0xF2, 0x11, 0, top);
+                break;
+            case OpCode::SAVE:
+                stack_slot(0xF2, 0x10, 0, top);
+                stack_slot(0xF2, 0x11, 0, program.stack_size + instr.slot);
+                break;
+            case OpCode::FETCH:
+                stack_slot(0xF2, 0x10, 0, program.stack_size + instr.slot);
+                stack_slot(0xF2, 0x11, 0, depth);
+                depth++;
+                break;
+            case OpCode::CALL1:
+            case OpCode::CALL2:
+                // operands are passed where they lie on the value stack
+                top -= OPERATORS[static_cast<int>(instr.op)].arity - 1;
+                bytes({0x48, 0x8D, 0xBC, 0x24});    // lea rdi, [rsp + 8 * top]
+                imm32(top * 8);
+                call(reinterpret_cast<std::uint64_t>(OperatorRegistry::native(instr.slot)));
+                stack_slot(0xF2, 0x11, 0, top);
+                depth = top + 1;
+                break;
+        }
+    }
+
+    // result
+    stack_slot(0xF2, 0x10, 0, 0);
+    epilogue();
+
+    // error exits store the error code and return zero
+    for (std::size_t pos : division_errors)
+        patch(pos, code.size());
+
+    bytes({0x41, 0xC7, 0x04, 0x24});            // mov dword [r12], code
+    imm32(DIVISION_BY_ZERO);
+    bytes({0x66, 0x0F, 0x57, 0xC0});            // xorpd xmm0, xmm0
+    epilogue();
+
+    for (std::size_t pos : logarithm_errors)
+        patch(pos, code.size());
+
+    bytes({0x41, 0xC7, 0x04, 0x24});            // mov dword [r12], code
+    imm32(NEGATIVE_LOGARITHM);
+    bytes({0x66, 0x0F, 0x57, 0xC0});            // xorpd xmm0, xmm0
+    epilogue();
+}
+
+
+/**
+ * @brief Appends raw bytes
+ * 
+ * @param values bytes to append
+ */
+void JitProgram::bytes(std::initializer_list<std::uint8_t> values)
+{
+    code.insert(code.end(), values);
+}
+
+
+/**
+ * @brief Appends little endian 32 bit immediate
+ * 
+ * @param value immediate
+ */
+void JitProgram::imm32(std::uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        code.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+}
+
+
+/**
+ * @brief Appends little endian 64 bit immediate
+ * 
+ * @param value immediate
+ */
+void JitProgram::imm64(std::uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        code.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+}
+
+
+/**
+ * @brief Appends SSE instruction with a value stack entry as memory operand
+ * 
+ * @param prefix F2 for scalar double, 66 for packed double
+ * @param opcode second opcode byte after 0F
+ * @param reg xmm register number
+ * @param index value stack entry
+ */
+void JitProgram::stack_slot(std::uint8_t prefix, std::uint8_t opcode, std::uint8_t reg, std::size_t index)
+{
+    // modrm [rsp + disp32] needs a SIB byte
+    bytes({prefix, 0x0F, opcode, static_cast<std::uint8_t>(0x84 | (reg << 3)), 0x24});
+    imm32(index * 8);
+}
+
+
+/**
+ * @brief Appends call to an absolute address through rax
+ * 
+ * @param address function to call
+ */
+void JitProgram::call(std::uint64_t address)
+{
+    bytes({0x48, 0xB8});                        // mov rax, address
+    imm64(address);
+    bytes({0xFF, 0xD0});                        // call rax
+}
+
+
+/**
+ * @brief Appends jump with a 32 bit displacement that is patched later
+ * 
+ * @param opcode jump opcode bytes
+ * @return std::size_t position of the displacement
+ */
+std::size_t JitProgram::jump(std::initializer_list<std::uint8_t> opcode)
+{
+    bytes(opcode);
+
+    std::size_t pos = code.size();
+    imm32(0);
+
+    return pos;
+}
+
+
+/**
+ * @brief Points jump displacement at target
+ * 
+ * @param pos position of the displacement
+ * @param target position to jump to
+ */
+void JitProgram::patch(std::size_t pos, std::size_t target)
+{
+    std::uint32_t rel = static_cast<std::uint32_t>(target - (pos + 4));
+
+    for (int i = 0; i < 4; i++)
+        code[pos + i] = static_cast<std::uint8_t>(rel >> (8 * i));
+}
+
+
+/**
+ * @brief Appends frame teardown and return
+ */
+void JitProgram::epilogue()
+{
+    bytes({0x48, 0x81, 0xC4});                  // add rsp, frame
+    imm32(frame);
+    bytes({0x41, 0x5C});                        // pop r12
+    bytes({0x5B});                              // pop rbx
+    bytes({0xC3});                              // ret
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "evaluate_expression.h"
+#include <cstdint>
+#include <initializer_list>
+
+
+// native x86-64 version of a compiled expression, falls back to the interpreter elsewhere
+class JitProgram
+{
+    public:
+        explicit JitProgram(const Program&);
+        ~JitProgram();
+
+        JitProgram(const JitProgram&) = delete;
+        JitProgram &operator=(const JitProgram&) = delete;
+
+        bool compiled() const;
+        double execute(const double* = nullptr) const;
+        Error execute(const double*, double&) const;
+        Error execute(const std::vector<Binding>&, std::size_t, double*) const;
+
+    private:
+        // generated function, error receives 1 for division by zero and 2 for negative logarithm
+        typedef double (*Function)(const double *variables, int *error);
+
+        void generate();
+        void bytes(std::initializer_list<std::uint8_t>);
+        void imm32(std::uint32_t);
+        void imm64(std::uint64_t);
+        void stack_slot(std::uint8_t, std::uint8_t, std::uint8_t, std::size_t);
+        void call(std::uint64_t);
+        std::size_t jump(std::initializer_list<std::uint8_t>);
+        void patch(std::size_t, std::size_t);
+        void epilogue();
+
+        Program program;
+        std::vector<std::uint8_t> code;
+        std::size_t frame = 0;
+
+        void *memory = nullptr;
+        std::size_t memory_size = 0;
+        Function function = nullptr;
+};
\ No newline at end of file
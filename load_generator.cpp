@@ -0,0 +1,275 @@
+#include "server.h"
+#include "stats.h"
+#include "expression_generator.h"
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+// different expressions sent by every client, so a server cache does not answer everything
+const std::size_t CORPUS_SIZE = 4096;
+
+
+// one connection to the server and its requests in flight
+struct Client
+{
+    int fd;
+    std::uint64_t remaining;
+    std::size_t next;
+
+    // send time of every request still waiting for its result, oldest first
+    std::deque<std::uint64_t> sent;
+
+    std::string output;
+    std::size_t written = 0;
+
+    bool line_start = true;
+};
+
+
+// results of one load generator thread
+struct Load
+{
+    Histogram latency;
+    std::uint64_t errors = 0;
+    std::uint64_t failed = 0;
+};
+
+
+/**
+ * @brief Nanoseconds on the steady clock
+ * 
+ * @return std::uint64_t current time
+ */
+std::uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/**
+ * @brief Queues requests until the client has a full pipeline, then sends what the socket takes
+ * 
+ * @param client connection to fill
+ * @param corpus expressions, one per line
+ * @param pipeline requests kept in flight
+ * @return true socket is fine
+ * @return false socket failed
+ */
+bool fill(Client &client, const std::vector<std::string> &corpus, std::size_t pipeline)
+{
+    while (client.sent.size() < pipeline && client.remaining > 0)
+    {
+        client.output += corpus[client.next++ % corpus.size()];
+        client.output.push_back('\n');
+        client.sent.push_back(now());
+        client.remaining--;
+    }
+
+    while (client.written < client.output.size())
+    {
+        ssize_t length = send(client.fd, client.output.data() + client.written, client.output.size() - client.written, MSG_NOSIGNAL);
+
+        if (length > 0)
+            client.written += length;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+        else if (errno != EINTR)
+            return false;
+    }
+
+    if (client.written == client.output.size())
+    {
+        client.output.clear();
+        client.written = 0;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Runs clients on one thread until every request is answered
+ * 
+ * @param address server port or socket path
+ * @param clients number of connections
+ * @param requests requests over all connections of this thread
+ * @param pipeline requests kept in flight per connection
+ * @param corpus expressions to send
+ * @param load receives latencies and error counts
+ */
+void run_clients(const char *address, std::size_t clients, std::uint64_t requests, std::size_t pipeline,
+                 const std::vector<std::string> &corpus, Load &load)
+{
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Client> connections(clients);
+    std::size_t active = 0;
+
+    for (std::size_t i = 0; i < clients; i++)
+    {
+        Client &client = connections[i];
+        client.fd = Server::connect(address);
+        client.remaining = requests / clients + (i < requests % clients ? 1 : 0);
+        client.next = i * 7919;
+
+        if (client.fd < 0)
+        {
+            load.failed += client.remaining;
+            continue;
+        }
+
+        fcntl(client.fd, F_SETFL, fcntl(client.fd, F_GETFL) | O_NONBLOCK);
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = i;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, client.fd, &event);
+
+        active++;
+        fill(client, corpus, pipeline);
+    }
+
+    std::vector<epoll_event> events(std::max<std::size_t>(1, clients));
+    char buffer[64 << 10];
+
+    while (active > 0)
+    {
+        int count = epoll_wait(epoll, events.data(), events.size(), 1000);
+
+        for (int i = 0; i < count; i++)
+        {
+            Client &client = connections[events[i].data.u64];
+            ssize_t length = recv(client.fd, buffer, sizeof(buffer), 0);
+            std::uint64_t received = now();
+
+            for (ssize_t j = 0; j < length; j++)
+            {
+                if (client.line_start && buffer[j] == 'e')
+                    load.errors++;
+
+                client.line_start = buffer[j] == '\n';
+
+                if (client.line_start && client.sent.size() > 0)
+                {
+                    load.latency.record(received - client.sent.front());
+                    client.sent.pop_front();
+                }
+            }
+
+            bool done = client.remaining == 0 && client.sent.empty();
+
+            if (length == 0 || (length < 0 && errno != EAGAIN && errno != EINTR) || !fill(client, corpus, pipeline) || done)
+            {
+                load.failed += client.sent.size() + client.remaining;
+
+                close(client.fd);
+                active--;
+            }
+        }
+    }
+
+    close(epoll);
+}
+
+
+/**
+ * @brief Sends pipelined expressions to a running server and reports latency and throughput
+ * 
+ * @param argc number of arguments
+ * @param argv "port|socket [--connections N] [--requests N] [--pipeline N] [--threads N]"
+ * @return int zero, one for a missing address or failed requests
+ */
+int main(int argc, char *argv[])
+{
+    const char *address = nullptr;
+    std::size_t connections = 64;
+    std::uint64_t requests = 1000000;
+    std::size_t pipeline = 16;
+    std::size_t threads = 2;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string option = argv[i];
+
+        if (option == "--connections" && i + 1 < argc)
+            connections = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        else if (option == "--requests" && i + 1 < argc)
+            requests = std::strtoull(argv[++i], nullptr, 10);
+        else if (option == "--pipeline" && i + 1 < argc)
+            pipeline = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        else if (option == "--threads" && i + 1 < argc)
+            threads = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        else
+            address = argv[i];
+    }
+
+    if (address == nullptr)
+    {
+        std::cerr << "usage: load_generator port|socket [--connections N] [--requests N] [--pipeline N] [--threads N]" << std::endl;
+        return 1;
+    }
+
+    threads = std::min(threads, connections);
+
+    GeneratorConfig config;
+    ExpressionGenerator generator(config);
+    std::vector<std::string> corpus(CORPUS_SIZE);
+
+    for (std::string &expression : corpus)
+        generator.next(expression);
+
+    // connections and requests are split evenly over the threads
+    std::vector<Load> loads(threads);
+    std::vector<std::thread> workers;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::uint64_t assigned = 0;
+
+    for (std::size_t t = 0; t < threads; t++)
+    {
+        std::size_t clients = connections / threads + (t < connections % threads ? 1 : 0);
+        std::uint64_t share = (t + 1 < threads) ? requests / connections * clients : requests - assigned;
+        assigned += share;
+
+        workers.emplace_back(run_clients, address, clients, share, pipeline, std::cref(corpus), std::ref(loads[t]));
+    }
+
+    for (std::thread &worker : workers)
+        worker.join();
+
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+    Load total;
+
+    for (const Load &load : loads)
+    {
+        for (std::size_t i = 0; i < Histogram::BUCKETS; i++)
+            total.latency.counts[i] += load.latency.counts[i];
+
+        total.latency.total += load.latency.total;
+        total.latency.sum += load.latency.sum;
+        total.latency.max = std::max(total.latency.max, load.latency.max);
+        total.errors += load.errors;
+        total.failed += load.failed;
+    }
+
+    std::cout << connections << " connections, pipeline " << pipeline << ", " << threads << " threads" << std::endl;
+    std::cout << "\tanswered: " << total.latency.total << " requests in " << seconds.count() << " s" << std::endl;
+    std::cout << "\tthroughput: " << total.latency.total / seconds.count() << " requests/s" << std::endl;
+    std::cout << "\tlatency: p50 " << total.latency.percentile(0.5) / 1e3 << " us, p99 "
+              << total.latency.percentile(0.99) / 1e3 << " us, p99.9 " << total.latency.percentile(0.999) / 1e3
+              << " us, max " << total.latency.max / 1e3 << " us" << std::endl;
+    std::cout << "\terror results: " << total.errors << std::endl;
+
+    if (total.failed > 0)
+    {
+        std::cout << "\tunanswered: " << total.failed << " requests" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
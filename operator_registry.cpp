@@ -0,0 +1,314 @@
+#include "operator_registry.h"
+#include <deque>
+#include <mutex>
+#include <numeric>
+
+// bucket of the perfect hash without a name
+const std::uint32_t EMPTY_BUCKET = std::numeric_limits<std::uint32_t>::max();
+
+// names per group of the perfect hash, with twice as many buckets as names
+const std::size_t GROUP_NAMES = 4;
+const std::size_t MIN_BUCKETS = 16;
+
+// seeds tried, and displacements tried for one group before trying another seed
+const int HASH_SEEDS = 64;
+const std::uint32_t MAX_DISPLACEMENT = 1 << 16;
+
+// natives a CALL can address, share keeps the slot in the top 24 bits of its node keys
+const std::size_t MAX_NATIVES = 1 << 24;
+
+
+/**
+ * @brief Registers a native function under a name, for expressions compiled from now on
+ * 
+ * @param name letters and underscores, as variable names, which it shadows from now on
+ * @param arity 1 or 2 operands, a function of two is called as name(first, second)
+ * @param function pure function of the operands
+ * @return true function was registered
+ * @return false name is taken or invalid, arity is not 1 or 2, or function is null
+ */
+bool OperatorRegistry::add(std::string_view name, int arity, NativeFunction function)
+{
+    // names of registered natives, never freed since every later table points into them
+    static std::deque<std::string> &names = *new std::deque<std::string>;
+    static std::mutex mutex;
+
+    if (name.empty() || function == nullptr || (arity != 1 && arity != 2))
+        return false;
+
+    for (char c : name)
+    {
+        if (!isalpha(static_cast<unsigned char>(c)) && c != '_')
+            return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    const Table *current = latest().load(std::memory_order_acquire);
+
+    if (find(name) != nullptr || current->natives.size() >= MAX_NATIVES)
+        return false;
+
+    // readers of the current table keep using it, tables are never freed
+    static std::vector<const Table*> &retired = *new std::vector<const Table*>;
+
+    Table *table = new Table(*current);
+    names.emplace_back(name);
+
+    table->native_entries.push_back(table->entries.size());
+    table->entries.push_back({names.back(), arity == 1 ? OpCode::CALL1 : OpCode::CALL2,
+                              static_cast<std::uint32_t>(table->natives.size())});
+    table->natives.push_back(function);
+
+    if (!index(*table))
+    {
+        names.pop_back();
+        delete table;
+        return false;
+    }
+
+    retired.push_back(current);
+    latest().store(table, std::memory_order_release);
+
+    return true;
+}
+
+
+/**
+ * @brief Looks up a function name
+ * 
+ * @param name name found by the tokenizer
+ * @return const FunctionEntry* instruction and slot of the function, valid for the whole run, null for other names
+ */
+const FunctionEntry *OperatorRegistry::find(std::string_view name)
+{
+    const Table *table = latest().load(std::memory_order_acquire);
+
+    std::uint64_t hashed = hash(name, table->seed);
+    std::uint32_t displacement = table->displacements[hashed & (table->displacements.size() - 1)];
+    std::uint32_t entry = table->buckets[bucket(hashed, displacement, table->shift)];
+
+    if (entry != EMPTY_BUCKET && table->entries[entry].name == name)
+        return &table->entries[entry];
+
+    return nullptr;
+}
+
+
+/**
+ * @brief Native function of a CALL1 or CALL2 instruction
+ * 
+ * @param slot slot of the instruction
+ * @return NativeFunction function registered in that slot
+ */
+NativeFunction OperatorRegistry::native(std::uint32_t slot)
+{
+    return latest().load(std::memory_order_acquire)->natives[slot];
+}
+
+
+/**
+ * @brief Name and instruction of a native function
+ * 
+ * @param slot native function
+ * @return const FunctionEntry& its entry, valid for the whole run
+ */
+const FunctionEntry &OperatorRegistry::function(std::uint32_t slot)
+{
+    const Table *table = latest().load(std::memory_order_acquire);
+    return table->entries[table->native_entries[slot]];
+}
+
+
+/**
+ * @brief Number of native functions, slots are numbered from zero in order of registration
+ * 
+ * @return std::size_t native functions, the built in ones included
+ */
+std::size_t OperatorRegistry::natives()
+{
+    return latest().load(std::memory_order_acquire)->natives.size();
+}
+
+
+/**
+ * @brief Table of the latest registration, holding FUNCTIONS before the first
+ * 
+ * @return std::atomic<const Table*>& latest table
+ */
+std::atomic<const OperatorRegistry::Table*> &OperatorRegistry::latest()
+{
+    static std::atomic<const Table*> table{[]()
+    {
+        Table *builtin = new Table;
+        builtin->entries.assign(std::begin(FUNCTIONS), std::end(FUNCTIONS));
+        builtin->natives = {root, exponential, absolute, minimum, maximum};
+
+        for (std::uint32_t i = 0; i < builtin->entries.size(); i++)
+        {
+            if (builtin->entries[i].op == OpCode::CALL1 || builtin->entries[i].op == OpCode::CALL2)
+                builtin->native_entries.push_back(i);
+        }
+
+        (void) index(*builtin);
+        return builtin;
+    }()};
+
+    return table;
+}
+
+
+/**
+ * @brief Builds the perfect hash of the entries by hash and displace
+ * 
+ * Names are hashed into groups, the largest groups are placed first. Each group gets the
+ * first displacement that puts all of its names into empty buckets.
+ * 
+ * @param table table whose entries are hashed, receives displacements, buckets, seed and shift
+ * @return true perfect hash was found
+ * @return false names hash equally under every seed tried
+ */
+bool OperatorRegistry::index(Table &table)
+{
+    std::size_t size = MIN_BUCKETS;
+    int bits = 4;
+
+    while (size < table.entries.size() * 2)
+    {
+        size *= 2;
+        bits++;
+    }
+
+    std::size_t groups = 1;
+
+    while (groups * GROUP_NAMES < table.entries.size())
+        groups *= 2;
+
+    table.shift = 64 - bits;
+
+    std::vector<std::uint64_t> hashes(table.entries.size());
+    std::vector<std::vector<std::uint32_t>> members(groups);
+    std::vector<std::uint32_t> order(groups);
+    std::vector<std::uint32_t> placed;
+
+    for (int attempt = 1; attempt <= HASH_SEEDS; attempt++)
+    {
+        table.seed = attempt * 0xD6E8FEB86659FD93ull;
+        table.displacements.assign(groups, 0);
+        table.buckets.assign(size, EMPTY_BUCKET);
+
+        for (std::vector<std::uint32_t> &group : members)
+            group.clear();
+
+        for (std::uint32_t i = 0; i < table.entries.size(); i++)
+        {
+            hashes[i] = hash(table.entries[i].name, table.seed);
+            members[hashes[i] & (groups - 1)].push_back(i);
+        }
+
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](std::uint32_t first, std::uint32_t second)
+        {
+            return members[first].size() > members[second].size();
+        });
+
+        std::size_t group = 0;
+
+        for (; group < groups && members[order[group]].size() > 0; group++)
+        {
+            const std::vector<std::uint32_t> &names = members[order[group]];
+            std::uint32_t displacement = 0;
+
+            for (; displacement < MAX_DISPLACEMENT; displacement++)
+            {
+                placed.clear();
+
+                for (std::uint32_t name : names)
+                {
+                    std::uint32_t target = bucket(hashes[name], displacement, table.shift);
+
+                    if (table.buckets[target] != EMPTY_BUCKET)
+                        break;
+
+                    table.buckets[target] = name;
+                    placed.push_back(target);
+                }
+
+                if (placed.size() == names.size())
+                    break;
+
+                for (std::uint32_t target : placed)
+                    table.buckets[target] = EMPTY_BUCKET;
+            }
+
+            if (displacement == MAX_DISPLACEMENT)
+                break;
+
+            table.displacements[order[group]] = displacement;
+        }
+
+        if (group == groups || members[order[group]].empty())
+            return true;
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief Square root, NaN for negative numbers
+ * 
+ * @param operands number
+ * @return double square root
+ */
+double OperatorRegistry::root(const double *operands)
+{
+    return std::sqrt(operands[0]);
+}
+
+
+/**
+ * @brief Power of e
+ * 
+ * @param operands exponent
+ * @return double e raised to the exponent
+ */
+double OperatorRegistry::exponential(const double *operands)
+{
+    return std::exp(operands[0]);
+}
+
+
+/**
+ * @brief Absolute value
+ * 
+ * @param operands number
+ * @return double number without its sign
+ */
+double OperatorRegistry::absolute(const double *operands)
+{
+    return std::fabs(operands[0]);
+}
+
+
+/**
+ * @brief Smaller of two numbers, the other one when one is NaN
+ * 
+ * @param operands both numbers
+ * @return double smaller number
+ */
+double OperatorRegistry::minimum(const double *operands)
+{
+    return std::fmin(operands[0], operands[1]);
+}
+
+
+/**
+ * @brief Larger of two numbers, the other one when one is NaN
+ * 
+ * @param operands both numbers
+ * @return double larger number
+ */
+double OperatorRegistry::maximum(const double *operands)
+{
+    return std::fmax(operands[0], operands[1]);
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "evaluate_expression.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+
+// native function of CALL1 and CALL2, called with its operands in order, left one first
+typedef double (*NativeFunction)(const double *operands);
+
+
+// function names known to the tokenizer, matched by a perfect hash: every name has a bucket of
+// its own, so a lookup hashes once and compares once however many functions there are. Host
+// applications register native functions at run time, registering publishes a new table and
+// keeps the old ones for threads still reading them, so it is meant for setup rather than
+// thousands of calls. Natives must be pure, calls with constant operands are folded when
+// compiling and repeated calls are shared
+class OperatorRegistry
+{
+    public:
+        static bool add(std::string_view, int, NativeFunction);
+        static const FunctionEntry *find(std::string_view);
+        static NativeFunction native(std::uint32_t);
+        static const FunctionEntry &function(std::uint32_t);
+        static std::size_t natives();
+
+    private:
+        // every function name, the perfect hash over them and the natives by slot. A name hashes to a
+        // group, the displacement of its group moves every name of the group to a bucket of its own
+        struct Table
+        {
+            std::vector<FunctionEntry> entries;
+            std::vector<std::uint32_t> displacements;
+            std::vector<std::uint32_t> buckets;
+            std::uint64_t seed = 0;
+            int shift = 0;
+
+            std::vector<NativeFunction> natives;
+            std::vector<std::uint32_t> native_entries;
+        };
+
+        static std::atomic<const Table*> &latest();
+        static bool index(Table&);
+        static std::uint64_t hash(std::string_view, std::uint64_t);
+        static std::uint32_t bucket(std::uint64_t, std::uint32_t, int);
+
+        static double root(const double*);
+        static double exponential(const double*);
+        static double absolute(const double*);
+        static double minimum(const double*);
+        static double maximum(const double*);
+};
+
+
+/**
+ * @brief Hashes a name eight bytes at a time, the top bits select its bucket
+ * 
+ * @param name function name
+ * @param seed seed of the table
+ * @return std::uint64_t hash
+ */
+inline std::uint64_t OperatorRegistry::hash(std::string_view name, std::uint64_t seed)
+{
+    std::uint64_t hash = seed ^ (static_cast<std::uint64_t>(name.length()) << 56);
+
+    std::size_t i = 0;
+
+    for (; i + sizeof(std::uint64_t) <= name.length(); i += sizeof(std::uint64_t))
+    {
+        std::uint64_t word;
+        std::memcpy(&word, name.data() + i, sizeof(word));
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+    }
+
+    // the last bytes are gathered in a register, a short copy into memory would stall the load of the word
+    if (i < name.length())
+    {
+        std::uint64_t word = 0;
+
+        for (std::size_t byte = i; byte < name.length(); byte++)
+            word |= static_cast<std::uint64_t>(static_cast<unsigned char>(name[byte])) << (8 * (byte - i));
+
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+    }
+
+    // every byte reaches every bit, groups take the low bits and buckets the high ones
+    hash = (hash ^ (hash >> 33)) * 0xFF51AFD7ED558CCDull;
+    hash = (hash ^ (hash >> 33)) * 0xC4CEB9FE1A85EC53ull;
+
+    return hash ^ (hash >> 33);
+}
+
+
+/**
+ * @brief Bucket of a name in its group
+ * 
+ * @param hashed hash of the name
+ * @param displacement displacement of its group
+ * @param shift 64 less the bits of a bucket index
+ * @return std::uint32_t bucket
+ */
+inline std::uint32_t OperatorRegistry::bucket(std::uint64_t hashed, std::uint32_t displacement, int shift)
+{
+    return ((hashed ^ (displacement * 0x9E3779B97F4A7C15ull)) * 0xFF51AFD7ED558CCDull) >> shift;
+}
\ No newline at end of file
@@ -0,0 +1,498 @@
+#include "parallel_program.h"
+
+// relative cost of every OpCode, a libm or native call weighs about as much as a dozen arithmetic instructions
+constexpr std::uint32_t INSTRUCTION_COST[] = {1, 1, 1, 1, 1, 1, 16, 16, 16, 16, 16, 16, 16, 1, 0, 1, 16, 16};
+
+// least work worth a task, subtrees this costly are split into their operands
+const std::uint32_t TASK_COST = 1 << 14;
+
+
+/**
+ * @brief Builds the expression tree of a program and splits it into waves of tasks
+ * 
+ * @param source compiled expression
+ */
+ParallelProgram::ParallelProgram(const Program &source) : program(source)
+{
+    split();
+}
+
+
+/**
+ * @brief Number of values the skeleton combines
+ * 
+ * @return std::size_t terms, one when the expression is too small to split
+ */
+std::size_t ParallelProgram::terms() const
+{
+    return term_count;
+}
+
+
+/**
+ * @brief Number of tasks one execution runs
+ * 
+ * @return std::size_t tasks over every wave
+ */
+std::size_t ParallelProgram::tasks() const
+{
+    return task_list.size();
+}
+
+
+/**
+ * @brief Runs the program on a thread pool
+ * 
+ * @param pool threads to evaluate terms on, null to evaluate them on the calling thread
+ * @param variables one value per variable in Program::variables order, may be null without variables
+ * @return double answer to expression
+ * @throws std::invalid_argument with the error message when the program fails
+ */
+double ParallelProgram::execute(ThreadPool *pool, const double *variables) const
+{
+    double result;
+
+    // the interpreter throws the same error with its message
+    if (execute(pool, variables, result))
+        return EvaluateExpression::execute(program, variables);
+
+    return result;
+}
+
+
+/**
+ * @brief Runs the program on a thread pool without throwing
+ * 
+ * The waves run one after another, the tasks of a wave in parallel, then the skeleton runs
+ * on the calling thread. Only the tasks of this call are waited for, the calling thread runs
+ * queued tasks meanwhile, so it may itself be a task of the pool. Errors are rare, when a task fails the sequential interpreter runs
+ * the program again to report the error it finds first.
+ * 
+ * @param pool threads to evaluate terms on, null to evaluate them on the calling thread
+ * @param variables one value per variable in Program::variables order, may be null without variables
+ * @param result receives the answer to expression
+ * @return Error division by zero, negative logarithm or a missing variable, if any
+ */
+Error ParallelProgram::execute(ThreadPool *pool, const double *variables, double &result) const
+{
+    if (variables == nullptr && program.variables.size() > 0)
+        return {ErrorCode::UNKNOWN_VARIABLE, 0};
+
+    Arena::Scope scope;
+    double *values = scope.allocate<double>(skeleton.stack_size + skeleton.temporaries);
+    double *temporaries = values + skeleton.stack_size;
+
+    ScratchVector<Error> errors(task_list.size());
+    Error *task_errors = errors.data();
+
+    for (std::size_t wave = 0; wave < waves.size(); wave++)
+    {
+        std::size_t first = waves[wave];
+        std::size_t last = wave + 1 < waves.size() ? waves[wave + 1] : task_list.size();
+
+        if (pool == nullptr || last - first == 1)
+        {
+            for (std::size_t i = first; i < last; i++)
+                task_errors[i] = evaluate(task_list[i], variables, temporaries);
+        }
+        else
+        {
+            // tasks of this wave still running, the last one wakes the caller
+            struct Latch
+            {
+                std::mutex mutex;
+                std::condition_variable done;
+                std::size_t remaining;
+            } latch;
+
+            latch.remaining = last - first;
+
+            for (std::size_t i = first; i < last; i++)
+            {
+                pool->submit([this, i, variables, temporaries, task_errors, &latch]
+                {
+                    task_errors[i] = evaluate(task_list[i], variables, temporaries);
+
+                    // the latch is only touched under its mutex, so it outlives every task
+                    std::lock_guard<std::mutex> lock(latch.mutex);
+
+                    if (--latch.remaining == 0)
+                        latch.done.notify_all();
+                });
+            }
+
+            // other tasks of the pool are not waited for, and running queued ones while this call's remain
+            // keeps a caller on a worker from deadlocking
+            std::unique_lock<std::mutex> lock(latch.mutex);
+
+            while (latch.remaining > 0)
+            {
+                lock.unlock();
+                bool helped = pool->help();
+                lock.lock();
+
+                if (!helped)
+                    latch.done.wait(lock, [&latch] { return latch.remaining == 0; });
+            }
+        }
+
+        for (std::size_t i = first; i < last; i++)
+        {
+            if (task_errors[i])
+                return EvaluateExpression::execute(program, variables, result);
+        }
+    }
+
+    return EvaluateExpression::run(skeleton.code.data(), skeleton.code.data() + skeleton.code.size(), nullptr, values,
+                                   temporaries, result);
+}
+
+
+/**
+ * @brief Builds the expression tree and splits it into the skeleton and waves of entries
+ * 
+ * Subtrees costing TASK_COST or more are split into their operands and stay in the skeleton,
+ * the largest unsplit subtrees become terms. Temporaries of unsplit subtrees are evaluated
+ * before the terms, in waves ordered by the temporaries they read themselves. Temporaries of
+ * split subtrees stay in the skeleton unless an entry reads them, then they are hoisted out
+ * of it into one entry of their own, so no entry repeats the code of another.
+ */
+void ParallelProgram::split()
+{
+    const std::vector<Instruction> &source = program.code;
+    std::size_t size = source.size();
+
+    Arena::Scope scope;
+
+    Tree tree;
+    tree.cost.assign(size, 0);
+    tree.begin.assign(size, 0);
+    tree.saves.assign(program.temporaries, 0);
+    tree.waves.assign(program.temporaries, 0);
+    tree.hoisted.assign(program.temporaries, 0);
+
+    // unsplit subtrees whose parent is split, they become terms
+    ScratchVector<std::uint8_t> term(size, 0);
+    ScratchVector<std::uint32_t> operands;
+
+    for (std::uint32_t i = 0; i < size; i++)
+    {
+        OpCode op = source[i].op;
+
+        // SAVE annotates the subtree before it and is no node of its own
+        if (op == OpCode::SAVE)
+        {
+            tree.saves[source[i].slot] = i;
+            continue;
+        }
+
+        std::uint32_t total = INSTRUCTION_COST[static_cast<int>(op)];
+        std::uint32_t start = i;
+
+        // operands of the instruction, the left one first
+        std::uint32_t children[2];
+        int count = 0;
+
+        if (op != OpCode::PUSH && op != OpCode::LOAD && op != OpCode::FETCH)
+        {
+            count = OPERATORS[static_cast<int>(op)].arity;
+
+            for (int j = count - 1; j >= 0; j--)
+            {
+                children[j] = operands.back();
+                operands.pop_back();
+                total += tree.cost[children[j]];
+            }
+
+            start = tree.begin[children[0]];
+        }
+
+        tree.cost[i] = std::min(total, TASK_COST);
+        tree.begin[i] = start;
+        operands.push_back(i);
+
+        for (int j = 0; j < count && tree.cost[i] == TASK_COST; j++)
+            term[children[j]] = tree.cost[children[j]] < TASK_COST;
+    }
+
+    // an expression too small to split is one term
+    if (operands.size() > 0 && tree.cost[operands.back()] < TASK_COST)
+        term[operands.back()] = 1;
+
+    // split temporaries read below the root of a term are hoisted, otherwise every term would repeat their code
+    for (std::uint32_t i = 0; i < size; i++)
+    {
+        if (source[i].op == OpCode::FETCH && !term[i] && !tree.precomputed(source[i].slot))
+            tree.hoisted[source[i].slot] = 1;
+    }
+
+    // a hoisted temporary is one entry, so the split temporaries it reads or first computes are hoisted
+    // too. They are numbered lower, and the ranges of nested temporaries are left to their own pass
+    for (std::uint32_t slot = program.temporaries; slot-- > 0;)
+    {
+        if (!tree.hoisted[slot])
+            continue;
+
+        std::uint32_t node = tree.saves[slot] - 1;
+
+        for (std::uint32_t i = node; i-- > tree.begin[node];)
+        {
+            const Instruction &instr = source[i];
+
+            if (instr.op == OpCode::FETCH && !tree.precomputed(instr.slot))
+                tree.hoisted[instr.slot] = 1;
+
+            if (instr.op == OpCode::SAVE)
+            {
+                tree.hoisted[instr.slot] = 1;
+                i = tree.begin[i - 1];
+            }
+        }
+    }
+
+    // SAVE of the outermost hoisted split temporary starting at every instruction, the skeleton reads it instead
+    ScratchVector<std::uint32_t> hoisted_save(size, 0);
+
+    for (std::uint32_t slot = 0; slot < program.temporaries; slot++)
+    {
+        std::uint32_t node = tree.saves[slot] - 1;
+
+        if (tree.hoisted[slot] && tree.cost[node] == TASK_COST)
+            hoisted_save[tree.begin[node]] = std::max(hoisted_save[tree.begin[node]], tree.saves[slot]);
+    }
+
+    code.clear();
+    entries.clear();
+    task_list.clear();
+    waves.clear();
+    skeleton = Program();
+    term_count = 0;
+
+    // temporaries of unsplit subtrees and hoisted ones, numbered in code order, so the ones they read come first
+    std::vector<std::vector<Entry>> levels;
+
+    for (std::uint32_t slot = 0; slot < program.temporaries; slot++)
+    {
+        if (!tree.precomputed(slot))
+            continue;
+
+        std::uint32_t node = tree.saves[slot] - 1;
+        std::uint32_t begin = code.size();
+        std::uint32_t wave = emit(tree.begin[node], node, tree);
+
+        tree.waves[slot] = wave;
+
+        if (levels.size() <= wave)
+            levels.resize(wave + 1);
+
+        levels[wave].push_back({begin, static_cast<std::uint32_t>(code.size()), slot});
+    }
+
+    for (const std::vector<Entry> &level : levels)
+    {
+        std::size_t first = entries.size();
+        entries.insert(entries.end(), level.begin(), level.end());
+        group(first);
+    }
+
+    // skeleton temporaries: those of the program, then one per term
+    std::size_t first = entries.size();
+    std::size_t depth = 0;
+
+    for (std::uint32_t i = 0; i < size; i++)
+    {
+        const Instruction &instr = source[i];
+
+        if (hoisted_save[i] != 0)
+        {
+            term_count++;
+            skeleton.stack_size = std::max(skeleton.stack_size, ++depth);
+            skeleton.code.push_back({OpCode::FETCH, source[hoisted_save[i]].slot, 0});
+
+            i = hoisted_save[i];
+            continue;
+        }
+
+        if (instr.op == OpCode::SAVE)
+        {
+            if (!tree.precomputed(instr.slot))
+                skeleton.code.push_back(instr);
+
+            continue;
+        }
+
+        if (term[i])
+        {
+            term_count++;
+            skeleton.stack_size = std::max(skeleton.stack_size, ++depth);
+
+            // a term that is a temporary reads it directly
+            if (i + 1 < size && source[i + 1].op == OpCode::SAVE)
+            {
+                skeleton.code.push_back({OpCode::FETCH, source[i + 1].slot, 0});
+                continue;
+            }
+
+            if (instr.op == OpCode::FETCH)
+            {
+                skeleton.code.push_back(instr);
+                continue;
+            }
+
+            std::uint32_t slot = program.temporaries + entries.size() - first;
+            std::uint32_t begin = code.size();
+
+            emit(tree.begin[i], i, tree);
+
+            entries.push_back({begin, static_cast<std::uint32_t>(code.size()), slot});
+            skeleton.code.push_back({OpCode::FETCH, slot, 0});
+        }
+        else if (tree.cost[i] == TASK_COST)
+        {
+            skeleton.code.push_back(instr);
+
+            if (OPERATORS[static_cast<int>(instr.op)].arity == 2)
+                depth--;
+        }
+    }
+
+    group(first);
+
+    skeleton.temporaries = program.temporaries + entries.size() - first;
+
+    // copied temporaries can nest deeper than the program did
+    for (const Entry &entry : entries)
+    {
+        depth = 0;
+
+        for (std::uint32_t i = entry.begin; i < entry.end; i++)
+        {
+            OpCode op = code[i].op;
+
+            if (op == OpCode::PUSH || op == OpCode::LOAD || op == OpCode::FETCH)
+                stack_size = std::max(stack_size, ++depth);
+            else if (OPERATORS[static_cast<int>(op)].arity == 2)
+                depth--;
+        }
+    }
+}
+
+
+/**
+ * @brief Appends the code of a subtree for an entry
+ * 
+ * Temporaries evaluated in an earlier wave are read, their SAVE drops the code before it.
+ * Entries never read temporaries of the skeleton, split temporaries they read are hoisted.
+ * 
+ * @param first first instruction of the subtree
+ * @param last last instruction of the subtree, its root
+ * @param tree expression tree of the program
+ * @return std::uint32_t earliest wave the code can run in
+ */
+std::uint32_t ParallelProgram::emit(std::uint32_t first, std::uint32_t last, const Tree &tree)
+{
+    // where the code of every value on the stack starts
+    ScratchVector<std::uint32_t> starts;
+    std::uint32_t wave = 0;
+
+    for (std::uint32_t i = first; i <= last; i++)
+    {
+        const Instruction &instr = program.code[i];
+
+        if (instr.op == OpCode::SAVE)
+        {
+            if (tree.precomputed(instr.slot))
+            {
+                code.resize(starts.back());
+                code.push_back({OpCode::FETCH, instr.slot, 0});
+                wave = std::max(wave, tree.waves[instr.slot] + 1);
+            }
+
+            continue;
+        }
+
+        if (instr.op == OpCode::PUSH || instr.op == OpCode::LOAD || instr.op == OpCode::FETCH)
+            starts.push_back(code.size());
+        else if (OPERATORS[static_cast<int>(instr.op)].arity == 2)
+            starts.pop_back();
+
+        if (instr.op == OpCode::FETCH)
+            wave = std::max(wave, tree.waves[instr.slot] + 1);
+
+        code.push_back(instr);
+    }
+
+    return wave;
+}
+
+
+/**
+ * @brief Groups entries from first to the last one into tasks of about TASK_COST, forming a wave
+ * 
+ * @param first first entry of the wave
+ */
+void ParallelProgram::group(std::size_t first)
+{
+    if (first == entries.size())
+        return;
+
+    waves.push_back(task_list.size());
+
+    std::uint32_t start = first;
+    std::uint32_t work = 0;
+
+    for (std::uint32_t i = first; i < entries.size(); i++)
+    {
+        for (std::uint32_t j = entries[i].begin; j < entries[i].end; j++)
+            work += INSTRUCTION_COST[static_cast<int>(code[j].op)];
+
+        if (work >= TASK_COST || i + 1 == entries.size())
+        {
+            task_list.push_back({start, i + 1});
+            start = i + 1;
+            work = 0;
+        }
+    }
+}
+
+
+/**
+ * @brief Evaluates the entries of a task into their temporaries, stopping at the first error
+ * 
+ * @param task entries to evaluate
+ * @param variables one value per variable in Program::variables order
+ * @param temporaries temporaries of the skeleton
+ * @return Error division by zero or negative logarithm, if any
+ */
+Error ParallelProgram::evaluate(const Task &task, const double *variables, double *temporaries) const
+{
+    Arena::Scope scope;
+    double *stack = scope.allocate<double>(stack_size);
+
+    for (std::uint32_t i = task.first; i < task.last; i++)
+    {
+        const Entry &entry = entries[i];
+        double value;
+
+        if (Error error = EvaluateExpression::run(code.data() + entry.begin, code.data() + entry.end, variables, stack,
+                                                  temporaries, value))
+            return error;
+
+        temporaries[entry.slot] = value;
+    }
+
+    return {};
+}
+
+
+/**
+ * @brief Whether a temporary is evaluated in the waves before the terms, which holds unless its subtree is split and not hoisted
+ * 
+ * @param slot temporary of the program
+ * @return true evaluated before the terms
+ * @return false evaluated by the skeleton
+ */
+bool ParallelProgram::Tree::precomputed(std::uint32_t slot) const
+{
+    return cost[saves[slot] - 1] < TASK_COST || hoisted[slot];
+}
\ No newline at end of file
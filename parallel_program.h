@@ -0,0 +1,74 @@
+#pragma once
+
+#include "evaluate_expression.h"
+#include "thread_pool.h"
+#include <cstdint>
+
+
+// compiled expression split for evaluation on a thread pool. Every subtree cheaper than a task
+// becomes a term, the operators above the terms form a skeleton program that reads term values
+// as its temporaries. Shared subexpressions are evaluated once, in waves before the terms that
+// read them. The skeleton combines terms in source order on the calling thread, so results are
+// the same as a sequential execute on any number of threads
+class ParallelProgram
+{
+    public:
+        explicit ParallelProgram(const Program&);
+
+        std::size_t terms() const;
+        std::size_t tasks() const;
+        double execute(ThreadPool*, const double* = nullptr) const;
+        Error execute(ThreadPool*, const double*, double&) const;
+
+    private:
+        friend class Benchmark;
+        friend class Tests;
+
+        // code evaluated into one temporary of the skeleton
+        struct Entry
+        {
+            std::uint32_t begin;
+            std::uint32_t end;
+            std::uint32_t slot;
+        };
+
+        // consecutive entries evaluated by one task
+        struct Task
+        {
+            std::uint32_t first;
+            std::uint32_t last;
+        };
+
+        // expression tree over the program: capped cost and code start of the subtree ending at every
+        // instruction, position of the SAVE of every temporary, the wave it is evaluated in and whether
+        // it is split but read by an entry, so evaluated by an entry of its own
+        struct Tree
+        {
+            ScratchVector<std::uint32_t> cost;
+            ScratchVector<std::uint32_t> begin;
+            ScratchVector<std::uint32_t> saves;
+            ScratchVector<std::uint32_t> waves;
+            ScratchVector<std::uint8_t> hoisted;
+
+            bool precomputed(std::uint32_t) const;
+        };
+
+        void split();
+        std::uint32_t emit(std::uint32_t, std::uint32_t, const Tree&);
+        void group(std::size_t);
+        Error evaluate(const Task&, const double*, double*) const;
+
+        Program program;
+
+        // code of every entry, without SAVE
+        std::vector<Instruction> code;
+        std::size_t stack_size = 0;
+
+        Program skeleton;
+        std::size_t term_count = 0;
+        std::vector<Entry> entries;
+        std::vector<Task> task_list;
+
+        // first task of every wave, tasks only read temporaries written by earlier waves
+        std::vector<std::uint32_t> waves;
+};
\ No newline at end of file
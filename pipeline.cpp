@@ -0,0 +1,458 @@
+#include "pipeline.h"
+#include "stats.h"
+#include <thread>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+// batches circulating between the stages, they bound the memory of the pipeline
+const std::size_t BATCHES = 16;
+
+// initial text of a batch, grown for longer lines
+const std::size_t BATCH_BYTES = 64 << 10;
+
+// batches waiting between two stages before the earlier one stalls
+const std::size_t QUEUE_BATCHES = 4;
+
+// a waiting stage polls its queue this many times, then yields this many times, then sleeps between polls
+const std::size_t SPINS = 128;
+const std::size_t YIELDS = 128;
+const std::chrono::microseconds SLEEP(50);
+
+// names of the stages
+const char *PIPELINE_STAGE_NAMES[] = {"read", "compile", "evaluate", "write"};
+
+
+/**
+ * @brief Creates the batches and the queues between the stages
+ * 
+ * @param options notation and precision of results
+ */
+Pipeline::Pipeline(const FormatOptions &options)
+    : options(options), free(BATCHES), compile_input(QUEUE_BATCHES), evaluate_input(QUEUE_BATCHES), write_input(QUEUE_BATCHES)
+{
+    for (std::size_t i = 0; i < BATCHES; i++)
+    {
+        batches.push_back(std::make_unique<Batch>());
+        batches.back()->text.resize(BATCH_BYTES);
+
+        (void) free.push(batches.back().get());
+    }
+}
+
+
+/**
+ * @brief Evaluates newline delimited expressions from a file or stdin through the pipeline
+ * 
+ * @param path file to read, stdin if null
+ * @param options notation and precision of results
+ * @return int zero on success, one if the file could not be opened
+ */
+int Pipeline::run(const char *path, const FormatOptions &options)
+{
+    int input = STDIN_FILENO;
+
+    if (path != nullptr)
+    {
+        input = ::open(path, O_RDONLY);
+
+        if (input < 0)
+        {
+            std::cerr << "could not open file: " << path << std::endl;
+            return 1;
+        }
+    }
+
+    Pipeline pipeline(options);
+    PipelineMetrics metrics = pipeline.process(input, stdout);
+
+    if (input != STDIN_FILENO)
+        ::close(input);
+
+    report(metrics, std::cerr);
+
+    return 0;
+}
+
+
+/**
+ * @brief Writes the time and queue occupancy of every stage, the busiest stage limits throughput
+ * 
+ * @param metrics counters of a run
+ * @param out stream to write to
+ */
+void Pipeline::report(const PipelineMetrics &metrics, std::ostream &out)
+{
+    out << "pipeline: " << metrics.lines << " lines, " << metrics.buffer_bytes / 1024 << " KB of buffers" << std::endl;
+
+    for (std::size_t i = 0; i < static_cast<std::size_t>(PipelineStage::COUNT); i++)
+    {
+        const StageMetrics &stage = metrics.stages[i];
+        const QueueMetrics &queue = metrics.queues[i];
+
+        double mean = queue.samples > 0 ? static_cast<double>(queue.total) / queue.samples : 0;
+
+        out << "  " << name(static_cast<PipelineStage>(i)) << ": " << stage.batches << " batches, busy " << stage.busy / 1e6
+            << " ms, starved " << stage.starved / 1e6 << " ms, blocked " << stage.blocked / 1e6
+            << " ms, input queue " << mean << " of " << queue.capacity << " on average, " << queue.max << " at most" << std::endl;
+    }
+}
+
+
+/**
+ * @brief Name of a stage
+ * 
+ * @param stage stage of the pipeline
+ * @return const char* name
+ */
+const char *Pipeline::name(PipelineStage stage)
+{
+    return PIPELINE_STAGE_NAMES[static_cast<int>(stage)];
+}
+
+
+/**
+ * @brief Runs the stages until the input ends, reading on the calling thread
+ * 
+ * @param input file descriptor to read lines from
+ * @param output file results are written to
+ * @return PipelineMetrics counters of this run
+ */
+PipelineMetrics Pipeline::process(int input, std::FILE *output)
+{
+    metrics = PipelineMetrics();
+
+    metrics.queues[static_cast<std::size_t>(PipelineStage::READ)].capacity = free.capacity();
+    metrics.queues[static_cast<std::size_t>(PipelineStage::COMPILE)].capacity = compile_input.capacity();
+    metrics.queues[static_cast<std::size_t>(PipelineStage::EVALUATE)].capacity = evaluate_input.capacity();
+    metrics.queues[static_cast<std::size_t>(PipelineStage::WRITE)].capacity = write_input.capacity();
+
+    std::thread compiler(&Pipeline::compile, this);
+    std::thread evaluator(&Pipeline::evaluate, this);
+    std::thread writer(&Pipeline::write, this, output);
+
+    Batch *unused = read(input);
+
+    compiler.join();
+    evaluator.join();
+    writer.join();
+
+    // the writer has stopped, so the batch left over at the end can go back to the free queue
+    if (unused != nullptr)
+        (void) free.push(unused);
+
+    for (const std::unique_ptr<Batch> &batch : batches)
+    {
+        metrics.buffer_bytes += batch->text.capacity() + batch->output.capacity() +
+                                batch->lines.capacity() * sizeof(std::string_view) +
+                                batch->errors.capacity() * sizeof(Error) + batch->values.capacity() * sizeof(double);
+
+        for (const Program &program : batch->programs)
+            metrics.buffer_bytes += sizeof(Program) + program.code.capacity() * sizeof(Instruction);
+    }
+
+    return metrics;
+}
+
+
+/**
+ * @brief Reading stage, fills free batches with complete lines, sending a block as soon as it holds one
+ * 
+ * @param input file descriptor to read lines from
+ * @return Batch* batch taken but not filled when the input ended, null if none
+ */
+Pipeline::Batch *Pipeline::read(int input)
+{
+    StageMetrics &stage = metrics.stages[static_cast<std::size_t>(PipelineStage::READ)];
+
+    // line split across two blocks
+    std::string carry;
+    bool end = false;
+
+    while (!end)
+    {
+        Batch *batch = take(free, PipelineStage::READ);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        std::vector<char> &text = batch->text;
+
+        while (text.size() <= carry.size())
+            text.resize(text.size() * 2);
+
+        std::memcpy(text.data(), carry.data(), carry.size());
+
+        std::size_t filled = carry.size();
+        std::size_t complete = 0;
+
+        // pipes and terminals return what is available, so lines go on without waiting for a full block
+        while (complete == 0)
+        {
+            // grow the block for very long lines
+            if (filled == text.size())
+                text.resize(text.size() * 2);
+
+            ssize_t length = ::read(input, text.data() + filled, text.size() - filled);
+
+            if (length < 0 && errno == EINTR)
+                continue;
+
+            // last line without newline
+            if (length <= 0)
+            {
+                end = true;
+                complete = filled;
+                break;
+            }
+
+            // the carried line has no newline, only the new bytes can end a line
+            const char *newline = static_cast<const char*>(memrchr(text.data() + filled, '\n', length));
+            filled += length;
+
+            if (newline != nullptr)
+                complete = newline + 1 - text.data();
+        }
+
+        carry.assign(text.data() + complete, filled - complete);
+        batch->size = complete;
+
+        stage.busy += elapsed(start);
+
+        if (complete == 0)
+        {
+            give(compile_input, nullptr, PipelineStage::READ);
+            return batch;
+        }
+
+        stage.batches++;
+        give(compile_input, batch, PipelineStage::READ);
+    }
+
+    give(compile_input, nullptr, PipelineStage::READ);
+    return nullptr;
+}
+
+
+/**
+ * @brief Compiling stage, splits a batch into lines and compiles each into its own program
+ */
+void Pipeline::compile()
+{
+    StageMetrics &stage = metrics.stages[static_cast<std::size_t>(PipelineStage::COMPILE)];
+
+    while (Batch *batch = take(compile_input, PipelineStage::COMPILE))
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        const char *begin = batch->text.data();
+        const char *end = batch->text.data() + batch->size;
+
+        batch->lines.clear();
+
+        while (const char *newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin)))
+        {
+            batch->lines.emplace_back(begin, newline - begin);
+            begin = newline + 1;
+        }
+
+        if (begin < end)
+            batch->lines.emplace_back(begin, end - begin);
+
+        std::size_t count = batch->lines.size();
+
+        // programs keep their buffers between batches
+        if (batch->programs.size() < count)
+            batch->programs.resize(count);
+
+        batch->errors.resize(count);
+        batch->values.resize(count);
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            std::string_view &line = batch->lines[i];
+
+            // accept windows line endings
+            if (line.size() > 0 && line.back() == '\r')
+                line.remove_suffix(1);
+
+            batch->errors[i] = EvaluateExpression::compile(line, batch->programs[i]);
+        }
+
+        stage.busy += elapsed(start);
+        stage.batches++;
+
+        give(evaluate_input, batch, PipelineStage::COMPILE);
+    }
+
+    give(evaluate_input, nullptr, PipelineStage::COMPILE);
+}
+
+
+/**
+ * @brief Evaluating stage, executes every program that compiled
+ */
+void Pipeline::evaluate()
+{
+    StageMetrics &stage = metrics.stages[static_cast<std::size_t>(PipelineStage::EVALUATE)];
+
+    while (Batch *batch = take(evaluate_input, PipelineStage::EVALUATE))
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < batch->lines.size(); i++)
+        {
+            if (!batch->errors[i])
+                batch->errors[i] = EvaluateExpression::execute(batch->programs[i], nullptr, batch->values[i]);
+        }
+
+        stage.busy += elapsed(start);
+        stage.batches++;
+
+        give(write_input, batch, PipelineStage::EVALUATE);
+    }
+
+    give(write_input, nullptr, PipelineStage::EVALUATE);
+}
+
+
+/**
+ * @brief Writing stage, formats results and errors in input order and returns the batch to the reader
+ * 
+ * @param output file results are written to
+ */
+void Pipeline::write(std::FILE *output)
+{
+    StageMetrics &stage = metrics.stages[static_cast<std::size_t>(PipelineStage::WRITE)];
+
+    while (Batch *batch = take(write_input, PipelineStage::WRITE))
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        std::string &out = batch->output;
+        out.clear();
+
+        for (std::size_t i = 0; i < batch->lines.size(); i++)
+        {
+            const Error &error = batch->errors[i];
+
+            if (error)
+            {
+                STATS_ERROR(error.code);
+
+                out += "error: ";
+                EvaluateExpression::describe(error, batch->lines[i], batch->programs[i], out);
+            }
+            else
+            {
+                EvaluateExpression::format(batch->values[i], options, out);
+            }
+
+            out.push_back('\n');
+        }
+
+        std::fwrite(out.data(), 1, out.size(), output);
+
+        // flush once nothing is queued, so a slow stream sees its results right away
+        if (write_input.size() == 0)
+            std::fflush(output);
+
+        metrics.lines += batch->lines.size();
+
+        stage.busy += elapsed(start);
+        stage.batches++;
+
+        give(free, batch, PipelineStage::WRITE);
+    }
+
+    std::fflush(output);
+}
+
+
+/**
+ * @brief Takes the next batch from the input queue of a stage, waiting while it is empty
+ * 
+ * @param queue input queue of the stage
+ * @param stage stage taking the batch, its starved time and queue occupancy are updated
+ * @return Batch* next batch, null when the stream has ended
+ */
+Pipeline::Batch *Pipeline::take(Queue &queue, PipelineStage stage)
+{
+    std::size_t index = static_cast<std::size_t>(stage);
+    QueueMetrics &occupancy = metrics.queues[index];
+
+    std::uint64_t waiting = queue.size();
+    Batch *batch;
+
+    if (!queue.pop(batch))
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::size_t attempts = 0;
+
+        do
+            wait(attempts);
+        while (!queue.pop(batch));
+
+        metrics.stages[index].starved += elapsed(start);
+    }
+
+    occupancy.samples++;
+    occupancy.total += waiting;
+    occupancy.max = std::max(occupancy.max, waiting);
+
+    return batch;
+}
+
+
+/**
+ * @brief Passes a batch to the next stage, waiting while its queue is full
+ * 
+ * @param queue input queue of the next stage
+ * @param batch batch to pass, null to end the stream
+ * @param stage stage giving the batch, its blocked time is updated
+ */
+void Pipeline::give(Queue &queue, Batch *batch, PipelineStage stage)
+{
+    if (queue.push(batch))
+        return;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::size_t attempts = 0;
+
+    do
+        wait(attempts);
+    while (!queue.push(batch));
+
+    metrics.stages[static_cast<std::size_t>(stage)].blocked += elapsed(start);
+}
+
+
+/**
+ * @brief Backs off between polls of a queue, spinning briefly before giving up the core
+ * 
+ * @param attempts polls so far, incremented
+ */
+void Pipeline::wait(std::size_t &attempts)
+{
+    attempts++;
+
+    if (attempts <= SPINS)
+        return;
+
+    if (attempts <= SPINS + YIELDS)
+        std::this_thread::yield();
+    else
+        std::this_thread::sleep_for(SLEEP);
+}
+
+
+/**
+ * @brief Nanoseconds since a point in time
+ * 
+ * @param start point in time
+ * @return std::uint64_t nanoseconds
+ */
+std::uint64_t Pipeline::elapsed(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
\ No newline at end of file
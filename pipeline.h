@@ -0,0 +1,109 @@
+#pragma once
+
+#include "evaluate_expression.h"
+#include "spsc_ring.h"
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <ostream>
+
+
+// threads of the pipeline, in the order a batch of lines passes them
+enum class PipelineStage
+{
+    READ, COMPILE, EVALUATE, WRITE, COUNT
+};
+
+
+// nanoseconds a stage spent on batches, waiting for its input queue and waiting for room in its output queue
+struct StageMetrics
+{
+    std::uint64_t batches = 0;
+    std::uint64_t busy = 0;
+    std::uint64_t starved = 0;
+    std::uint64_t blocked = 0;
+};
+
+
+// batches waiting in the input queue of a stage, sampled whenever the stage takes one, the
+// queue of READ holds the free batches
+struct QueueMetrics
+{
+    std::size_t capacity = 0;
+    std::uint64_t samples = 0;
+    std::uint64_t total = 0;
+    std::uint64_t max = 0;
+};
+
+
+// counters of one run, indexed by PipelineStage
+struct PipelineMetrics
+{
+    std::array<StageMetrics, static_cast<std::size_t>(PipelineStage::COUNT)> stages;
+    std::array<QueueMetrics, static_cast<std::size_t>(PipelineStage::COUNT)> queues;
+    std::uint64_t lines = 0;
+    std::size_t buffer_bytes = 0;
+};
+
+
+// evaluates a stream of newline delimited expressions on four threads connected by bounded
+// lock-free queues: reading, compiling, executing and formatting with writing. A fixed set of
+// batches circulates through the stages and back, so a slow stage stalls the ones before it
+// and memory stays constant however long the stream is. Output is identical to BatchInput
+class Pipeline
+{
+    public:
+        explicit Pipeline(const FormatOptions&);
+
+        Pipeline(const Pipeline&) = delete;
+        Pipeline &operator=(const Pipeline&) = delete;
+
+        static int run(const char*, const FormatOptions&);
+        static void report(const PipelineMetrics&, std::ostream&);
+        static const char *name(PipelineStage);
+
+        PipelineMetrics process(int, std::FILE*);
+
+    private:
+        // block of complete lines and everything the stages produce for them, reused between blocks
+        struct Batch
+        {
+            std::vector<char> text;
+            std::size_t size = 0;
+
+            std::vector<std::string_view> lines;
+            std::vector<Program> programs;
+            std::vector<Error> errors;
+            std::vector<double> values;
+            std::string output;
+        };
+
+        // queue between two stages, a null batch ends the stream
+        using Queue = SpscRing<Batch*>;
+
+        static void wait(std::size_t&);
+        static std::uint64_t elapsed(std::chrono::steady_clock::time_point);
+
+        Batch *take(Queue&, PipelineStage);
+        void give(Queue&, Batch*, PipelineStage);
+
+        Batch *read(int);
+        void compile();
+        void evaluate();
+        void write(std::FILE*);
+
+        FormatOptions options;
+        std::vector<std::unique_ptr<Batch>> batches;
+
+        // free batches and the input queues of the compile, evaluate and write stages
+        Queue free;
+        Queue compile_input;
+        Queue evaluate_input;
+        Queue write_input;
+
+        PipelineMetrics metrics;
+};
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "program_store.h"
+#include <iostream>
+
+
+/**
+ * @brief Compiles a formula file into a program store and lists the formulas that did not compile
+ * 
+ * @param argc number of arguments
+ * @param argv "formulas store"
+ * @return int zero, one when the files cannot be read or written
+ */
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        std::cerr << "usage: precompile formulas store" << std::endl;
+        return 1;
+    }
+
+    StoreStatus status = ProgramStore::precompile(argv[1], argv[2]);
+    ProgramStore store;
+
+    if (status == StoreStatus::OK)
+        status = store.open(argv[2], argv[1]);
+
+    if (status != StoreStatus::OK)
+    {
+        std::cerr << "precompile: " << STORE_MESSAGES[static_cast<int>(status)] << std::endl;
+        return 1;
+    }
+
+    std::size_t failed = 0;
+    std::string message;
+
+    for (std::size_t i = 0; i < store.size(); i++)
+    {
+        if (Error error = store.error(i))
+        {
+            message.clear();
+            EvaluateExpression::describe(error, store.source(i), Program(), message);
+            std::cerr << store.name(i) << ": " << message << std::endl;
+            failed++;
+        }
+    }
+
+    std::cout << store.size() << " formulas, " << failed << " with errors" << std::endl;
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,645 @@
+#include "program_store.h"
+#include "operator_registry.h"
+#include "stats.h"
+#include <cstdio>
+#include <numeric>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// first bytes of every store
+const char STORE_MAGIC[8] = {'C', 'A', 'L', 'C', 'S', 'T', 'O', 'R'};
+
+// reads back as another number on a machine of the other byte order
+const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// number of OpCodes, a store with more or other instructions comes from another version
+const std::uint32_t OPCODES = static_cast<std::uint32_t>(OpCode::CALL2) + 1;
+
+// alignment of the code section, instructions are read in place
+const std::size_t CODE_ALIGNMENT = 16;
+
+// seed and multiplier of the checksum
+const std::uint64_t CHECKSUM_SEED = 0x9E3779B97F4A7C15ull;
+const std::uint64_t CHECKSUM_PRIME = 0x100000001B3ull;
+
+
+/**
+ * @brief Unmaps the store
+ */
+ProgramStore::~ProgramStore()
+{
+    close();
+}
+
+
+/**
+ * @brief Compiles every line of a formula file and writes the programs to a store
+ * 
+ * Lines are "name = expression" or a plain expression, which is its own name. Empty lines
+ * are skipped. A formula that does not compile keeps its error, executing it returns the
+ * error. The store is written next to path and renamed over it, so a store that is open
+ * elsewhere stays intact.
+ * 
+ * @param formulas formula file
+ * @param path store to write
+ * @return StoreStatus OK, CANNOT_READ or CANNOT_WRITE
+ */
+StoreStatus ProgramStore::precompile(const char *formulas, const char *path)
+{
+    std::string text;
+
+    if (!read(formulas, text))
+        return StoreStatus::CANNOT_READ;
+
+    std::vector<Entry> table;
+    std::vector<Instruction> all_code;
+    std::vector<StoredString> all_variables;
+    std::string all_strings;
+
+    Program program;
+    std::size_t start = 0;
+
+    while (start < text.size())
+    {
+        std::size_t end = text.find('\n', start);
+
+        if (end == std::string::npos)
+            end = text.size();
+
+        std::string_view line(text.data() + start, end - start);
+        start = end + 1;
+
+        // accept windows line endings
+        if (line.size() > 0 && line.back() == '\r')
+            line.remove_suffix(1);
+
+        if (line.find_first_not_of(' ') == std::string_view::npos)
+            continue;
+
+        std::string_view name = line;
+        std::string_view expression = line;
+        EvaluateExpression::assignment(line, name, expression);
+
+        Error error = EvaluateExpression::compile(expression, program);
+
+        Entry entry = {};
+        entry.error = static_cast<std::uint32_t>(error.code);
+        entry.error_offset = error.offset;
+        entry.name = {static_cast<std::uint32_t>(all_strings.size()), static_cast<std::uint32_t>(name.size())};
+        all_strings += name;
+        entry.source = {static_cast<std::uint32_t>(all_strings.size()), static_cast<std::uint32_t>(expression.size())};
+        all_strings += expression;
+
+        if (!error)
+        {
+            entry.code = all_code.size();
+            entry.code_size = program.code.size();
+            entry.stack_size = program.stack_size;
+            entry.temporaries = program.temporaries;
+            entry.variables = all_variables.size();
+            entry.variable_count = program.variables.size();
+
+            all_code.insert(all_code.end(), program.code.begin(), program.code.end());
+
+            for (const std::string &variable : program.variables)
+            {
+                all_variables.push_back({static_cast<std::uint32_t>(all_strings.size()), static_cast<std::uint32_t>(variable.size())});
+                all_strings += variable;
+            }
+        }
+
+        table.push_back(entry);
+    }
+
+    // names sorted for binary search, equal names in file order
+    std::vector<std::uint32_t> sorted(table.size());
+    std::iota(sorted.begin(), sorted.end(), 0);
+
+    // every native by slot, CALL instructions keep their slots
+    std::vector<StoredFunction> all_functions(OperatorRegistry::natives());
+
+    for (std::uint32_t slot = 0; slot < all_functions.size(); slot++)
+    {
+        const FunctionEntry &function = OperatorRegistry::function(slot);
+
+        all_functions[slot] = {{static_cast<std::uint32_t>(all_strings.size()), static_cast<std::uint32_t>(function.name.size())},
+                               static_cast<std::uint32_t>(OPERATORS[static_cast<int>(function.op)].arity)};
+        all_strings += function.name;
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end(), [&](std::uint32_t first, std::uint32_t second)
+    {
+        return std::string_view(all_strings).substr(table[first].name.offset, table[first].name.length) <
+               std::string_view(all_strings).substr(table[second].name.offset, table[second].name.length);
+    });
+
+    Header header = {};
+    std::memcpy(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+    header.version = VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.instruction_size = sizeof(Instruction);
+    header.opcodes = OPCODES;
+    header.count = table.size();
+    header.entries = sizeof(Header);
+    header.order = header.entries + table.size() * sizeof(Entry);
+    header.code = (header.order + sorted.size() * sizeof(std::uint32_t) + CODE_ALIGNMENT - 1) / CODE_ALIGNMENT * CODE_ALIGNMENT;
+    header.variables = header.code + all_code.size() * sizeof(Instruction);
+    header.functions = header.variables + all_variables.size() * sizeof(StoredString);
+    header.strings = header.functions + all_functions.size() * sizeof(StoredFunction);
+    header.size = header.strings + all_strings.size();
+    header.source_checksum = checksum(text.data(), text.size());
+
+    std::string file(header.size, '\0');
+    std::memcpy(file.data() + header.entries, table.data(), table.size() * sizeof(Entry));
+    std::memcpy(file.data() + header.order, sorted.data(), sorted.size() * sizeof(std::uint32_t));
+    std::memcpy(file.data() + header.code, all_code.data(), all_code.size() * sizeof(Instruction));
+    std::memcpy(file.data() + header.variables, all_variables.data(), all_variables.size() * sizeof(StoredString));
+    std::memcpy(file.data() + header.functions, all_functions.data(), all_functions.size() * sizeof(StoredFunction));
+    std::memcpy(file.data() + header.strings, all_strings.data(), all_strings.size());
+
+    header.checksum = checksum(file.data() + sizeof(Header), file.size() - sizeof(Header));
+    std::memcpy(file.data(), &header, sizeof(Header));
+
+    std::string temporary = std::string(path) + ".tmp";
+    std::FILE *out = std::fopen(temporary.c_str(), "wb");
+
+    if (out == nullptr)
+        return StoreStatus::CANNOT_WRITE;
+
+    bool written = std::fwrite(file.data(), 1, file.size(), out) == file.size();
+    written = std::fclose(out) == 0 && written;
+
+    if (!written || std::rename(temporary.c_str(), path) != 0)
+    {
+        std::remove(temporary.c_str());
+        return StoreStatus::CANNOT_WRITE;
+    }
+
+    return StoreStatus::OK;
+}
+
+
+/**
+ * @brief Maps a store and checks its version, checksum and structure
+ * 
+ * @param path store to open
+ * @param formulas formula file the store was compiled from, checked for changes unless null
+ * @return StoreStatus OK, or why the store was rejected, the store is closed then
+ */
+StoreStatus ProgramStore::open(const char *path, const char *formulas)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+
+    if (fd < 0)
+        return StoreStatus::CANNOT_READ;
+
+    struct stat info;
+
+    if (fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        return StoreStatus::CANNOT_READ;
+    }
+
+    if (static_cast<std::size_t>(info.st_size) < sizeof(Header))
+    {
+        ::close(fd);
+        return StoreStatus::NOT_A_STORE;
+    }
+
+    length = info.st_size;
+    memory = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (memory == MAP_FAILED)
+    {
+        memory = nullptr;
+        return StoreStatus::CANNOT_READ;
+    }
+
+    const char *base = static_cast<const char*>(memory);
+    header = reinterpret_cast<const Header*>(base);
+
+    StoreStatus status = StoreStatus::OK;
+
+    if (std::memcmp(header->magic, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0)
+        status = StoreStatus::NOT_A_STORE;
+    else if (header->version != VERSION || header->byte_order != BYTE_ORDER_MARK ||
+             header->instruction_size != sizeof(Instruction) || header->opcodes != OPCODES)
+        status = StoreStatus::WRONG_VERSION;
+    else if (header->size != length || checksum(base + sizeof(Header), length - sizeof(Header)) != header->checksum || !valid())
+        status = StoreStatus::CORRUPT;
+    else if (!registered())
+        status = StoreStatus::UNKNOWN_FUNCTION;
+
+    if (status == StoreStatus::OK && formulas != nullptr)
+    {
+        std::string text;
+
+        if (!read(formulas, text))
+            status = StoreStatus::CANNOT_READ;
+        else if (checksum(text.data(), text.size()) != header->source_checksum)
+            status = StoreStatus::STALE;
+    }
+
+    if (status != StoreStatus::OK)
+        close();
+
+    return status;
+}
+
+
+/**
+ * @brief Unmaps the store, it holds no formulas afterwards
+ */
+void ProgramStore::close()
+{
+    if (memory != nullptr)
+        munmap(memory, length);
+
+    memory = nullptr;
+    length = 0;
+    header = nullptr;
+    entries = nullptr;
+    order = nullptr;
+    code = nullptr;
+    variable_names = nullptr;
+    functions = nullptr;
+    strings = nullptr;
+    code_size = 0;
+    variable_names_size = 0;
+    functions_size = 0;
+    strings_size = 0;
+}
+
+
+/**
+ * @brief Number of formulas
+ * 
+ * @return std::size_t formulas, zero when no store is open
+ */
+std::size_t ProgramStore::size() const
+{
+    return header != nullptr ? header->count : 0;
+}
+
+
+/**
+ * @brief Looks up a formula by name
+ * 
+ * @param name name of the formula, or the whole line of a plain expression
+ * @return std::size_t index of the first formula of that name, size() if there is none
+ */
+std::size_t ProgramStore::find(std::string_view name) const
+{
+    const std::uint32_t *last = order + size();
+
+    const std::uint32_t *found = std::lower_bound(order, last, name, [this](std::uint32_t index, std::string_view key)
+    {
+        return this->name(index) < key;
+    });
+
+    return found != last && this->name(*found) == name ? *found : size();
+}
+
+
+/**
+ * @brief Name of a formula
+ * 
+ * @param index formula
+ * @return std::string_view name, valid while the store is open
+ */
+std::string_view ProgramStore::name(std::size_t index) const
+{
+    return {strings + entries[index].name.offset, entries[index].name.length};
+}
+
+
+/**
+ * @brief Expression of a formula, as in the formula file
+ * 
+ * @param index formula
+ * @return std::string_view expression, valid while the store is open
+ */
+std::string_view ProgramStore::source(std::size_t index) const
+{
+    return {strings + entries[index].source.offset, entries[index].source.length};
+}
+
+
+/**
+ * @brief Number of variables of a formula
+ * 
+ * @param index formula
+ * @return std::size_t values execute reads
+ */
+std::size_t ProgramStore::variables(std::size_t index) const
+{
+    return entries[index].variable_count;
+}
+
+
+/**
+ * @brief Name of a variable of a formula
+ * 
+ * @param index formula
+ * @param slot variable in Program::variables order
+ * @return std::string_view name, valid while the store is open
+ */
+std::string_view ProgramStore::variable(std::size_t index, std::size_t slot) const
+{
+    const StoredString &name = variable_names[entries[index].variables + slot];
+    return {strings + name.offset, name.length};
+}
+
+
+/**
+ * @brief Error found when the formula was compiled
+ * 
+ * @param index formula
+ * @return Error syntax error, if any
+ */
+Error ProgramStore::error(std::size_t index) const
+{
+    return {static_cast<ErrorCode>(entries[index].error), entries[index].error_offset};
+}
+
+
+/**
+ * @brief Runs a formula where its code lies in the mapping
+ * 
+ * @param index formula
+ * @param variables one value per variable, may be null without variables
+ * @param result receives the answer to the formula
+ * @return Error compile error of the formula, division by zero, negative logarithm or a missing variable, if any
+ */
+Error ProgramStore::execute(std::size_t index, const double *variables, double &result) const
+{
+    const Entry &entry = entries[index];
+
+    if (entry.error != 0)
+        return error(index);
+
+    if (variables == nullptr && entry.variable_count > 0)
+        return {ErrorCode::UNKNOWN_VARIABLE, 0};
+
+    // value stack and temporaries are sized by the compiler
+    Arena::Scope scope;
+    double *values = scope.allocate<double>(entry.stack_size + entry.temporaries);
+
+    STATS_START(start);
+    Error error = EvaluateExpression::run(code + entry.code, code + entry.code + entry.code_size, variables, values,
+                                          values + entry.stack_size, result);
+    STATS_LAP(start, EXECUTE);
+
+    return error;
+}
+
+
+/**
+ * @brief Copies a formula into a Program, for describe or JitProgram
+ * 
+ * @param index formula
+ * @return Program copy of the compiled formula, empty if it did not compile
+ */
+Program ProgramStore::load(std::size_t index) const
+{
+    const Entry &entry = entries[index];
+    Program program;
+
+    program.code.assign(code + entry.code, code + entry.code + entry.code_size);
+    program.stack_size = entry.stack_size;
+    program.temporaries = entry.temporaries;
+
+    for (std::size_t slot = 0; slot < entry.variable_count; slot++)
+        program.variables.emplace_back(variable(index, slot));
+
+    return program;
+}
+
+
+/**
+ * @brief Checksum of a byte range, eight bytes at a time
+ * 
+ * @param data bytes
+ * @param size number of bytes
+ * @return std::uint64_t checksum
+ */
+std::uint64_t ProgramStore::checksum(const char *data, std::size_t size)
+{
+    std::uint64_t hash = CHECKSUM_SEED ^ size;
+    std::size_t i = 0;
+
+    for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t))
+    {
+        std::uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+
+        hash = (hash ^ word) * CHECKSUM_PRIME;
+        hash ^= hash >> 32;
+    }
+
+    for (; i < size; i++)
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * CHECKSUM_PRIME;
+
+    return hash ^ (hash >> 29);
+}
+
+
+/**
+ * @brief Reads a whole file
+ * 
+ * @param path file to read
+ * @param text receives the contents
+ * @return true file was read
+ * @return false file could not be opened or read
+ */
+bool ProgramStore::read(const char *path, std::string &text)
+{
+    std::FILE *input = std::fopen(path, "rb");
+
+    if (input == nullptr)
+        return false;
+
+    text.clear();
+
+    char block[1 << 16];
+    std::size_t length;
+
+    while ((length = std::fread(block, 1, sizeof(block), input)) > 0)
+        text.append(block, length);
+
+    bool failed = std::ferror(input) != 0;
+    std::fclose(input);
+
+    return !failed;
+}
+
+
+/**
+ * @brief Checks that the sections lie inside the file and every formula inside its sections
+ * 
+ * The checksum catches damage, this catches a file that was written wrong, since execute
+ * trusts the code it runs.
+ * 
+ * @return true sections and formulas are consistent
+ * @return false store is corrupt
+ */
+bool ProgramStore::valid() const
+{
+    const char *base = static_cast<const char*>(memory);
+
+    if (header->count > length / sizeof(Entry) || header->entries != sizeof(Header) ||
+        header->order < header->entries + header->count * sizeof(Entry) ||
+        header->code < header->order + header->count * sizeof(std::uint32_t) || header->code % CODE_ALIGNMENT != 0 ||
+        header->variables < header->code || (header->variables - header->code) % sizeof(Instruction) != 0 ||
+        header->functions < header->variables || (header->functions - header->variables) % sizeof(StoredString) != 0 ||
+        header->strings < header->functions || (header->strings - header->functions) % sizeof(StoredFunction) != 0 ||
+        header->strings > length)
+        return false;
+
+    ProgramStore &self = const_cast<ProgramStore&>(*this);
+    self.entries = reinterpret_cast<const Entry*>(base + header->entries);
+    self.order = reinterpret_cast<const std::uint32_t*>(base + header->order);
+    self.code = reinterpret_cast<const Instruction*>(base + header->code);
+    self.variable_names = reinterpret_cast<const StoredString*>(base + header->variables);
+    self.functions = reinterpret_cast<const StoredFunction*>(base + header->functions);
+    self.strings = base + header->strings;
+    self.code_size = (header->variables - header->code) / sizeof(Instruction);
+    self.variable_names_size = (header->functions - header->variables) / sizeof(StoredString);
+    self.functions_size = (header->strings - header->functions) / sizeof(StoredFunction);
+    self.strings_size = length - header->strings;
+
+    for (std::size_t i = 0; i < functions_size; i++)
+    {
+        const StoredString &name = functions[i].name;
+
+        if (name.offset > strings_size || name.length > strings_size - name.offset)
+            return false;
+    }
+
+    for (std::size_t i = 0; i < header->count; i++)
+    {
+        if (order[i] >= header->count || !valid(entries[i]))
+            return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Checks the strings, variables and code of one formula, simulating its value stack
+ * 
+ * @param entry formula
+ * @return true every range is inside its section and the code never leaves its stack
+ * @return false formula is corrupt
+ */
+bool ProgramStore::valid(const Entry &entry) const
+{
+    for (const StoredString &text : {entry.name, entry.source})
+    {
+        if (text.offset > strings_size || text.length > strings_size - text.offset)
+            return false;
+    }
+
+    if (entry.error >= static_cast<std::uint32_t>(ErrorCode::COUNT))
+        return false;
+
+    if (entry.error != 0)
+        return true;
+
+    if (entry.variables > variable_names_size || entry.variable_count > variable_names_size - entry.variables ||
+        entry.code > code_size || entry.code_size > code_size - entry.code || entry.code_size == 0)
+        return false;
+
+    for (std::size_t slot = 0; slot < entry.variable_count; slot++)
+    {
+        const StoredString &name = variable_names[entry.variables + slot];
+
+        if (name.offset > strings_size || name.length > strings_size - name.offset)
+            return false;
+    }
+
+    std::size_t depth = 0;
+
+    for (const Instruction *instr = code + entry.code; instr != code + entry.code + entry.code_size; instr++)
+    {
+        std::uint32_t op = static_cast<std::uint32_t>(instr->op);
+
+        if (op >= OPCODES)
+            return false;
+
+        switch (instr->op)
+        {
+            case OpCode::PUSH:
+                depth++;
+                break;
+            case OpCode::LOAD:
+                if (instr->slot >= entry.variable_count)
+                    return false;
+
+                depth++;
+                break;
+            case OpCode::FETCH:
+                if (instr->slot >= entry.temporaries)
+                    return false;
+
+                depth++;
+                break;
+            case OpCode::SAVE:
+                if (instr->slot >= entry.temporaries || depth == 0)
+                    return false;
+
+                break;
+            case OpCode::CALL1:
+            case OpCode::CALL2:
+                if (instr->slot >= functions_size || functions[instr->slot].arity != static_cast<std::uint32_t>(OPERATORS[op].arity) ||
+                    depth < functions[instr->slot].arity)
+                    return false;
+
+                depth -= functions[instr->slot].arity - 1;
+                break;
+            default:
+                if (depth < static_cast<std::size_t>(OPERATORS[op].arity))
+                    return false;
+
+                depth -= OPERATORS[op].arity - 1;
+                break;
+        }
+
+        if (depth > entry.stack_size)
+            return false;
+    }
+
+    return depth >= 1;
+}
+
+
+/**
+ * @brief Checks that every native the store was written with is registered in the same slot
+ * 
+ * @return true CALL instructions run the natives they were compiled for
+ * @return false a native is missing or was registered in another order
+ */
+bool ProgramStore::registered() const
+{
+    if (functions_size > OperatorRegistry::natives())
+        return false;
+
+    for (std::uint32_t slot = 0; slot < functions_size; slot++)
+    {
+        const FunctionEntry &function = OperatorRegistry::function(slot);
+        const StoredFunction &stored = functions[slot];
+
+        if (function.name != std::string_view(strings + stored.name.offset, stored.name.length) ||
+            static_cast<std::uint32_t>(OPERATORS[static_cast<int>(function.op)].arity) != stored.arity)
+            return false;
+    }
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "evaluate_expression.h"
+#include <cstdint>
+#include <string_view>
+
+
+// outcome of writing or opening a store, STALE when the formula file changed after it was precompiled and
+// UNKNOWN_FUNCTION when the natives its programs call are not registered in the same slots
+enum class StoreStatus
+{
+    OK, CANNOT_READ, CANNOT_WRITE, NOT_A_STORE, WRONG_VERSION, CORRUPT, STALE, UNKNOWN_FUNCTION
+};
+
+
+// message of every StoreStatus
+constexpr std::string_view STORE_MESSAGES[] = {"", "cannot read file", "cannot write file", "not a program store",
+                                               "store written by another version", "store is corrupt",
+                                               "store is older than its formula file",
+                                               "store calls functions that are not registered"};
+
+
+// compiled formulas saved to a file and mapped back into memory. Programs are executed where
+// they lie in the mapping, nothing is parsed or allocated per formula. All offsets are relative
+// to the start of the file, which is laid out as
+//   Header
+//   Entry[count]                   in formula file order
+//   std::uint32_t[count]           entry indices sorted by name
+//   Instruction[]                  code of every program
+//   StoredString[]                 variable names of every program
+//   StoredFunction[]               native functions by slot, CALL1 and CALL2 address them
+//   char[]                         names, sources, variable and function names
+// A checksum covers everything after the header, and the header records the checksum of the
+// formula file so a store can be checked against it
+class ProgramStore
+{
+    public:
+        static const std::uint32_t VERSION = 2;
+
+        ProgramStore() = default;
+        ~ProgramStore();
+
+        ProgramStore(const ProgramStore&) = delete;
+        ProgramStore &operator=(const ProgramStore&) = delete;
+
+        static StoreStatus precompile(const char*, const char*);
+
+        StoreStatus open(const char*, const char* = nullptr);
+        void close();
+
+        std::size_t size() const;
+        std::size_t find(std::string_view) const;
+        std::string_view name(std::size_t) const;
+        std::string_view source(std::size_t) const;
+        std::size_t variables(std::size_t) const;
+        std::string_view variable(std::size_t, std::size_t) const;
+        Error error(std::size_t) const;
+        Error execute(std::size_t, const double*, double&) const;
+        Program load(std::size_t) const;
+
+    private:
+        // text in the string section
+        struct StoredString
+        {
+            std::uint32_t offset;
+            std::uint32_t length;
+        };
+
+        struct Header
+        {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t byte_order;
+            std::uint32_t instruction_size;
+            std::uint32_t opcodes;
+            std::uint64_t count;
+            std::uint64_t size;
+            std::uint64_t entries;
+            std::uint64_t order;
+            std::uint64_t code;
+            std::uint64_t variables;
+            std::uint64_t functions;
+            std::uint64_t strings;
+            std::uint64_t source_checksum;
+            std::uint64_t checksum;
+        };
+
+        // native function registered when the store was written
+        struct StoredFunction
+        {
+            StoredString name;
+            std::uint32_t arity;
+        };
+
+        // one formula: its code and variables as ranges of their sections, and its compile error
+        struct Entry
+        {
+            std::uint64_t code;
+            std::uint32_t code_size;
+            std::uint32_t stack_size;
+            std::uint32_t temporaries;
+            std::uint32_t variables;
+            std::uint32_t variable_count;
+            std::uint32_t error;
+            std::uint32_t error_offset;
+            StoredString name;
+            StoredString source;
+        };
+
+        static std::uint64_t checksum(const char*, std::size_t);
+        static bool read(const char*, std::string&);
+
+        bool valid() const;
+        bool valid(const Entry&) const;
+        bool registered() const;
+
+        void *memory = nullptr;
+        std::size_t length = 0;
+
+        const Header *header = nullptr;
+        const Entry *entries = nullptr;
+        const std::uint32_t *order = nullptr;
+        const Instruction *code = nullptr;
+        const StoredString *variable_names = nullptr;
+        const StoredFunction *functions = nullptr;
+        const char *strings = nullptr;
+        std::size_t code_size = 0;
+        std::size_t variable_names_size = 0;
+        std::size_t functions_size = 0;
+        std::size_t strings_size = 0;
+};
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "result_cache.h"
+#include "evaluate_expression.h"
+
+// bookkeeping bytes charged per entry on top of key and result
+const std::size_t ENTRY_OVERHEAD = 96;
+
+
+/**
+ * @brief Creates an empty cache
+ * 
+ * @param max_bytes memory limit shared by all shards
+ * @param count number of independently locked shards
+ * @param format notation and precision of every cached result
+ */
+ResultCache::ResultCache(std::size_t max_bytes, std::size_t count, const FormatOptions &format) : options(format)
+{
+    if (count == 0)
+        count = 1;
+
+    for (std::size_t i = 0; i < count; i++)
+        shards.push_back(std::make_unique<Shard>());
+
+    shard_bytes = max_bytes / count;
+}
+
+
+/**
+ * @brief Rewrites expression into a canonical key that evaluates exactly like the original
+ * 
+ * Spaces are dropped unless they separate two names or numbers, and numbers are
+ * rewritten as their shortest round-trip decimal so "01.50" and "1.5" share a key.
+ * 
+ * @param expression infix notation expression
+ * @param key receives the canonical expression
+ */
+void ResultCache::normalize(std::string_view expression, std::string &key)
+{
+    key.clear();
+
+    bool space = false;
+
+    for (std::size_t i = 0; i < expression.length(); i++)
+    {
+        char c = expression[i];
+
+        if (c == ' ')
+        {
+            space = true;
+            continue;
+        }
+
+        bool word = isalnum(c) || c == '.' || c == '_';
+
+        // keep one space where removing it would join two tokens
+        if (space && word && key.size() > 0 && (isalnum(key.back()) || key.back() == '.' || key.back() == '_'))
+            key.push_back(' ');
+
+        space = false;
+
+        if (isdigit(c) || c == '.')
+        {
+            std::size_t len = 1;
+
+            // get length of number
+            while (i + len < expression.length() && (isdigit(expression[i+len]) || expression[i+len] == '.'))
+                len++;
+
+            const char *end = expression.data() + i + len;
+            double value;
+            std::from_chars_result parsed = std::from_chars(expression.data() + i, end, value);
+
+            // invalid numbers are quoted in error messages, so they stay as written
+            if (parsed.ec == std::errc() && parsed.ptr == end)
+            {
+                char buffer[400];
+                std::to_chars_result written = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed);
+                key.append(buffer, written.ptr);
+            }
+            else
+            {
+                key.append(expression.substr(i, len));
+            }
+
+            i += len - 1;
+        }
+        else
+        {
+            key.push_back(c);
+        }
+    }
+}
+
+
+/**
+ * @brief Appends the cached result of expression to out, evaluating and caching it on a miss
+ * 
+ * @param expression infix notation expression
+ * @param out text the result or error message is appended to
+ */
+void ResultCache::evaluate(std::string_view expression, std::string &out)
+{
+    // key buffer is reused between expressions
+    thread_local std::string key;
+    normalize(expression, key);
+
+    Shard &shard = shard_for(key);
+
+    if (find(shard, key, out))
+        return;
+
+    std::size_t start = out.size();
+    EvaluateExpression::evaluate(expression, out, options);
+
+    insert(shard, key, std::string_view(out).substr(start));
+}
+
+
+/**
+ * @brief Sums the counters of every shard
+ * 
+ * @return CacheStats hits, misses, evictions and current size
+ */
+CacheStats ResultCache::stats() const
+{
+    CacheStats total;
+
+    for (const std::unique_ptr<Shard> &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+
+        total.hits += shard->hits;
+        total.misses += shard->misses;
+        total.evictions += shard->evictions;
+        total.entries += shard->entries.size();
+        total.bytes += shard->bytes;
+    }
+
+    return total;
+}
+
+
+/**
+ * @brief Picks the shard that owns key
+ * 
+ * @param key canonical expression
+ * @return Shard& owning shard
+ */
+ResultCache::Shard &ResultCache::shard_for(std::string_view key)
+{
+    return *shards[std::hash<std::string_view>()(key) % shards.size()];
+}
+
+
+/**
+ * @brief Looks up key and marks it as most recently used
+ * 
+ * @param shard owning shard
+ * @param key canonical expression
+ * @param out text the cached result is appended to
+ * @return true key was cached
+ * @return false key was not cached
+ */
+bool ResultCache::find(Shard &shard, std::string_view key, std::string &out)
+{
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto pos = shard.index.find(key);
+
+    if (pos == shard.index.end())
+    {
+        shard.misses++;
+        return false;
+    }
+
+    shard.hits++;
+    shard.entries.splice(shard.entries.begin(), shard.entries, pos->second);
+    out += pos->second->second;
+
+    return true;
+}
+
+
+/**
+ * @brief Stores result of key and evicts least recently used entries over the memory limit
+ * 
+ * @param shard owning shard
+ * @param key canonical expression
+ * @param result result or error message
+ */
+void ResultCache::insert(Shard &shard, std::string_view key, std::string_view result)
+{
+    std::size_t size = key.size() + result.size() + ENTRY_OVERHEAD;
+
+    // entry would never fit
+    if (size > shard_bytes)
+        return;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // another thread may have inserted it meanwhile
+    if (shard.index.find(key) != shard.index.end())
+        return;
+
+    shard.entries.emplace_front(std::string(key), std::string(result));
+    shard.index.emplace(shard.entries.front().first, shard.entries.begin());
+    shard.bytes += size;
+
+    while (shard.bytes > shard_bytes)
+    {
+        std::pair<std::string, std::string> &last = shard.entries.back();
+
+        shard.bytes -= last.first.size() + last.second.size() + ENTRY_OVERHEAD;
+        shard.index.erase(last.first);
+        shard.entries.pop_back();
+        shard.evictions++;
+    }
+}
\ No newline at end of file
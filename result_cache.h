@@ -0,0 +1,58 @@
+#pragma once
+
+#include "evaluate_expression.h"
+#include <list>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+
+// counters summed over all shards
+struct CacheStats
+{
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+    std::size_t entries = 0;
+    std::size_t bytes = 0;
+};
+
+
+class ResultCache
+{
+    public:
+        explicit ResultCache(std::size_t, std::size_t = 16, const FormatOptions& = FormatOptions());
+
+        void evaluate(std::string_view, std::string&);
+        CacheStats stats() const;
+
+        static void normalize(std::string_view, std::string&);
+
+    private:
+        // least recently used entries are at the back of the list
+        struct Shard
+        {
+            std::list<std::pair<std::string, std::string>> entries;
+            std::unordered_map<std::string_view, std::list<std::pair<std::string, std::string>>::iterator> index;
+            mutable std::mutex mutex;
+
+            std::size_t bytes = 0;
+            std::uint64_t hits = 0;
+            std::uint64_t misses = 0;
+            std::uint64_t evictions = 0;
+        };
+
+        Shard &shard_for(std::string_view);
+        bool find(Shard&, std::string_view, std::string&);
+        void insert(Shard&, std::string_view, std::string_view);
+
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::size_t shard_bytes;
+
+        // cached results are text, so they are only valid for one format
+        FormatOptions options;
+};
\ No newline at end of file
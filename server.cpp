@@ -0,0 +1,639 @@
+#include "server.h"
+#include "batch_input.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// epoll ids of the listening socket, the worker wakeup and the signals, clients come after
+const std::uint64_t LISTENER_ID = 0;
+const std::uint64_t WAKEUP_ID = 1;
+const std::uint64_t SIGNALS_ID = 2;
+const std::uint64_t FIRST_CLIENT_ID = 3;
+
+// events handled per epoll_wait
+const int MAX_EVENTS = 256;
+
+// bytes read from a client at once
+const std::size_t READ_SIZE = 64 << 10;
+
+// smaller batches are evaluated on the event loop, handing them to a worker costs more than evaluating them
+const std::size_t INLINE_BYTES = 256;
+
+// a client is not read from while it has this many batches in flight or this much unsent output
+const std::uint64_t MAX_IN_FLIGHT = 64;
+const std::size_t MAX_OUTPUT = 4 << 20;
+
+// a client sending a longer line without newline is disconnected, its input would grow without limit
+const std::size_t MAX_LINE = 1 << 20;
+
+
+/**
+ * @brief Serves until interrupted
+ * 
+ * @param address port number for loopback TCP, otherwise the path of a unix socket
+ * @param threads number of evaluation threads
+ * @param cache_bytes memory limit of the result cache, zero disables it
+ * @param options notation and precision of results
+ * @return int zero after SIGINT or SIGTERM, one if the address could not be used
+ */
+int Server::run(const char *address, std::size_t threads, std::size_t cache_bytes, const FormatOptions &options)
+{
+    Server server(threads, cache_bytes, options);
+
+    if (!server.listen(address))
+        return 1;
+
+    std::cerr << "listening on " << address << std::endl;
+    server.serve();
+
+    return 0;
+}
+
+
+/**
+ * @brief Creates the event loop and worker threads
+ * 
+ * @param threads number of evaluation threads, one evaluates on the event loop
+ * @param cache_bytes memory limit of the result cache, zero disables it
+ * @param format notation and precision of results
+ */
+Server::Server(std::size_t threads, std::size_t cache_bytes, const FormatOptions &format) : options(format)
+{
+    // thousands of clients need more descriptors than the usual soft limit
+    rlimit files;
+
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max)
+    {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    // signals are read by the event loop, so block them before the workers start
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+    wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    signals = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+
+    event.data.u64 = WAKEUP_ID;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, wakeup, &event);
+
+    event.data.u64 = SIGNALS_ID;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, signals, &event);
+
+    next_id = FIRST_CLIENT_ID;
+
+    if (threads > 1)
+        pool = std::make_unique<ThreadPool>(threads);
+
+    if (cache_bytes > 0)
+        cache = std::make_unique<ResultCache>(cache_bytes, 16, options);
+}
+
+
+/**
+ * @brief Finishes running batches and closes every socket
+ */
+Server::~Server()
+{
+    pool.reset();
+
+    for (std::pair<const std::uint64_t, std::unique_ptr<Connection>> &entry : connections)
+        ::close(entry.second->fd);
+
+    for (int fd : {listener, epoll, wakeup, signals})
+    {
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    if (!socket_path.empty())
+        unlink(socket_path.c_str());
+}
+
+
+/**
+ * @brief Resolves a port number to a loopback TCP address and anything else to a unix socket path
+ * 
+ * @param text port number or socket path
+ * @param storage receives the socket address
+ * @param length receives the size of the socket address
+ * @return true address is usable
+ * @return false port out of range or path too long
+ */
+bool Server::address(const char *text, sockaddr_storage &storage, socklen_t &length)
+{
+    std::memset(&storage, 0, sizeof(storage));
+
+    std::size_t size = std::strlen(text);
+    bool port = size > 0 && std::strspn(text, "0123456789") == size;
+
+    if (port)
+    {
+        unsigned long number = std::strtoul(text, nullptr, 10);
+
+        sockaddr_in &inet = reinterpret_cast<sockaddr_in&>(storage);
+        inet.sin_family = AF_INET;
+        inet.sin_port = htons(static_cast<std::uint16_t>(number));
+        inet.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        length = sizeof(sockaddr_in);
+
+        return number <= 65535;
+    }
+
+    sockaddr_un &local = reinterpret_cast<sockaddr_un&>(storage);
+    local.sun_family = AF_UNIX;
+    length = sizeof(sockaddr_un);
+
+    if (size == 0 || size >= sizeof(local.sun_path))
+        return false;
+
+    std::memcpy(local.sun_path, text, size);
+    return true;
+}
+
+
+/**
+ * @brief Opens a blocking client connection to a server
+ * 
+ * @param text port number or socket path
+ * @return int connected socket, -1 on failure
+ */
+int Server::connect(const char *text)
+{
+    sockaddr_storage storage;
+    socklen_t length;
+
+    if (!address(text, storage, length))
+        return -1;
+
+    int fd = socket(storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (fd < 0)
+        return -1;
+
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&storage), length) != 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+
+    // requests are small, send them right away
+    int on = 1;
+
+    if (storage.ss_family == AF_INET)
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    return fd;
+}
+
+
+/**
+ * @brief Starts listening on a loopback port or unix socket
+ * 
+ * @param text port number or socket path, a stale socket file is replaced but no other kind of file
+ * @return true listening
+ * @return false address could not be used, the reason is printed
+ */
+bool Server::listen(const char *text)
+{
+    sockaddr_storage storage;
+    socklen_t length;
+
+    if (!address(text, storage, length))
+    {
+        std::cerr << "invalid address: " << text << std::endl;
+        return false;
+    }
+
+    listener = socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    int on = 1;
+
+    if (storage.ss_family == AF_INET)
+    {
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    else
+    {
+        // only a leftover socket is removed, a mistyped path must not delete a file
+        struct stat status;
+        bool exists = lstat(text, &status) == 0;
+
+        if (exists && !S_ISSOCK(status.st_mode))
+        {
+            std::cerr << "could not listen on " << text << ": not a socket" << std::endl;
+            return false;
+        }
+
+        if (!exists && errno != ENOENT)
+        {
+            std::cerr << "could not listen on " << text << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        unlink(text);
+        socket_path = text;
+    }
+
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&storage), length) != 0 ||
+        ::listen(listener, SOMAXCONN) != 0)
+    {
+        std::cerr << "could not listen on " << text << ": " << std::strerror(errno) << std::endl;
+        socket_path.clear();
+
+        return false;
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = LISTENER_ID;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+
+    return true;
+}
+
+
+/**
+ * @brief Runs the event loop until SIGINT or SIGTERM
+ */
+void Server::serve()
+{
+    epoll_event events[MAX_EVENTS];
+    bool running = true;
+
+    while (running)
+    {
+        int count = epoll_wait(epoll, events, MAX_EVENTS, -1);
+
+        if (count < 0 && errno != EINTR)
+        {
+            std::cerr << "epoll_wait failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            std::uint64_t id = events[i].data.u64;
+
+            if (id == LISTENER_ID)
+            {
+                accept_clients();
+            }
+            else if (id == WAKEUP_ID)
+            {
+                collect();
+            }
+            else if (id == SIGNALS_ID)
+            {
+                running = false;
+            }
+            else
+            {
+                std::unordered_map<std::uint64_t, std::unique_ptr<Connection>>::iterator found = connections.find(id);
+
+                if (found == connections.end())
+                    continue;
+
+                Connection &connection = *found->second;
+
+                if (events[i].events & EPOLLOUT)
+                    write_responses(connection);
+
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    read_requests(connection);
+
+                if (!update(connection))
+                    connections.erase(found);
+            }
+        }
+    }
+}
+
+
+/**
+ * @brief Accepts every waiting client
+ */
+void Server::accept_clients()
+{
+    while (true)
+    {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            // out of descriptors, the client waits in the backlog until one is closed
+            if (errno == EMFILE || errno == ENFILE)
+                std::cerr << "could not accept client: " << std::strerror(errno) << std::endl;
+
+            return;
+        }
+
+        // results are small, send them right away, fails harmlessly on unix sockets
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        std::unique_ptr<Connection> connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        connection->id = next_id++;
+        connection->events = EPOLLIN;
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = connection->id;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+
+        connections.emplace(connection->id, std::move(connection));
+    }
+}
+
+
+/**
+ * @brief Reads from a client and submits every complete line read as one batch
+ * 
+ * @param connection readable client
+ */
+void Server::read_requests(Connection &connection)
+{
+    if (connection.eof || connection.broken)
+        return;
+
+    char buffer[READ_SIZE];
+    ssize_t length = recv(connection.fd, buffer, sizeof(buffer), 0);
+
+    if (length < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            connection.broken = true;
+
+        return;
+    }
+
+    // a last line without newline is still answered
+    if (length == 0)
+    {
+        connection.eof = true;
+
+        if (connection.input.empty())
+            return;
+
+        connection.input.push_back('\n');
+        submit(connection, std::move(connection.input));
+        connection.input.clear();
+
+        return;
+    }
+
+    // only the new bytes need to be searched for the end of the last complete line
+    const char *newline = static_cast<const char*>(memrchr(buffer, '\n', length));
+
+    if (newline == nullptr)
+    {
+        connection.input.append(buffer, length);
+
+        if (connection.input.size() > MAX_LINE)
+            connection.broken = true;
+
+        return;
+    }
+
+    std::size_t complete = newline + 1 - buffer;
+
+    connection.input.append(buffer, complete);
+    submit(connection, std::move(connection.input));
+    connection.input.assign(buffer + complete, length - complete);
+}
+
+
+/**
+ * @brief Evaluates complete lines on a worker, or right away for small batches and without workers
+ * 
+ * @param connection client that sent the lines
+ * @param input one or more newline terminated expressions
+ */
+void Server::submit(Connection &connection, std::string &&input)
+{
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->connection = connection.id;
+    batch->sequence = connection.submitted++;
+    batch->input = std::move(input);
+
+    if (pool == nullptr || batch->input.size() < INLINE_BYTES)
+    {
+        evaluate(*batch);
+        deliver(connection, batch);
+
+        return;
+    }
+
+    pool->submit([this, batch]
+    {
+        evaluate(*batch);
+
+        bool first;
+
+        {
+            std::lock_guard<std::mutex> lock(finished_mutex);
+
+            first = finished.empty();
+            finished.push_back(batch);
+        }
+
+        // the event loop collects everything that finished since it last woke up
+        if (first)
+        {
+            std::uint64_t one = 1;
+            ssize_t written = write(wakeup, &one, sizeof(one));
+            (void)written;
+        }
+    });
+}
+
+
+/**
+ * @brief Evaluates every line of a batch
+ * 
+ * @param batch lines to evaluate, receives one result line per input line
+ */
+void Server::evaluate(Batch &batch)
+{
+    const char *start = batch.input.data();
+    const char *end = start + batch.input.size();
+
+    batch.output.reserve(batch.input.size());
+
+    while (const char *newline = static_cast<const char*>(std::memchr(start, '\n', end - start)))
+    {
+        BatchInput::evaluate_line(std::string_view(start, newline - start), batch.output, cache.get(), options);
+        start = newline + 1;
+    }
+}
+
+
+/**
+ * @brief Hands batches finished by the workers to their clients
+ */
+void Server::collect()
+{
+    // reset the wakeup before taking the batches, so later batches wake the loop again
+    std::uint64_t count;
+    ssize_t length = read(wakeup, &count, sizeof(count));
+    (void)length;
+
+    std::vector<std::shared_ptr<Batch>> batches;
+
+    {
+        std::lock_guard<std::mutex> lock(finished_mutex);
+        batches.swap(finished);
+    }
+
+    for (std::shared_ptr<Batch> &batch : batches)
+    {
+        std::unordered_map<std::uint64_t, std::unique_ptr<Connection>>::iterator found = connections.find(batch->connection);
+
+        // client is gone
+        if (found == connections.end())
+            continue;
+
+        deliver(*found->second, std::move(batch));
+
+        if (!update(*found->second))
+            connections.erase(found);
+    }
+}
+
+
+/**
+ * @brief Queues the output of a batch once every earlier batch of the client is queued
+ * 
+ * @param connection client that sent the batch
+ * @param batch evaluated batch
+ */
+void Server::deliver(Connection &connection, std::shared_ptr<Batch> batch)
+{
+    connection.ready.emplace(batch->sequence, std::move(batch));
+
+    while (connection.ready.size() > 0 && connection.ready.begin()->first == connection.delivered)
+    {
+        std::string &output = connection.ready.begin()->second->output;
+
+        // nothing waiting to be sent, take the buffer instead of copying it
+        if (connection.written == connection.output.size())
+        {
+            connection.output.swap(output);
+            connection.written = 0;
+        }
+        else
+        {
+            connection.output += output;
+        }
+
+        connection.ready.erase(connection.ready.begin());
+        connection.delivered++;
+    }
+
+    write_responses(connection);
+}
+
+
+/**
+ * @brief Sends as much queued output as the socket takes
+ * 
+ * @param connection client with queued output
+ */
+void Server::write_responses(Connection &connection)
+{
+    while (connection.written < connection.output.size() && !connection.broken)
+    {
+        ssize_t length = send(connection.fd, connection.output.data() + connection.written,
+                              connection.output.size() - connection.written, MSG_NOSIGNAL);
+
+        if (length > 0)
+            connection.written += length;
+        else if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+            connection.broken = true;
+        else if (errno != EINTR)
+            break;
+    }
+
+    if (connection.written == connection.output.size())
+    {
+        connection.output.clear();
+        connection.written = 0;
+    }
+}
+
+
+/**
+ * @brief Closes a finished client, or watches it for reading while it is not backed up and for writing while output is queued
+ * 
+ * @param connection client to update
+ * @return true client stays open
+ * @return false client was closed and must be removed
+ */
+bool Server::update(Connection &connection)
+{
+    bool sent = connection.written == connection.output.size();
+
+    if (connection.broken || (connection.eof && connection.delivered == connection.submitted && sent))
+    {
+        close(connection);
+        return false;
+    }
+
+    bool backed_up = connection.submitted - connection.delivered >= MAX_IN_FLIGHT ||
+                     connection.output.size() - connection.written >= MAX_OUTPUT;
+
+    std::uint32_t events = 0;
+
+    if (!connection.eof && !backed_up)
+        events |= EPOLLIN;
+
+    if (!sent)
+        events |= EPOLLOUT;
+
+    if (events != connection.events)
+    {
+        epoll_event event = {};
+        event.events = events;
+        event.data.u64 = connection.id;
+        epoll_ctl(epoll, EPOLL_CTL_MOD, connection.fd, &event);
+
+        connection.events = events;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Stops watching a client and closes its socket
+ * 
+ * @param connection client to close
+ */
+void Server::close(Connection &connection)
+{
+    epoll_ctl(epoll, EPOLL_CTL_DEL, connection.fd, nullptr);
+    ::close(connection.fd);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "thread_pool.h"
+#include "result_cache.h"
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <sys/socket.h>
+
+
+// long running server answering newline delimited expressions on a unix socket or loopback port
+class Server
+{
+    public:
+        Server(std::size_t, std::size_t, const FormatOptions&);
+        ~Server();
+
+        Server(const Server&) = delete;
+        Server &operator=(const Server&) = delete;
+
+        static int run(const char*, std::size_t, std::size_t, const FormatOptions&);
+        static int connect(const char*);
+
+        bool listen(const char*);
+        void serve();
+
+    private:
+        // complete lines read at once from one client and their results
+        struct Batch
+        {
+            std::uint64_t connection;
+            std::uint64_t sequence;
+            std::string input;
+            std::string output;
+        };
+
+        // client socket, batches are numbered so results go out in request order
+        struct Connection
+        {
+            int fd;
+            std::uint64_t id;
+            std::uint32_t events = 0;
+
+            std::string input;
+            std::string output;
+            std::size_t written = 0;
+
+            std::uint64_t submitted = 0;
+            std::uint64_t delivered = 0;
+            std::map<std::uint64_t, std::shared_ptr<Batch>> ready;
+
+            // client finished sending, or the socket failed
+            bool eof = false;
+            bool broken = false;
+        };
+
+        static bool address(const char*, sockaddr_storage&, socklen_t&);
+
+        void accept_clients();
+        void read_requests(Connection&);
+        void submit(Connection&, std::string&&);
+        void evaluate(Batch&);
+        void collect();
+        void deliver(Connection&, std::shared_ptr<Batch>);
+        void write_responses(Connection&);
+        bool update(Connection&);
+        void close(Connection&);
+
+        int listener = -1;
+        int epoll = -1;
+        int wakeup = -1;
+        int signals = -1;
+        std::string socket_path;
+
+        std::unique_ptr<ThreadPool> pool;
+        std::unique_ptr<ResultCache> cache;
+        FormatOptions options;
+
+        std::unordered_map<std::uint64_t, std::unique_ptr<Connection>> connections;
+        std::uint64_t next_id = 0;
+
+        // batches evaluated by the workers, handed back to the event loop
+        std::mutex finished_mutex;
+        std::vector<std::shared_ptr<Batch>> finished;
+};
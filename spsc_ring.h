@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+
+// bounded queue between one producer thread and one consumer thread, without locks. Each side
+// keeps a copy of the other side's index and only reloads it when the ring looks full or empty
+template <typename T>
+class SpscRing
+{
+    public:
+        explicit SpscRing(std::size_t);
+
+        SpscRing(const SpscRing&) = delete;
+        SpscRing &operator=(const SpscRing&) = delete;
+
+        bool push(const T&);
+        bool pop(T&);
+        std::size_t size() const;
+        std::size_t capacity() const;
+
+    private:
+        // a cache line of its own for each index, so producer and consumer do not share one
+        static const std::size_t LINE = 64;
+
+        std::vector<T> slots;
+        std::size_t mask;
+
+        // next slot to read, written by the consumer
+        alignas(LINE) std::atomic<std::size_t> head{0};
+        std::size_t cached_tail = 0;
+
+        // next slot to write, written by the producer
+        alignas(LINE) std::atomic<std::size_t> tail{0};
+        std::size_t cached_head = 0;
+};
+
+
+/**
+ * @brief Creates an empty ring
+ * 
+ * @param capacity most entries held, rounded up to a power of two
+ */
+template <typename T>
+SpscRing<T>::SpscRing(std::size_t capacity)
+{
+    std::size_t size = 1;
+
+    while (size < capacity)
+        size *= 2;
+
+    slots.resize(size);
+    mask = size - 1;
+}
+
+
+/**
+ * @brief Adds an entry, called by the producer only
+ * 
+ * @param value entry to add
+ * @return true entry was added
+ * @return false ring is full
+ */
+template <typename T>
+bool SpscRing<T>::push(const T &value)
+{
+    std::size_t position = tail.load(std::memory_order_relaxed);
+
+    if (position - cached_head == slots.size())
+    {
+        cached_head = head.load(std::memory_order_acquire);
+
+        if (position - cached_head == slots.size())
+            return false;
+    }
+
+    slots[position & mask] = value;
+    tail.store(position + 1, std::memory_order_release);
+
+    return true;
+}
+
+
+/**
+ * @brief Removes the oldest entry, called by the consumer only
+ * 
+ * @param value receives the entry
+ * @return true an entry was removed
+ * @return false ring is empty
+ */
+template <typename T>
+bool SpscRing<T>::pop(T &value)
+{
+    std::size_t position = head.load(std::memory_order_relaxed);
+
+    if (position == cached_tail)
+    {
+        cached_tail = tail.load(std::memory_order_acquire);
+
+        if (position == cached_tail)
+            return false;
+    }
+
+    value = slots[position & mask];
+    head.store(position + 1, std::memory_order_release);
+
+    return true;
+}
+
+
+/**
+ * @brief Number of entries, exact only when neither side is running
+ * 
+ * @return std::size_t entries in the ring
+ */
+template <typename T>
+std::size_t SpscRing<T>::size() const
+{
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+}
+
+
+/**
+ * @brief Most entries the ring holds
+ * 
+ * @return std::size_t capacity
+ */
+template <typename T>
+std::size_t SpscRing<T>::capacity() const
+{
+    return slots.size();
+}
\ No newline at end of file
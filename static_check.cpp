@@ -0,0 +1,17 @@
+#include "static_program.h"
+
+
+// built by the static_* tests with FORMULA defined, a malformed or failing formula must stop the build
+constexpr auto formula = calc::compile(FORMULA);
+constexpr double value = formula();
+
+
+/**
+ * @brief Exits with the folded value, only reached by formulas the compiler accepts
+ * 
+ * @return int zero for a finite value
+ */
+int main()
+{
+    return std::isfinite(value) ? 0 : 1;
+}
\ No newline at end of file
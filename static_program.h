@@ -0,0 +1,1047 @@
+#pragma once
+
+#include "evaluate_expression.h"
+#include "grammar.h"
+#include "operator_registry.h"
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+
+// formulas written as string literals, parsed, checked and folded by the compiler:
+//     constexpr auto f = calc::compile("3 + 4 * 2 / (1 - 5)^(2^3)");
+// syntax errors stop the build, variables are bound when the formula runs: f(x, y)
+namespace calc
+{
+
+// significant digits kept when reading a number, later ones only decide rounding
+constexpr std::size_t NUMBER_DIGITS = 800;
+
+
+// parts of std::vector the parser uses, with a fixed capacity so it works in constant expressions
+template <typename T, std::size_t CAPACITY>
+struct FixedStack
+{
+    T items[CAPACITY] = {};
+    std::size_t count = 0;
+
+    constexpr void push_back(const T &item) { items[count++] = item; }
+    constexpr void pop_back() { count--; }
+    constexpr void clear() { count = 0; }
+    constexpr void resize(std::size_t size) { count = size; }
+    constexpr T &back() { return items[count - 1]; }
+    constexpr std::size_t size() const { return count; }
+    constexpr T &operator[](std::size_t i) { return items[i]; }
+    constexpr const T &operator[](std::size_t i) const { return items[i]; }
+};
+
+
+// unsigned integer of up to 4096 bits, enough to round any decimal number of NUMBER_DIGITS digits exactly
+class BigInteger
+{
+    public:
+        constexpr explicit BigInteger(std::uint32_t value = 0) : limbs{value}, size(value != 0 ? 1 : 0) {}
+
+        constexpr void multiply(std::uint32_t, std::uint32_t = 0);
+        constexpr void shift_left(std::size_t);
+        constexpr void halve();
+        constexpr void subtract(const BigInteger&);
+        constexpr int compare(const BigInteger&) const;
+        constexpr std::size_t bits() const;
+        constexpr std::uint64_t window(std::size_t) const;
+        constexpr bool any_below(std::size_t) const;
+        constexpr bool zero() const { return size == 0; }
+
+    private:
+        static constexpr std::size_t LIMBS = 128;
+
+        std::uint32_t limbs[LIMBS] = {};
+        std::size_t size = 0;
+};
+
+
+/**
+ * @brief Multiplies by a small factor and adds a small number
+ * 
+ * @param factor multiplier
+ * @param addend added after multiplying
+ */
+constexpr void BigInteger::multiply(std::uint32_t factor, std::uint32_t addend)
+{
+    std::uint64_t carry = addend;
+
+    for (std::size_t i = 0; i < size; i++)
+    {
+        std::uint64_t product = static_cast<std::uint64_t>(limbs[i]) * factor + carry;
+        limbs[i] = static_cast<std::uint32_t>(product);
+        carry = product >> 32;
+    }
+
+    if (carry > 0)
+        limbs[size++] = static_cast<std::uint32_t>(carry);
+}
+
+
+/**
+ * @brief Multiplies by a power of two
+ * 
+ * @param shift exponent of the power of two
+ */
+constexpr void BigInteger::shift_left(std::size_t shift)
+{
+    if (size == 0)
+        return;
+
+    std::size_t whole = shift / 32;
+    std::size_t part = shift % 32;
+
+    limbs[size + whole] = 0;
+
+    for (std::size_t i = size; i-- > 0;)
+    {
+        std::uint64_t moved = static_cast<std::uint64_t>(limbs[i]) << part;
+        limbs[i + whole + 1] |= static_cast<std::uint32_t>(moved >> 32);
+        limbs[i + whole] = static_cast<std::uint32_t>(moved);
+    }
+
+    for (std::size_t i = 0; i < whole; i++)
+        limbs[i] = 0;
+
+    size += whole + 1;
+
+    while (size > 0 && limbs[size - 1] == 0)
+        size--;
+}
+
+
+/**
+ * @brief Divides by two, dropping the lowest bit
+ */
+constexpr void BigInteger::halve()
+{
+    for (std::size_t i = 0; i < size; i++)
+        limbs[i] = (limbs[i] >> 1) | (i + 1 < size ? limbs[i + 1] << 31 : 0);
+
+    if (size > 0 && limbs[size - 1] == 0)
+        size--;
+}
+
+
+/**
+ * @brief Subtracts a number that is not larger than this one
+ * 
+ * @param other subtrahend
+ */
+constexpr void BigInteger::subtract(const BigInteger &other)
+{
+    std::int64_t borrow = 0;
+
+    for (std::size_t i = 0; i < size; i++)
+    {
+        std::int64_t difference = static_cast<std::int64_t>(limbs[i]) - (i < other.size ? other.limbs[i] : 0) - borrow;
+        borrow = difference < 0 ? 1 : 0;
+        limbs[i] = static_cast<std::uint32_t>(difference + (borrow << 32));
+    }
+
+    while (size > 0 && limbs[size - 1] == 0)
+        size--;
+}
+
+
+/**
+ * @brief Orders two numbers
+ * 
+ * @param other number to compare with
+ * @return int negative, zero or positive as this number is smaller, equal or larger
+ */
+constexpr int BigInteger::compare(const BigInteger &other) const
+{
+    if (size != other.size)
+        return size < other.size ? -1 : 1;
+
+    for (std::size_t i = size; i-- > 0;)
+    {
+        if (limbs[i] != other.limbs[i])
+            return limbs[i] < other.limbs[i] ? -1 : 1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Number of bits without leading zeros
+ * 
+ * @return std::size_t bit length, zero for zero
+ */
+constexpr std::size_t BigInteger::bits() const
+{
+    if (size == 0)
+        return 0;
+
+    std::size_t length = (size - 1) * 32;
+
+    for (std::uint32_t top = limbs[size - 1]; top != 0; top >>= 1)
+        length++;
+
+    return length;
+}
+
+
+/**
+ * @brief 64 bits starting at a bit position
+ * 
+ * @param low position of the lowest bit returned
+ * @return std::uint64_t bits low to low + 63
+ */
+constexpr std::uint64_t BigInteger::window(std::size_t low) const
+{
+    std::uint64_t bits = 0;
+
+    for (std::size_t i = 0; i < 64; i++)
+    {
+        std::size_t bit = low + i;
+
+        if (bit / 32 < size && (limbs[bit / 32] >> (bit % 32) & 1) != 0)
+            bits |= std::uint64_t(1) << i;
+    }
+
+    return bits;
+}
+
+
+/**
+ * @brief Whether any bit below a position is set
+ * 
+ * @param position first bit not checked
+ * @return true some lower bit is set
+ */
+constexpr bool BigInteger::any_below(std::size_t position) const
+{
+    for (std::size_t bit = 0; bit < position && bit / 32 < size; bit++)
+    {
+        if ((limbs[bit / 32] >> (bit % 32) & 1) != 0)
+            return true;
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief Rounds an integer times a power of two to the nearest double, ties to even
+ * 
+ * @param mantissa integer part of the exact value
+ * @param exponent power of two the mantissa is scaled by
+ * @param inexact the exact value is a little larger than the mantissa
+ * @param value receives the rounded value
+ * @return true value is finite and not rounded to zero
+ */
+constexpr bool round(std::uint64_t mantissa, std::int64_t exponent, bool inexact, double &value)
+{
+    std::int64_t length = 0;
+
+    for (std::uint64_t rest = mantissa; rest != 0; rest >>= 1)
+        length++;
+
+    // drop bits beyond the 53 a double keeps, or more for subnormal results
+    std::int64_t drop = std::max<std::int64_t>(length - 53, -1074 - exponent);
+
+    if (drop > 64)
+    {
+        mantissa = 0;
+    }
+    else if (drop > 0)
+    {
+        std::uint64_t rest = (drop == 64) ? mantissa : mantissa & ((std::uint64_t(1) << drop) - 1);
+        std::uint64_t half = std::uint64_t(1) << (drop - 1);
+
+        mantissa = (drop == 64) ? 0 : mantissa >> drop;
+
+        if (rest > half || (rest == half && (inexact || (mantissa & 1) != 0)))
+            mantissa++;
+
+        exponent += drop;
+    }
+
+    length = 0;
+
+    for (std::uint64_t rest = mantissa; rest != 0; rest >>= 1)
+        length++;
+
+    // 2^1024 and above overflow
+    if (mantissa == 0 || exponent + length > 1024)
+        return false;
+
+    // scaling by two is exact, every step keeps the same significant bits
+    value = static_cast<double>(mantissa);
+
+    for (; exponent > 0; exponent--)
+        value *= 2;
+
+    for (; exponent < 0; exponent++)
+        value /= 2;
+
+    return true;
+}
+
+
+/**
+ * @brief Reads a number of digits and at most one point, rounded as std::from_chars does
+ * 
+ * @param text digits and points found by the tokenizer
+ * @param value receives the number
+ * @return true text is a number within the range of double
+ * @return false text is malformed, overflows or underflows to zero
+ */
+constexpr bool read_number(std::string_view text, double &value)
+{
+    std::size_t points = 0;
+
+    for (char c : text)
+        points += (c == '.') ? 1 : 0;
+
+    if (points > 1 || points == text.length())
+        return false;
+
+    // the number is mantissa * 10^exponent
+    BigInteger mantissa;
+    std::int64_t exponent = 0;
+    std::size_t digits = 0;
+    bool point = false;
+    bool sticky = false;
+
+    for (char c : text)
+    {
+        if (c == '.')
+        {
+            point = true;
+        }
+        else if (digits == 0 && c == '0')
+        {
+            exponent -= point ? 1 : 0;
+        }
+        else if (digits < NUMBER_DIGITS)
+        {
+            mantissa.multiply(10, c - '0');
+            exponent -= point ? 1 : 0;
+            digits++;
+        }
+        else
+        {
+            // digits past NUMBER_DIGITS only decide rounding, through one nonzero digit after the kept ones
+            exponent += point ? 0 : 1;
+            sticky = sticky || c != '0';
+        }
+    }
+
+    if (sticky)
+    {
+        mantissa.multiply(10, 1);
+        exponent--;
+        digits++;
+    }
+
+    if (digits == 0)
+    {
+        value = 0;
+        return true;
+    }
+
+    // 10^309 overflows and anything below 10^-324 rounds to zero
+    std::int64_t leading = exponent + static_cast<std::int64_t>(digits) - 1;
+
+    if (leading > 308 || leading < -325)
+        return false;
+
+    std::uint64_t bits = 0;
+    std::int64_t binary = 0;
+    bool inexact = false;
+
+    if (exponent >= 0)
+    {
+        for (std::int64_t i = 0; i < exponent; i++)
+            mantissa.multiply(10);
+
+        std::size_t length = mantissa.bits();
+        std::size_t low = (length > 64) ? length - 64 : 0;
+
+        bits = mantissa.window(low);
+        binary = static_cast<std::int64_t>(low);
+        inexact = mantissa.any_below(low);
+    }
+    else
+    {
+        // 56 bit quotient mantissa * 2^shift / 10^-exponent, by long division
+        BigInteger scale(1);
+
+        for (std::int64_t i = 0; i < -exponent; i++)
+            scale.multiply(10);
+
+        std::int64_t shift = 55 + static_cast<std::int64_t>(scale.bits()) - static_cast<std::int64_t>(mantissa.bits());
+
+        if (shift > 0)
+            mantissa.shift_left(shift);
+        else
+            scale.shift_left(-shift);
+
+        scale.shift_left(55);
+
+        for (int bit = 55; bit >= 0; bit--)
+        {
+            if (mantissa.compare(scale) >= 0)
+            {
+                mantissa.subtract(scale);
+                bits |= std::uint64_t(1) << bit;
+            }
+
+            scale.halve();
+        }
+
+        binary = -shift;
+        inexact = !mantissa.zero();
+    }
+
+    return round(bits, binary, inexact, value);
+}
+
+
+/**
+ * @brief Raises a power of a whole number when the result is exact
+ * 
+ * pow is not constexpr, so only powers that every implementation computes exactly are folded.
+ * 
+ * @param base number raised
+ * @param exponent power
+ * @param result receives the power
+ * @return true the power was computed
+ */
+constexpr bool power(double base, double exponent, double &result)
+{
+    // 2^53, the largest range of whole numbers a double holds exactly
+    const double exact = 9007199254740992.0;
+
+    // pow(x, 0) is 1 for every x
+    if (exponent == 0)
+    {
+        result = 1;
+        return true;
+    }
+
+    if (!(exponent > 0 && exponent <= 64 && base >= -exact && base <= exact) || base == 0 ||
+        exponent != static_cast<std::int64_t>(exponent) || base != static_cast<std::int64_t>(base))
+        return false;
+
+    std::int64_t whole = static_cast<std::int64_t>(base);
+    std::int64_t product = 1;
+
+    for (std::int64_t i = 0; i < static_cast<std::int64_t>(exponent); i++)
+    {
+        product *= whole;
+
+        if (product > static_cast<std::int64_t>(exact) || product < -static_cast<std::int64_t>(exact))
+            return false;
+    }
+
+    result = static_cast<double>(product);
+    return true;
+}
+
+
+/**
+ * @brief Folds an operation on constants when the compiler computes it exactly as execute does
+ * 
+ * Functions and powers other than those of power are left to run time, where they give the
+ * same result as the interpreter.
+ * 
+ * @param op operation
+ * @param first left or only operand
+ * @param second right operand
+ * @param result receives the folded value
+ * @return true the operation was folded
+ */
+constexpr bool fold(OpCode op, double first, double second, double &result)
+{
+    switch (op)
+    {
+        case OpCode::ADD:
+            result = first + second;
+            return true;
+        case OpCode::SUB:
+            result = first - second;
+            return true;
+        case OpCode::MUL:
+            result = first * second;
+            return true;
+        case OpCode::DIV:
+            result = first / second;
+            return true;
+        case OpCode::NEG:
+            result = -first;
+            return true;
+        case OpCode::POW:
+            return power(first, second, result);
+        default:
+            return false;
+    }
+}
+
+
+/**
+ * @brief Throws the message of an error, a compile error naming CODE when reached in a constant expression
+ * 
+ * @param expression expression the error was found in
+ * @param offset source offset of the error
+ * @param variable name of the unknown variable, if any
+ * @throws std::invalid_argument with the same message as EvaluateExpression::describe
+ */
+template <ErrorCode CODE>
+[[noreturn]] void raise(std::string_view expression, std::uint32_t offset, std::string_view variable)
+{
+    std::string message(ERROR_MESSAGES[static_cast<int>(CODE)]);
+
+    if ((CODE == ErrorCode::INVALID_OPERATOR_USE || CODE == ErrorCode::UNKNOWN_OPERATOR) && offset < expression.length())
+    {
+        std::size_t len = 1;
+
+        // a function is named in full
+        while (character(expression[offset]).kind == CharClass::LETTER && offset + len < expression.length() &&
+               character(expression[offset + len]).kind == CharClass::LETTER)
+            len++;
+
+        message += expression.substr(offset, len);
+        message.push_back('"');
+    }
+    else if (CODE == ErrorCode::INVALID_NUMBER && offset < expression.length())
+    {
+        std::size_t len = 1;
+
+        while (offset + len < expression.length() && character(expression[offset + len]).kind == CharClass::DIGIT)
+            len++;
+
+        message += expression.substr(offset, len);
+    }
+    else if (CODE == ErrorCode::UNKNOWN_VARIABLE && variable.length() > 0)
+    {
+        message += variable;
+        message.push_back('"');
+    }
+
+    throw std::invalid_argument(message);
+}
+
+
+// expression of at most N - 1 characters compiled into a fixed-size postfix program, a literal type
+// so calc::compile can build it in a constant expression
+template <std::size_t N>
+class StaticProgram
+{
+    public:
+        // most instructions and tokens N - 1 characters make, unary minus is the worst case with
+        // (-1 * x) and its closing parenthesis for a single character
+        static constexpr std::size_t CODE = 2 * N;
+        static constexpr std::size_t TOKENS = 4 * N;
+
+        constexpr Error compile(std::string_view);
+        constexpr Error execute(const double*, double&) const;
+        constexpr void check(const Error&) const;
+
+        template <typename... Values>
+        constexpr double operator()(Values...) const;
+
+        constexpr bool constant() const;
+        constexpr std::size_t size() const;
+        constexpr std::size_t stack_size() const;
+        constexpr const Instruction &operator[](std::size_t) const;
+        constexpr std::size_t variable_count() const;
+        constexpr std::string_view variable(std::size_t) const;
+        constexpr std::size_t slot(std::string_view) const;
+        Program program() const;
+
+    private:
+        // variable name as a part of source
+        struct Name
+        {
+            std::uint32_t offset;
+            std::uint32_t length;
+        };
+
+        constexpr Error get_tokens(FixedStack<Token, TOKENS>&);
+        constexpr Error shunting_yard(const FixedStack<Token, TOKENS>&);
+        constexpr void optimize();
+
+        char source[N] = {};
+        std::size_t length = 0;
+
+        FixedStack<Instruction, CODE> code;
+        std::size_t max_depth = 0;
+
+        Name names[N] = {};
+        std::size_t name_count = 0;
+};
+
+
+/**
+ * @brief Compiles an infix notation expression, at run time or in a constant expression
+ * 
+ * Same syntax, errors and offsets as EvaluateExpression::compile. Constants are folded where
+ * the compiler computes them exactly, repeated subexpressions are not shared.
+ * 
+ * @param expression infix notation expression of at most N - 1 characters
+ * @return Error first syntax error, INVALID_EXPRESSION for a longer expression
+ */
+template <std::size_t N>
+constexpr Error StaticProgram<N>::compile(std::string_view expression)
+{
+    if (expression.length() >= N)
+        return {ErrorCode::INVALID_EXPRESSION, static_cast<std::uint32_t>(N - 1)};
+
+    for (std::size_t i = 0; i < expression.length(); i++)
+        source[i] = expression[i];
+
+    length = expression.length();
+    name_count = 0;
+
+    FixedStack<Token, TOKENS> tokens;
+
+    if (Error error = get_tokens(tokens))
+        return error;
+
+    if (Error error = shunting_yard(tokens))
+        return error;
+
+    optimize();
+
+    return {};
+}
+
+
+/**
+ * @brief Parses the source into tokens, as EvaluateExpression::get_tokens
+ * 
+ * @param tokens receives the expression parsed into tokens
+ * @return Error first error found, if any
+ */
+template <std::size_t N>
+constexpr Error StaticProgram<N>::get_tokens(FixedStack<Token, TOKENS> &tokens)
+{
+    std::string_view expression(source, length);
+    Tokenizer<FixedStack<int, N + 1>> grammar;
+
+    for (std::size_t i = 0; i < expression.length(); i++)
+    {
+        CharClass kind = character(expression[i]).kind;
+
+        if (kind == CharClass::BLANK)
+            continue;
+
+        if (Error error = grammar.next(expression[i]))
+            return error;
+
+        if (kind != CharClass::DIGIT && kind != CharClass::LETTER)
+        {
+            if (Error error = grammar.symbol(expression[i], i, tokens))
+                return error;
+
+            continue;
+        }
+
+        std::size_t len = 1;
+
+        while (i + len < expression.length() && character(expression[i+len]).kind == kind)
+            len++;
+
+        std::string_view name = expression.substr(i, len);
+
+        // only the built in functions are known to the compiler
+        std::size_t function = 0;
+
+        while (kind == CharClass::LETTER && function < std::size(FUNCTIONS) && FUNCTIONS[function].name != name)
+            function++;
+
+        if (kind == CharClass::DIGIT)
+        {
+            double value = 0;
+
+            if (!read_number(name, value))
+                return {ErrorCode::INVALID_NUMBER, static_cast<std::uint32_t>(i)};
+
+            grammar.value({TokenKind::NUMBER, OpCode::PUSH, value, i}, i + len - 1, tokens);
+        }
+        else if (function < std::size(FUNCTIONS))
+        {
+            grammar.function({TokenKind::OPERATOR, FUNCTIONS[function].op, 0, i, FUNCTIONS[function].slot}, tokens);
+        }
+        else
+        {
+            // variables are numbered in order of first use
+            std::size_t slot = 0;
+
+            while (slot < name_count && variable(slot) != name)
+                slot++;
+
+            if (slot == name_count)
+                names[name_count++] = {static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(len)};
+
+            grammar.value({TokenKind::VARIABLE, OpCode::LOAD, 0, i, static_cast<std::uint32_t>(slot)}, i + len - 1, tokens);
+        }
+
+        i += len - 1;
+    }
+
+    // add final parenthesis and check for errors
+    return grammar.finish(expression.length(), tokens);
+}
+
+
+
+/**
+ * @brief Transforms infix notation tokens to postfix code, as EvaluateExpression::shunting_yard
+ * 
+ * @param tokens infix notation expression parsed into tokens
+ * @return Error first error found, if any
+ */
+template <std::size_t N>
+constexpr Error StaticProgram<N>::shunting_yard(const FixedStack<Token, TOKENS> &tokens)
+{
+    code.clear();
+    max_depth = 0;
+
+    ShuntingYard<FixedStack<Token, TOKENS>> operators;
+    std::size_t depth = 0;
+
+    auto output = [&](const Token &token) { return PostfixCode::emit(token, code, depth, max_depth); };
+
+    for (std::size_t i = 0; i < tokens.size(); i++)
+    {
+        if (Error error = operators.push(tokens[i], output))
+            return error;
+    }
+
+    if (Error error = operators.finish(output))
+        return error;
+
+    // check for extra operators
+    if (depth != 1)
+        return {ErrorCode::INVALID_EXPRESSION, static_cast<std::uint32_t>(tokens.size() == 0 ? 0 : tokens[tokens.size() - 1].offset)};
+
+    return {};
+}
+
+
+
+/**
+ * @brief Folds constants and removes redundant instructions, as EvaluateExpression::optimize
+ * 
+ * Only operations fold can compute are folded, the rewrites of (-1 * x), x * 1, x / 1, x ^ 1
+ * and x - 0 are the same.
+ */
+template <std::size_t N>
+constexpr void StaticProgram<N>::optimize()
+{
+    FixedStack<PostfixCode::Operand, CODE> operands;
+
+    // operations the compiler cannot compute exactly stay in the code
+    auto exact = [](const Instruction &instr, double first, double second, double &result)
+    {
+        return fold(instr.op, first, second, result);
+    };
+
+    PostfixCode::optimize(code, operands, exact, max_depth);
+}
+
+
+
+/**
+ * @brief Runs the program, in a constant expression too when it only needs arithmetic
+ * 
+ * @param variables one value per variable in order of first use, may be null without variables
+ * @param result receives the answer to expression
+ * @return Error division by zero, negative logarithm or a missing variable, if any
+ */
+template <std::size_t N>
+constexpr Error StaticProgram<N>::execute(const double *variables, double &result) const
+{
+    if (variables == nullptr && name_count > 0)
+        return {ErrorCode::UNKNOWN_VARIABLE, 0};
+
+    double values[CODE] = {};
+    std::size_t top = 0;
+
+    for (std::size_t i = 0; i < code.size(); i++)
+    {
+        const Instruction &instr = code[i];
+
+        switch (instr.op)
+        {
+            case OpCode::PUSH:
+                values[top++] = instr.value;
+                break;
+            case OpCode::LOAD:
+                values[top++] = variables[instr.slot];
+                break;
+            case OpCode::ADD:
+                values[top - 2] += values[top - 1];
+                top--;
+                break;
+            case OpCode::SUB:
+                values[top - 2] -= values[top - 1];
+                top--;
+                break;
+            case OpCode::MUL:
+                values[top - 2] *= values[top - 1];
+                top--;
+                break;
+            case OpCode::DIV:
+                if (values[top - 1] == 0)
+                    return {ErrorCode::DIVISION_BY_ZERO, instr.slot};
+
+                values[top - 2] /= values[top - 1];
+                top--;
+                break;
+            case OpCode::POW:
+                values[top - 2] = pow(values[top - 2], values[top - 1]);
+                top--;
+                break;
+            case OpCode::SIN:
+                values[top - 1] = sin(values[top - 1]);
+                break;
+            case OpCode::COS:
+                values[top - 1] = cos(values[top - 1]);
+                break;
+            case OpCode::TAN:
+                values[top - 1] = tan(values[top - 1]);
+                break;
+            case OpCode::COT:
+                values[top - 1] = 1 / tan(values[top - 1]);
+                break;
+            case OpCode::LOG:
+                if (values[top - 1] < 0)
+                    return {ErrorCode::NEGATIVE_LOGARITHM, instr.slot};
+
+                values[top - 1] = log10(values[top - 1]);
+                break;
+            case OpCode::LN:
+                if (values[top - 1] < 0)
+                    return {ErrorCode::NEGATIVE_LOGARITHM, instr.slot};
+
+                values[top - 1] = log(values[top - 1]);
+                break;
+            case OpCode::NEG:
+                values[top - 1] = -values[top - 1];
+                break;
+            case OpCode::CALL1:
+                values[top - 1] = OperatorRegistry::native(instr.slot)(values + top - 1);
+                break;
+            case OpCode::CALL2:
+                values[top - 2] = OperatorRegistry::native(instr.slot)(values + top - 2);
+                top--;
+                break;
+            default:
+                break;
+        }
+    }
+
+    result = values[0];
+
+    return {};
+}
+
+
+/**
+ * @brief Throws an error, which stops compilation instead when reached in a constant expression
+ * 
+ * The compiler names the failing raise<ErrorCode::...> in its diagnostic.
+ * 
+ * @param error error reported by compile or execute
+ * @throws std::invalid_argument with the error message
+ */
+template <std::size_t N>
+constexpr void StaticProgram<N>::check(const Error &error) const
+{
+    std::string_view expression(source, length);
+    std::string_view name = (error.offset < name_count) ? variable(error.offset) : std::string_view();
+
+    switch (error.code)
+    {
+        case ErrorCode::DIVISION_BY_ZERO:
+            raise<ErrorCode::DIVISION_BY_ZERO>(expression, error.offset, name);
+        case ErrorCode::NEGATIVE_LOGARITHM:
+            raise<ErrorCode::NEGATIVE_LOGARITHM>(expression, error.offset, name);
+        case ErrorCode::UNCLOSED_BRACKETS:
+            raise<ErrorCode::UNCLOSED_BRACKETS>(expression, error.offset, name);
+        case ErrorCode::EMPTY_BRACKETS:
+            raise<ErrorCode::EMPTY_BRACKETS>(expression, error.offset, name);
+        case ErrorCode::UNARY_OPERATOR:
+            raise<ErrorCode::UNARY_OPERATOR>(expression, error.offset, name);
+        case ErrorCode::INVALID_OPERATOR_USE:
+            raise<ErrorCode::INVALID_OPERATOR_USE>(expression, error.offset, name);
+        case ErrorCode::UNKNOWN_OPERATOR:
+            raise<ErrorCode::UNKNOWN_OPERATOR>(expression, error.offset, name);
+        case ErrorCode::INVALID_NUMBER:
+            raise<ErrorCode::INVALID_NUMBER>(expression, error.offset, name);
+        case ErrorCode::MISSING_VALUES:
+            raise<ErrorCode::MISSING_VALUES>(expression, error.offset, name);
+        case ErrorCode::INVALID_EXPRESSION:
+            raise<ErrorCode::INVALID_EXPRESSION>(expression, error.offset, name);
+        case ErrorCode::UNKNOWN_VARIABLE:
+            raise<ErrorCode::UNKNOWN_VARIABLE>(expression, error.offset, name);
+        default:
+            break;
+    }
+}
+
+
+/**
+ * @brief Runs the program with its variables bound in order of first use
+ * 
+ * @param values one value per variable
+ * @return double answer to expression
+ * @throws std::invalid_argument when the program fails or values are missing, a compile
+ *         error instead in a constant expression
+ */
+template <std::size_t N>
+template <typename... Values>
+constexpr double StaticProgram<N>::operator()(Values... values) const
+{
+    const double variables[] = {static_cast<double>(values)..., 0};
+    double result = 0;
+
+    if (sizeof...(Values) != name_count)
+        check({ErrorCode::UNKNOWN_VARIABLE, static_cast<std::uint32_t>(std::min(sizeof...(Values), name_count))});
+
+    check(execute(variables, result));
+
+    return result;
+}
+
+
+/**
+ * @brief Whether constant folding left a single number
+ * 
+ * @return true the program always gives the same result
+ */
+template <std::size_t N>
+constexpr bool StaticProgram<N>::constant() const
+{
+    return code.size() == 1 && code[0].op == OpCode::PUSH;
+}
+
+
+/**
+ * @brief Number of instructions
+ * 
+ * @return std::size_t program length
+ */
+template <std::size_t N>
+constexpr std::size_t StaticProgram<N>::size() const
+{
+    return code.size();
+}
+
+
+/**
+ * @brief Most values on the stack while the program runs
+ * 
+ * @return std::size_t stack size
+ */
+template <std::size_t N>
+constexpr std::size_t StaticProgram<N>::stack_size() const
+{
+    return max_depth;
+}
+
+
+/**
+ * @brief Instruction at a position
+ * 
+ * @param i position below size()
+ * @return const Instruction& instruction
+ */
+template <std::size_t N>
+constexpr const Instruction &StaticProgram<N>::operator[](std::size_t i) const
+{
+    return code[i];
+}
+
+
+/**
+ * @brief Number of distinct variables
+ * 
+ * @return std::size_t values operator() takes
+ */
+template <std::size_t N>
+constexpr std::size_t StaticProgram<N>::variable_count() const
+{
+    return name_count;
+}
+
+
+/**
+ * @brief Name of a variable
+ * 
+ * @param slot variable in order of first use
+ * @return std::string_view name, valid as long as the program
+ */
+template <std::size_t N>
+constexpr std::string_view StaticProgram<N>::variable(std::size_t slot) const
+{
+    return std::string_view(source + names[slot].offset, names[slot].length);
+}
+
+
+/**
+ * @brief Finds the slot of a variable, so values can be placed without knowing the order of first use
+ * 
+ * @param name variable name
+ * @return std::size_t slot, variable_count() when the formula does not use name
+ */
+template <std::size_t N>
+constexpr std::size_t StaticProgram<N>::slot(std::string_view name) const
+{
+    std::size_t slot = 0;
+
+    while (slot < name_count && variable(slot) != name)
+        slot++;
+
+    return slot;
+}
+
+
+/**
+ * @brief Copies the program for the interpreter, the array executor or JitProgram
+ * 
+ * @return Program same code and variables
+ */
+template <std::size_t N>
+Program StaticProgram<N>::program() const
+{
+    Program program;
+    program.code.assign(code.items, code.items + code.size());
+    program.stack_size = max_depth;
+
+    for (std::size_t slot = 0; slot < name_count; slot++)
+        program.variables.emplace_back(variable(slot));
+
+    return program;
+}
+
+
+/**
+ * @brief Compiles a string literal, in a constant expression when the result is constexpr
+ * 
+ * @param expression infix notation expression
+ * @return StaticProgram<N> compiled expression
+ * @throws std::invalid_argument for invalid expressions, a compile error in a constant expression
+ */
+template <std::size_t N>
+constexpr StaticProgram<N> compile(const char (&expression)[N])
+{
+    StaticProgram<N> program;
+    program.check(program.compile(std::string_view(expression, N - 1)));
+
+    return program;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,371 @@
+#include "stats.h"
+#include <mutex>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+// names printed for every stage and error code
+const char *STAGE_NAMES[] = {"tokenize", "shunting_yard", "optimize", "execute", "evaluate"};
+const char *ERROR_NAMES[] = {"none", "division by zero", "negative logarithm", "unclosed brackets", "empty brackets",
+                             "invalid use of unary operator", "invalid use of operator", "unknown operator",
+                             "invalid number", "insufficient number of values", "invalid expression", "unknown variable",
+                             "circular reference"};
+
+// one in this many stages is timed, so the clock is rarely read
+const unsigned SAMPLE_EVERY = 8;
+
+// percentiles shown for every histogram
+const double PERCENTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+// precision kept by Histogram
+const int SUB_BUCKET_BITS = 4;
+const std::uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+// time statistics are counted from
+const std::chrono::steady_clock::time_point START = std::chrono::steady_clock::now();
+
+
+// counters of every running thread, plus totals of threads that have exited
+struct Stats::Registry
+{
+    std::mutex mutex;
+    std::vector<const Counters*> live;
+    StatsSnapshot retired;
+};
+
+
+/**
+ * @brief Shared registry, created on first use
+ * 
+ * @return Registry& registry
+ */
+Stats::Registry &Stats::registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+
+/**
+ * @brief Finds the bucket of a value
+ * 
+ * @param value recorded value
+ * @return std::size_t bucket index
+ */
+std::size_t Histogram::bucket(std::uint64_t value)
+{
+    if (value < SUB_BUCKETS)
+        return value;
+
+    int exponent = 63 - __builtin_clzll(value);
+
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + ((value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+}
+
+
+/**
+ * @brief Largest value that falls into a bucket
+ * 
+ * @param index bucket index
+ * @return std::uint64_t largest value of the bucket
+ */
+std::uint64_t Histogram::highest(std::size_t index)
+{
+    if (index < SUB_BUCKETS)
+        return index;
+
+    int shift = index / SUB_BUCKETS - 1;
+    std::uint64_t lowest = (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+
+    return lowest + ((std::uint64_t(1) << shift) - 1);
+}
+
+
+/**
+ * @brief Adds a value to a histogram owned by the calling thread
+ * 
+ * @param value recorded value
+ */
+void Histogram::record(std::uint64_t value)
+{
+    counts[bucket(value)]++;
+    total++;
+    sum += value;
+    max = std::max(max, value);
+}
+
+
+/**
+ * @brief Value below or at which the given share of recorded values falls
+ * 
+ * @param share share between 0 and 1
+ * @return std::uint64_t value, zero for an empty histogram
+ */
+std::uint64_t Histogram::percentile(double share) const
+{
+    std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(share * total + 0.5));
+    std::uint64_t seen = 0;
+
+    for (std::size_t i = 0; i < BUCKETS && total > 0; i++)
+    {
+        seen += counts[i];
+
+        if (seen >= rank)
+            return std::min(highest(i), max);
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Starts timing a stage if it is sampled
+ * 
+ * @return std::uint64_t current time, or zero when this stage is not timed
+ */
+std::uint64_t Stats::start()
+{
+    thread_local unsigned tick = 0;
+
+    return (++tick % SAMPLE_EVERY == 0) ? now() : 0;
+}
+
+
+/**
+ * @brief Current time for lap timing
+ * 
+ * @return std::uint64_t nanoseconds on the steady clock
+ */
+std::uint64_t Stats::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/**
+ * @brief Counts a finished stage and records its time if it was sampled
+ * 
+ * @param stage finished stage
+ * @param start time the stage began, zero when it is not timed
+ * @return std::uint64_t current time, where the next stage begins, or zero when not timed
+ */
+std::uint64_t Stats::lap(Stage stage, std::uint64_t start)
+{
+    Counters &counters = local();
+    std::atomic<std::uint64_t> &calls = counters.calls[static_cast<std::size_t>(stage)];
+    calls.store(calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if (start == 0)
+        return 0;
+
+    std::uint64_t end = now();
+    counters.record(static_cast<std::size_t>(stage), end - start);
+
+    return end;
+}
+
+
+/**
+ * @brief Records the number of tokens of an expression
+ * 
+ * @param count number of tokens
+ */
+void Stats::tokens(std::size_t count)
+{
+    local().record(static_cast<std::size_t>(Stage::COUNT), count);
+}
+
+
+/**
+ * @brief Counts an error by its code
+ * 
+ * @param code error code
+ */
+void Stats::error(ErrorCode code)
+{
+    std::atomic<std::uint64_t> &counter = local().errors[static_cast<std::size_t>(code)];
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+
+/**
+ * @brief Adds a value to one histogram, only the owning thread writes so no locked instructions are needed
+ * 
+ * @param histogram stage index, or Stage::COUNT for token counts
+ * @param value recorded value
+ */
+void Stats::Counters::record(std::size_t histogram, std::uint64_t value)
+{
+    std::atomic<std::uint64_t> &count = buckets[histogram][Histogram::bucket(value)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    sums[histogram].store(sums[histogram].load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+
+    if (value > maxima[histogram].load(std::memory_order_relaxed))
+        maxima[histogram].store(value, std::memory_order_relaxed);
+}
+
+
+/**
+ * @brief Adds these counters to a snapshot
+ * 
+ * @param snapshot totals being summed
+ */
+void Stats::Counters::add_to(StatsSnapshot &snapshot) const
+{
+    for (std::size_t h = 0; h < HISTOGRAMS; h++)
+    {
+        Histogram &histogram = (h < snapshot.stages.size()) ? snapshot.stages[h] : snapshot.tokens;
+
+        for (std::size_t i = 0; i < Histogram::BUCKETS; i++)
+        {
+            std::uint64_t count = buckets[h][i].load(std::memory_order_relaxed);
+
+            histogram.counts[i] += count;
+            histogram.total += count;
+        }
+
+        histogram.sum += sums[h].load(std::memory_order_relaxed);
+        histogram.max = std::max(histogram.max, maxima[h].load(std::memory_order_relaxed));
+    }
+
+    for (std::size_t stage = 0; stage < snapshot.calls.size(); stage++)
+        snapshot.calls[stage] += calls[stage].load(std::memory_order_relaxed);
+
+    for (std::size_t kind = 0; kind < snapshot.errors.size(); kind++)
+        snapshot.errors[kind] += errors[kind].load(std::memory_order_relaxed);
+}
+
+
+/**
+ * @brief Registers the counters of the calling thread
+ */
+Stats::Local::Local()
+{
+    Registry &shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+
+    shared.live.push_back(&counters);
+}
+
+
+/**
+ * @brief Keeps the counters of an exiting thread in the registry totals
+ */
+Stats::Local::~Local()
+{
+    Registry &shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+
+    counters.add_to(shared.retired);
+    shared.live.erase(std::find(shared.live.begin(), shared.live.end(), &counters));
+}
+
+
+/**
+ * @brief Counters of the calling thread, registered on first use
+ * 
+ * @return Counters& counters
+ */
+Stats::Counters &Stats::local()
+{
+    thread_local Local instance;
+    return instance.counters;
+}
+
+
+/**
+ * @brief Sums the counters of every thread
+ * 
+ * @return StatsSnapshot totals since the program started
+ */
+StatsSnapshot Stats::snapshot()
+{
+    Registry &shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+
+    StatsSnapshot snapshot = shared.retired;
+
+    for (const Counters *counters : shared.live)
+        counters->add_to(snapshot);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - START;
+    snapshot.seconds = elapsed.count();
+
+    return snapshot;
+}
+
+
+/**
+ * @brief Prints stage latencies, token counts and error counts
+ * 
+ * @param out stream the statistics are written to
+ */
+void Stats::print(std::ostream &out)
+{
+#if CALC_STATS
+    StatsSnapshot totals = snapshot();
+
+    // one line per histogram: count, mean, percentiles and maximum
+    auto line = [&out](const Histogram &histogram, const char *unit)
+    {
+        if (histogram.total > 0)
+        {
+            out << ", mean " << histogram.sum / histogram.total << unit;
+
+            for (double share : PERCENTILES)
+                out << ", p" << share * 100 << " " << histogram.percentile(share) << unit;
+
+            out << ", max " << histogram.max << unit;
+        }
+
+        out << std::endl;
+    };
+
+    std::uint64_t evaluated = totals.calls[static_cast<std::size_t>(Stage::EVALUATE)];
+
+    out << "Statistics after " << totals.seconds << " s:" << std::endl;
+    out << "\t" << evaluated << " expressions, " << evaluated / totals.seconds << " per second" << std::endl;
+
+    out << "\n\tLatency (calls, timed calls, nanoseconds):" << std::endl;
+
+    for (std::size_t stage = 0; stage < totals.stages.size(); stage++)
+    {
+        out << "\t" << STAGE_NAMES[stage] << ": " << totals.calls[stage] << ", " << totals.stages[stage].total;
+        line(totals.stages[stage], " ns");
+    }
+
+    out << "\n\tTokens per expression:" << std::endl;
+    out << "\ttokens: " << totals.tokens.total;
+    line(totals.tokens, "");
+
+    out << "\n\tErrors:" << std::endl;
+
+    for (std::size_t kind = 0; kind < totals.errors.size(); kind++)
+    {
+        if (totals.errors[kind] > 0)
+            out << "\t" << ERROR_NAMES[kind] << ": " << totals.errors[kind] << std::endl;
+    }
+#else
+    out << "Statistics are not available, this build has CALC_STATS=0." << std::endl;
+#endif
+}
+
+
+/**
+ * @brief Writes statistics to a file
+ * 
+ * @param path statistics file
+ * @return true file was written
+ * @return false file could not be opened
+ */
+bool Stats::dump(const std::string &path)
+{
+    std::ofstream file(path);
+
+    if (!file)
+        return false;
+
+    print(file);
+    return true;
+}
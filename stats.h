@@ -0,0 +1,109 @@
+#pragma once
+
+#include "evaluate_expression.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+// instrumentation is built in unless compiled with -DCALC_STATS=0
+#ifndef CALC_STATS
+#define CALC_STATS 1
+#endif
+
+#if CALC_STATS
+#define STATS_START(name) std::uint64_t name = Stats::start()
+#define STATS_LAP(name, stage) name = Stats::lap(Stage::stage, name)
+#define STATS_TOKENS(count) Stats::tokens(count)
+#define STATS_ERROR(code) Stats::error(code)
+#else
+// expressions rather than nothing, so an if with a disabled macro as its body has no empty body
+#define STATS_START(name) ((void)0)
+#define STATS_LAP(name, stage) ((void)0)
+#define STATS_TOKENS(count) ((void)0)
+#define STATS_ERROR(code) ((void)0)
+#endif
+
+
+// timed parts of an evaluation, EVALUATE covers a whole expression from text to result
+enum class Stage
+{
+    TOKENIZE, SHUNTING_YARD, OPTIMIZE, EXECUTE, EVALUATE, COUNT
+};
+
+
+// log-linear histogram with 16 sub-buckets per power of two, so values are kept within about 6%
+struct Histogram
+{
+    static const std::size_t BUCKETS = 976;
+
+    std::array<std::uint64_t, BUCKETS> counts = {};
+    std::uint64_t total = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+
+    static std::size_t bucket(std::uint64_t);
+    static std::uint64_t highest(std::size_t);
+
+    void record(std::uint64_t);
+    std::uint64_t percentile(double) const;
+};
+
+
+// counters summed over every thread, stage histograms only hold the sampled calls
+struct StatsSnapshot
+{
+    std::array<std::uint64_t, static_cast<std::size_t>(Stage::COUNT)> calls = {};
+    std::array<Histogram, static_cast<std::size_t>(Stage::COUNT)> stages;
+    Histogram tokens;
+    std::array<std::uint64_t, static_cast<std::size_t>(ErrorCode::COUNT)> errors = {};
+    double seconds = 0;
+};
+
+
+class Stats
+{
+    public:
+        static std::uint64_t start();
+        static std::uint64_t now();
+        static std::uint64_t lap(Stage, std::uint64_t);
+        static void tokens(std::size_t);
+        static void error(ErrorCode);
+
+        static StatsSnapshot snapshot();
+        static void print(std::ostream&);
+        static bool dump(const std::string&);
+
+    private:
+        // histograms written by one thread without locking and read by snapshot
+        struct Counters
+        {
+            static const std::size_t HISTOGRAMS = static_cast<std::size_t>(Stage::COUNT) + 1;
+
+            std::atomic<std::uint64_t> calls[static_cast<std::size_t>(Stage::COUNT)] = {};
+            std::atomic<std::uint64_t> buckets[HISTOGRAMS][Histogram::BUCKETS] = {};
+            std::atomic<std::uint64_t> sums[HISTOGRAMS] = {};
+            std::atomic<std::uint64_t> maxima[HISTOGRAMS] = {};
+            std::atomic<std::uint64_t> errors[static_cast<std::size_t>(ErrorCode::COUNT)] = {};
+
+            void record(std::size_t, std::uint64_t);
+            void add_to(StatsSnapshot&) const;
+        };
+
+        // registers the counters of a thread while it runs and keeps them after it exits
+        struct Local
+        {
+            Local();
+            ~Local();
+
+            Counters counters;
+        };
+
+        struct Registry;
+
+        static Counters &local();
+        static Registry &registry();
+};
@@ -0,0 +1,346 @@
+#include "stream_parser.h"
+#include "operator_registry.h"
+#include "stats.h"
+
+
+/**
+ * @brief Creates a parser waiting for the first chunk of an expression
+ */
+StreamParser::StreamParser()
+{
+    reset();
+}
+
+
+/**
+ * @brief Starts a new expression, keeping the memory of the previous one
+ */
+void StreamParser::reset()
+{
+    consumed = 0;
+
+    grammar.reset();
+
+    // nothing before the first token, no bracket to multiply and no function waiting for operands
+    last = {TokenKind::SEPARATOR, OpCode::PUSH, 0, 0};
+    pending.clear();
+
+    operators.reset();
+    values.clear();
+
+    tokenizer = {};
+    syntax = {};
+    runtime = {};
+
+    text.clear();
+    variable.clear();
+}
+
+
+/**
+ * @brief Tokenizes, converts and computes the next part of the expression
+ * 
+ * A number or name that reaches the end of the chunk is kept until the next chunk or finish
+ * shows where it ends. Only tokenizer errors are returned here, since a later one would
+ * still replace syntax and runtime errors.
+ * 
+ * @param chunk next part of the expression, any length and split anywhere
+ * @return Error first tokenizer error, the rest of the expression is ignored after it
+ */
+Error StreamParser::feed(std::string_view chunk)
+{
+    if (tokenizer)
+        return tokenizer;
+
+    std::size_t i = 0;
+
+    // continue the number or name the previous chunk ended in
+    if (!pending.empty())
+    {
+        CharClass kind = pending_number ? CharClass::DIGIT : CharClass::LETTER;
+
+        while (i < chunk.length() && character(chunk[i]).kind == kind)
+            i++;
+
+        pending.append(chunk.data(), i);
+
+        if (i == chunk.length())
+        {
+            consumed += chunk.length();
+            return {};
+        }
+
+        if (Error error = word(pending, pending_offset))
+            return fail(error, pending);
+
+        pending.clear();
+    }
+
+    Sink sink = {*this};
+
+    for (; i < chunk.length(); i++)
+    {
+        CharClass kind = character(chunk[i]).kind;
+
+        // check for blank space
+        if (kind == CharClass::BLANK)
+            continue;
+
+        std::size_t offset = consumed + i;
+
+        if (Error error = grammar.next(chunk[i]))
+            return fail(error, OperatorRegistry::function(last.slot).name);
+
+        if (kind == CharClass::DIGIT || kind == CharClass::LETTER)
+        {
+            std::size_t len = 1;
+
+            // get length of number or name
+            while (i + len < chunk.length() && character(chunk[i+len]).kind == kind)
+                len++;
+
+            // the next chunk may continue it
+            if (i + len == chunk.length())
+            {
+                pending.assign(chunk.substr(i));
+                pending_offset = offset;
+                pending_number = kind == CharClass::DIGIT;
+                break;
+            }
+
+            if (Error error = word(chunk.substr(i, len), offset))
+                return fail(error, chunk.substr(i, len));
+
+            i += len - 1;
+        }
+        else if (Error error = grammar.symbol(chunk[i], offset, sink))
+        {
+            return fail(error, chunk.substr(i, 1));
+        }
+    }
+
+    consumed += chunk.length();
+
+    return {};
+}
+
+
+/**
+ * @brief Ends the expression and computes its value
+ * 
+ * @param result receives the answer to expression
+ * @return Error the error compile or execute would report for the whole expression, if any
+ */
+Error StreamParser::finish(double &result)
+{
+    if (tokenizer)
+        return tokenizer;
+
+    // number or name at the very end
+    if (!pending.empty())
+    {
+        if (Error error = word(pending, pending_offset))
+            return fail(error, pending);
+
+        pending.clear();
+    }
+
+    // add final parenthesis and check for errors
+    Sink sink = {*this};
+
+    if (Error error = grammar.finish(consumed, sink))
+        return fail(error, {});
+
+    // apply the operators still waiting
+    auto output = [this](const Token &token) { return reduce(token); };
+
+    if (!syntax)
+        syntax = operators.finish(output);
+
+    // check for extra operators
+    if (!syntax && values.size() != 1)
+        syntax = {ErrorCode::INVALID_EXPRESSION, static_cast<std::uint32_t>(last.offset)};
+
+    if (syntax)
+        return syntax;
+
+    // an expression without bindings cannot read its variables
+    if (!variable.empty())
+        return {ErrorCode::UNKNOWN_VARIABLE, 0};
+
+    if (runtime)
+        return runtime;
+
+    result = values.back();
+
+    return {};
+}
+
+
+/**
+ * @brief Ends the expression and appends its result or error message to out, as EvaluateExpression::evaluate
+ * 
+ * @param out text the result is appended to
+ * @param options notation and precision of the result
+ * @return Error error the message describes, if any
+ */
+Error StreamParser::finish(std::string &out, const FormatOptions &options)
+{
+    double result;
+    Error error = finish(result);
+
+    if (error)
+    {
+        STATS_ERROR(error.code);
+
+        out += "error: ";
+        describe(error, out);
+    }
+    else
+    {
+        EvaluateExpression::format(result, options, out);
+    }
+
+    return error;
+}
+
+
+/**
+ * @brief Appends the message of an error, naming the offending operator, number or variable
+ * 
+ * @param error error reported by feed or finish
+ * @param out text the message is appended to
+ */
+void StreamParser::describe(const Error &error, std::string &out) const
+{
+    // the text named by the message was kept when the error was found, the only variable named is the first
+    Program program;
+
+    if (!variable.empty())
+        program.variables.push_back(variable);
+
+    EvaluateExpression::describe({error.code, 0}, text, program, out);
+}
+
+
+/**
+ * @brief Handles a whole number, function or variable name
+ * 
+ * @param word digits and dots, or letters and underscores
+ * @param offset position of the word in the expression
+ * @return Error invalid number, if any
+ */
+Error StreamParser::word(std::string_view word, std::size_t offset)
+{
+    Sink sink = {*this};
+    std::size_t end = offset + word.length() - 1;
+
+    // check for number
+    if (character(word[0]).kind == CharClass::DIGIT)
+    {
+        // ensure number is valid and parse it once
+        double value;
+        std::from_chars_result parsed = std::from_chars(word.data(), word.data() + word.length(), value);
+
+        if (parsed.ec != std::errc() || parsed.ptr != word.data() + word.length())
+            return {ErrorCode::INVALID_NUMBER, static_cast<std::uint32_t>(offset)};
+
+        grammar.value({TokenKind::NUMBER, OpCode::PUSH, value, offset}, end, sink);
+    }
+    // check for function
+    else if (const FunctionEntry *function = OperatorRegistry::find(word))
+    {
+        grammar.function({TokenKind::OPERATOR, function->op, 0, offset, function->slot}, sink);
+    }
+    // variable, which has no value here
+    else
+    {
+        if (variable.empty())
+            variable = word;
+
+        grammar.value({TokenKind::VARIABLE, OpCode::LOAD, 0, offset}, end, sink);
+    }
+
+    return {};
+}
+
+
+/**
+ * @brief Takes the next token through one step of the Shunting Yard algorithm
+ * 
+ * @param token next token of the expression
+ */
+void StreamParser::push(const Token &token)
+{
+    last = token;
+
+    auto output = [this](const Token &reduced) { return reduce(reduced); };
+
+    // the tokenizer keeps looking for errors that would replace this one
+    if (!syntax)
+        syntax = operators.push(token, output);
+}
+
+
+/**
+ * @brief Pushes a value or applies an operator to the values on top, as emit followed by run
+ * 
+ * Without variables every value is a constant, so the compiled program would be folded into one
+ * number by the same operations. The first division by zero or negative logarithm is kept and
+ * the values go on, since only a later syntax error could still replace it.
+ * 
+ * @param token number, variable or operator token
+ * @return Error missing operands or an unclosed bracket, if any
+ */
+Error StreamParser::reduce(const Token &token)
+{
+    if (token.kind == TokenKind::NUMBER || token.kind == TokenKind::VARIABLE)
+    {
+        values.push_back(token.value);
+        return {};
+    }
+
+    if (token.kind != TokenKind::OPERATOR)
+        return {ErrorCode::UNCLOSED_BRACKETS, static_cast<std::uint32_t>(token.offset)};
+
+    std::size_t takes = OPERATORS[static_cast<int>(token.op)].arity;
+
+    if (values.size() < takes)
+        return {ErrorCode::MISSING_VALUES, static_cast<std::uint32_t>(token.offset)};
+
+    double second = 0;
+
+    if (takes == 2)
+    {
+        second = values.back();
+        values.pop_back();
+    }
+
+    double &first = values.back();
+    std::uint32_t offset = static_cast<std::uint32_t>(token.offset);
+
+    if (!runtime && token.op == OpCode::DIV && second == 0)
+        runtime = {ErrorCode::DIVISION_BY_ZERO, offset};
+    else if (!runtime && (token.op == OpCode::LOG || token.op == OpCode::LN) && first < 0)
+        runtime = {ErrorCode::NEGATIVE_LOGARITHM, offset};
+
+    first = EvaluateExpression::fold({token.op, token.slot, 0}, first, second);
+
+    return {};
+}
+
+
+/**
+ * @brief Keeps a tokenizer error and the text its message names
+ * 
+ * @param error tokenizer error
+ * @param offending text at the error, a function name, number or single character
+ * @return Error the error
+ */
+Error StreamParser::fail(const Error &error, std::string_view offending)
+{
+    tokenizer = error;
+    text = offending;
+
+    return error;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "evaluate_expression.h"
+#include "grammar.h"
+#include <cstdint>
+
+
+// expression evaluated while it is read, for inputs too large to hold in memory. Every chunk is
+// tokenized, converted by the Shunting Yard algorithm and computed in the same pass, an operator is
+// applied as soon as it is reduced. Only the operators and values of the open nesting levels are
+// kept, plus the number or name split by a chunk boundary, so memory grows with the nesting depth
+// rather than the length. Text and results are the same as EvaluateExpression::evaluate, errors
+// included: a later syntax error still wins over an earlier division by zero
+class StreamParser
+{
+    public:
+        StreamParser();
+
+        void reset();
+        Error feed(std::string_view);
+        Error finish(double&);
+        Error finish(std::string&, const FormatOptions& = FormatOptions());
+        void describe(const Error&, std::string&) const;
+
+    private:
+        // receives the tokens of the grammar and computes them
+        struct Sink
+        {
+            StreamParser &parser;
+
+            void push_back(const Token &token) { parser.push(token); }
+        };
+
+        Error word(std::string_view, std::size_t);
+        void push(const Token&);
+        Error reduce(const Token&);
+        Error fail(const Error&, std::string_view);
+
+        // position of the next chunk in the whole expression
+        std::size_t consumed = 0;
+
+        // tokenizer state between chunks, last token pushed and the number or name split by the previous chunk
+        Tokenizer<std::vector<int>> grammar;
+        Token last;
+        std::string pending;
+        std::size_t pending_offset = 0;
+        bool pending_number = false;
+
+        // operators waiting for their right operand and values of the open subexpressions
+        ShuntingYard<std::vector<Token>> operators;
+        std::vector<double> values;
+
+        // first error of every kind, reported in the order compile and execute would find them
+        Error tokenizer;
+        Error syntax;
+        Error runtime;
+
+        // text an error message names and the first variable, which has no value
+        std::string text;
+        std::string variable;
+};
\ No newline at end of file
@@ -0,0 +1,1386 @@
+#include "evaluate_expression.h"
+#include "evaluation_context.h"
+#include "expression_generator.h"
+#include "batch_input.h"
+#include "formula_graph.h"
+#include "jit_program.h"
+#include "operator_registry.h"
+#include "parallel_program.h"
+#include "pipeline.h"
+#include "program_store.h"
+#include "result_cache.h"
+#include "static_program.h"
+#include "stream_parser.h"
+#include "vector_math.h"
+#include <map>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <random>
+#include <new>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <stdexcept>
+#include <fstream>
+#include <tuple>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+// random expressions in the JIT differential test
+const int JIT_CORPUS = 20000;
+
+// nesting of the expression too deep for the native stack frame
+const std::size_t JIT_DEPTH = 2000000;
+
+// expressions compiled and executed again once their buffers are warm, and how often
+const std::vector<std::string> STEADY_EXPRESSIONS = {"3 + 4 * 2 / (1 - 5)^(2^3)", "sin(1)^2 + 2", "(-sin 1 + 1) (1 / -cos 1)",
+                                                     "--(--(log(--4)--(1)))", "max(x, sqrt(abs(y))) * rate - x / 2",
+                                                     "1 / (2 - 2)"};
+const int STEADY_ITERATIONS = 1000;
+
+// token counts of the scaling inputs, and most growth of the compile time per token from the smallest to the largest.
+// Linear parsing stays near one, a quadratic stage would grow a hundredfold
+const std::vector<std::size_t> SCALING_SIZES = {10000, 100000, 1000000};
+const double SCALING_GROWTH = 4;
+
+// expressions whose cache keys must stay apart, each next to one that differs only by spaces
+const std::vector<std::string> CACHE_EXPRESSIONS = {"x_y", "x _y", "x_ y", "rate_2", "rate _2", "1_x", "1 _x", "01.50 + 2", "1.5+2"};
+
+// function names written together read as one variable name, functions chain only when separated
+const std::vector<std::pair<std::string, std::string>> CHAINED_FUNCTIONS = {
+    {"loglog0", "error: invalid expression"}, {"loglog", "error: invalid expression: unknown variable \"loglog\""},
+    {"sincos1", "error: invalid expression"}, {"log log 10", "0.000000"}, {"log(log 10)", "0.000000"},
+    {"sin cos 0", "0.841471"}, {"sin(cos(0))", "0.841471"}};
+
+// sines in a subexpression too costly for one task, terms that each read it, terms that nest it in another
+// shared subexpression, and pool sizes the results must not depend on
+const int SHARED_SINES = 1000;
+const int SHARED_TERMS = 2000;
+const int NESTED_TERMS = 200;
+const std::vector<std::size_t> PARALLEL_THREADS = {1, 2, 4};
+
+// threads submitting to one pool at once, and tasks each of them submits
+const int POOL_PRODUCERS = 4;
+const int POOL_TASKS = 20000;
+
+// malformed and failing expressions with the error, source offset and message they must report
+const std::vector<std::tuple<std::string, ErrorCode, std::uint32_t, std::string>> ERROR_CASES = {
+    {"(1+2", ErrorCode::UNCLOSED_BRACKETS, 4, "invalid expression: unclosed brackets"},
+    {"1+2)", ErrorCode::UNCLOSED_BRACKETS, 3, "invalid expression: unclosed brackets"},
+    {"{1+2)", ErrorCode::UNCLOSED_BRACKETS, 4, "invalid expression: unclosed brackets"},
+    {"()", ErrorCode::EMPTY_BRACKETS, 1, "invalid expression: empty brackets"},
+    {"1 / (2 - 2)", ErrorCode::DIVISION_BY_ZERO, 2, "invalid expression: division by zero"},
+    {"log(1-3)", ErrorCode::NEGATIVE_LOGARITHM, 0, "invalid expression: negative logarithm"},
+    {"1 - -", ErrorCode::UNARY_OPERATOR, 5, "invalid expression: invalid use of unary operator"},
+    {"1 * / 2", ErrorCode::INVALID_OPERATOR_USE, 4, "invalid expression: invalid use of \"/\""},
+    {"1 $ 3", ErrorCode::UNKNOWN_OPERATOR, 2, "invalid expression: unknown operator \"$\""},
+    {"max(1,2,3)", ErrorCode::UNKNOWN_OPERATOR, 7, "invalid expression: unknown operator \",\""},
+    {"1 + 1.2.3", ErrorCode::INVALID_NUMBER, 4, "invalid number: 1.2.3"},
+    {"max(1)", ErrorCode::MISSING_VALUES, 5, "invalid expression: insufficient number of values for operator"},
+    {"1 4", ErrorCode::INVALID_EXPRESSION, 2, "invalid expression"},
+    {"1 + z", ErrorCode::UNKNOWN_VARIABLE, 0, "invalid expression: unknown variable \"z\""},
+    {"3 + 4 * 2 / (1 - 5)^(2^3)", ErrorCode::NONE, 0, "3.000122"}};
+
+// defects appended to generated expressions, and how many are checked against the throwing interface
+const std::vector<std::string> DEFECTS = {" / (2 - 2)", " + log(1 - 3)", " * (1 + 2", " + ()", " - -", " * / 2",
+                                          " $ 3", " + 1.2.3", " + sin", " 4", " + z"};
+const int ERROR_CORPUS = 5000;
+
+// lines streamed through the pipeline, enough for many batches
+const int PIPELINE_LINES = 100000;
+
+// formulas in the store test, every tenth with a syntax error
+const int STORE_FORMULAS = 2000;
+
+// natives registered on top of the built in functions
+const int REGISTRY_NATIVES = 300;
+
+// generated expressions streamed in chunks of 1 to STREAM_CHUNK bytes, a third of them malformed
+const int STREAM_CORPUS = 6000;
+const int STREAM_CHUNK = 7;
+
+// functions of two, empty and mismatched brackets and names split by any chunk boundary
+const std::vector<std::string> STREAM_CASES = {"max(1, 2) + min{3,4}", "max (1) (2)", "max(1 2)", "max(,1)", "min(1,)",
+                                               "max 1", "sqrt(abs(-4)) * exp 0", "2^-1^2", "(1)(2){3}", "{(1})",
+                                               "1 + 2)", "  ", "", "-", "--1", "1 - - -2", "1..2", ".5 + 5.",
+                                               "ln 0", "sinx", "x_1 + 1", "1 / 0 + (", "log(-1) $", "1e5"};
+
+// expressions compiled into a StaticProgram at run time and compared with the runtime compiler
+const int STATIC_CORPUS = 5000;
+const std::size_t STATIC_LENGTH = 512;
+
+// arguments per input range in the accuracy check of the vector kernels
+const std::size_t SIMD_SAMPLES = 20000;
+
+// heap allocations made by the process
+std::atomic<std::size_t> allocations{0};
+
+// the counting operators stay out of line, GCC warns about a mismatch where it inlines only one of a pair
+#define OUT_OF_LINE __attribute__((noinline))
+
+
+/**
+ * @brief Counts heap allocations
+ * 
+ * @param size bytes requested
+ * @return void* allocated memory
+ */
+OUT_OF_LINE void *operator new(std::size_t size)
+{
+    allocations++;
+
+    if (void *ptr = std::malloc(size))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+
+/**
+ * @brief Releases memory from the counting operator new
+ * 
+ * @param ptr allocated memory
+ */
+OUT_OF_LINE void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+
+/**
+ * @brief Releases memory from the counting operator new
+ * 
+ * @param ptr allocated memory
+ */
+OUT_OF_LINE void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+
+class Tests
+{
+    public:
+        static void jit();
+        static void allocations();
+        static void scaling();
+        static void simd();
+        static void cache();
+        static void chaining();
+        static void parallel();
+        static void pool();
+        static void errors();
+        static void formulas();
+        static void pipeline();
+        static void store();
+        static void registry();
+        static void stream();
+        static void static_programs();
+
+        static std::size_t failures;
+
+    private:
+        static std::string outcome(const JitProgram*, const Program&, const double*);
+        static std::string shaped(const std::string&, std::size_t);
+        static double ulps(double, long double);
+        static std::string letters(std::size_t);
+        static std::string temporary(const std::string&);
+        static void expect(bool, const std::string&);
+};
+
+
+std::size_t Tests::failures = 0;
+
+
+/**
+ * @brief Counts and prints a failed check
+ * 
+ * @param passed result of the check
+ * @param what description of the check, printed when it failed
+ */
+void Tests::expect(bool passed, const std::string &what)
+{
+    if (passed)
+        return;
+
+    failures++;
+    std::cout << "\tfailed: " << what << std::endl;
+}
+
+
+/**
+ * @brief Runs native code or the interpreter and describes the result exactly
+ * 
+ * @param jit native program, null for the interpreter
+ * @param program compiled expression
+ * @param variables values of x and y
+ * @return std::string result bits or error message
+ */
+std::string Tests::outcome(const JitProgram *jit, const Program &program, const double *variables)
+{
+    double result;
+    Error error = jit ? jit->execute(variables, result) : EvaluateExpression::execute(program, variables, result);
+
+    if (error)
+    {
+        std::string message;
+        EvaluateExpression::describe(error, {}, program, message);
+
+        return message + " at " + std::to_string(error.offset);
+    }
+
+    // every NaN counts as the same result
+    if (result != result)
+        return "nan";
+
+    std::uint64_t bits;
+    std::memcpy(&bits, &result, sizeof(bits));
+
+    return std::to_string(bits);
+}
+
+
+/**
+ * @brief Builds an expression of about the given number of tokens
+ * 
+ * @param shape "flat" for a long generated sum, "nested" for (x+(x+(...))), "unary" for x+-(x+-(...))
+ * @param tokens approximate number of tokens
+ * @return std::string expression over x and y
+ */
+std::string Tests::shaped(const std::string &shape, std::size_t tokens)
+{
+    std::string expression;
+
+    if (shape == "flat")
+    {
+        GeneratorConfig config;
+        config.terms = tokens * 2 / 5;
+        config.function_share = 0;
+        config.bracket_share = 0;
+        config.power_share = 0;
+        config.variables = true;
+
+        ExpressionGenerator(config).next(expression);
+    }
+    else
+    {
+        // every level adds four tokens, unary minus adds the (-1 * ...) around it on top
+        std::size_t levels = tokens / 4;
+        const char *open = (shape == "nested") ? "(x+" : "x+-(";
+
+        for (std::size_t i = 0; i < levels; i++)
+            expression += open;
+
+        expression += "y";
+        expression.append(levels, ')');
+    }
+
+    return expression;
+}
+
+
+/**
+ * @brief Error of a result in units in the last place of the exact value
+ * 
+ * @param value computed result
+ * @param exact extended precision result
+ * @return double error in ulp, zero for matching infinities and NaN, infinity for other special values
+ */
+double Tests::ulps(double value, long double exact)
+{
+    if (std::isnan(value) || std::isnan(exact) || std::isinf(value) || std::isinf(exact))
+        return (std::isnan(value) && std::isnan(exact)) || value == exact ? 0 : std::numeric_limits<double>::infinity();
+
+    int exponent;
+    std::frexp(static_cast<double>(exact), &exponent);
+
+    return std::fabs(value - exact) / std::ldexp(1.0L, std::max(exponent - 53, -1074));
+}
+
+
+/**
+ * @brief Name of letters only, as formula and function names are read
+ * 
+ * @param number index of the name
+ * @return std::string a, b, ..., z, ab, bb, ...
+ */
+std::string Tests::letters(std::size_t number)
+{
+    std::string name;
+
+    do
+    {
+        name.push_back('a' + number % 26);
+        number /= 26;
+    } while (number > 0);
+
+    return name;
+}
+
+
+/**
+ * @brief Writes text to a new temporary file
+ * 
+ * @param text file contents
+ * @return std::string path of the file, empty when it could not be written
+ */
+std::string Tests::temporary(const std::string &text)
+{
+    char path[] = "/tmp/calc_tests_XXXXXX";
+    int file = ::mkstemp(path);
+
+    if (file < 0)
+        return "";
+
+    bool written = ::write(file, text.data(), text.size()) == static_cast<ssize_t>(text.size());
+    ::close(file);
+
+    return written ? path : "";
+}
+
+
+/**
+ * @brief Checks that native code and the interpreter agree bit for bit on a random corpus, errors included,
+ * and that too deep expressions stay on the interpreter
+ */
+void Tests::jit()
+{
+    GeneratorConfig config;
+    config.terms = 3;
+    config.max_depth = 5;
+    config.bracket_share = 0.4;
+    config.function_share = 0.3;
+    config.power_share = 0.1;
+    config.unary_share = 0.2;
+    config.variables = true;
+
+    ExpressionGenerator generator(config);
+    const double points[][2] = {{0, 0}, {-0.0, 1}, {1.5, -2}, {-3, 0.25}, {100, 1e-3}};
+
+    int checked = 0;
+    int mismatches = 0;
+
+    for (int i = 0; i < JIT_CORPUS; i++)
+    {
+        std::string expression = generator.next();
+        Program program;
+
+        if (EvaluateExpression::compile(expression, program))
+            continue;
+
+        JitProgram jit(program);
+
+        for (const double *point : points)
+        {
+            // variables in x, y order for every program
+            double variables[2];
+
+            for (std::size_t slot = 0; slot < program.variables.size(); slot++)
+                variables[slot] = point[program.variables[slot] == "x" ? 0 : 1];
+
+            checked++;
+
+            std::string native = outcome(&jit, program, variables);
+            std::string interpreted = outcome(nullptr, program, variables);
+
+            if (native != interpreted && mismatches++ < 5)
+                expect(false, expression + ": native " + native + ", interpreter " + interpreted);
+        }
+    }
+
+    // x+(x+(...)) keeps every x on the value stack, native code would need a 16 MB frame
+    std::string deep;
+
+    for (std::size_t i = 0; i < JIT_DEPTH; i++)
+        deep += "x+(";
+
+    deep += "0";
+    deep.append(JIT_DEPTH, ')');
+
+    // a thread has a smaller stack than the main thread
+    std::thread([&]() {
+        Program program;
+        expect(!EvaluateExpression::compile(deep, program), "deep expression does not compile");
+
+        JitProgram jit(program);
+        const double one = 1;
+
+        expect(!jit.compiled(), "deep expression was compiled to native code");
+        expect(jit.execute(&one) == JIT_DEPTH, "deep expression gives " + std::to_string(jit.execute(&one)));
+    }).join();
+
+    expect(checked > JIT_CORPUS, "too few expressions compiled: " + std::to_string(checked) + " evaluations");
+    expect(mismatches == 0, std::to_string(mismatches) + " of " + std::to_string(checked) + " evaluations differ");
+}
+
+
+/**
+ * @brief Checks that compiling, executing and evaluating allocate nothing once their buffers are warm
+ */
+void Tests::allocations()
+{
+    Program program;
+    std::string out;
+    const double values[] = {0.5, 0.25, 2};
+
+    for (const std::string &expression : STEADY_EXPRESSIONS)
+    {
+        // the first run sizes the program, the arena and the output
+        for (int pass = 0; pass < 2; pass++)
+        {
+            std::size_t before = ::allocations;
+
+            for (int i = 0; i < STEADY_ITERATIONS; i++)
+            {
+                double result;
+
+                if (!EvaluateExpression::compile(expression, program))
+                    (void) EvaluateExpression::execute(program, values, result);
+
+                out.clear();
+                EvaluateExpression::evaluate(expression, out);
+            }
+
+            std::size_t made = ::allocations - before;
+
+            if (pass == 1)
+                expect(made == 0, expression + ": " + std::to_string(made) + " allocations in " +
+                                  std::to_string(STEADY_ITERATIONS) + " evaluations");
+        }
+    }
+}
+
+
+/**
+ * @brief Checks that compiling takes linear time on flat, deeply nested and unary chained expressions
+ */
+void Tests::scaling()
+{
+    Program program;
+    const double values[] = {0.5, 0.25};
+
+    for (const std::string shape : {"flat", "nested", "unary"})
+    {
+        double smallest = 0;
+        double largest = 0;
+
+        for (std::size_t size : SCALING_SIZES)
+        {
+            std::string expression = shaped(shape, size);
+            std::string name = shape + " " + std::to_string(size);
+            Error error;
+
+            // the same amount of work at every size, the fastest of three rounds
+            int repeats = std::max<std::size_t>(1, 2 * SCALING_SIZES.back() / size);
+            double best = std::numeric_limits<double>::infinity();
+
+            for (int round = 0; round < 3; round++)
+            {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+                for (int i = 0; i < repeats; i++)
+                    error = EvaluateExpression::compile(expression, program);
+
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                best = std::min(best, elapsed.count() / (repeats * size));
+            }
+
+            double result = 0;
+
+            expect(!error && !EvaluateExpression::execute(program, values, result) && std::isfinite(result),
+                   name + ": does not evaluate");
+
+            if (smallest == 0)
+                smallest = best;
+
+            largest = best;
+        }
+
+        expect(largest / smallest <= SCALING_GROWTH, shape + ": compile time per token grows " +
+                                                     std::to_string(largest / smallest) + " times");
+    }
+}
+
+
+/**
+ * @brief Checks the vector kernels of every supported instruction set against the error bounds documented in vector_math.h
+ * 
+ * Arguments are those of the "simd" benchmark: small and large angles, the doubles closest to
+ * multiples of pi/2, tiny values, every exponent and the neighbourhood of 1 for logarithms, and
+ * the special values.
+ */
+void Tests::simd()
+{
+    std::mt19937_64 rng(20);
+    std::uniform_real_distribution<double> unit(0, 1);
+
+    std::vector<double> angles;
+    std::vector<double> positives;
+
+    for (std::size_t i = 0; i < SIMD_SAMPLES; i++)
+    {
+        angles.push_back(unit(rng) * 20 - 10);
+        angles.push_back((unit(rng) < 0.5 ? -1 : 1) * std::ldexp(1.0, -30 + static_cast<int>(unit(rng) * 51)) * (1 + unit(rng)));
+        angles.push_back(std::nearbyint(unit(rng) * 1300000) * 1.5707963267948966192313216916397514L);
+        angles.push_back(std::nextafter(angles.back(), 0.0));
+        angles.push_back(std::ldexp(unit(rng), -40));
+
+        positives.push_back(std::ldexp(0.5 + unit(rng) / 2, static_cast<int>(unit(rng) * 2044) - 1021));
+        positives.push_back(1 + (unit(rng) - 0.5) * 1e-3);
+        positives.push_back(unit(rng) * 1000);
+    }
+
+    const double infinity = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    for (double special : {0.0, -0.0, 1e7, -1e300, infinity, -infinity, nan})
+        angles.push_back(special);
+
+    for (double special : {0.0, 1.0, 10.0, 0x1p-1074, 0x1p-1030, infinity, nan, -1.0})
+        positives.push_back(special);
+
+    // kernel, arguments, extended precision reference and documented bound of every function
+    struct Function
+    {
+        const char *name;
+        void (*MathKernels::*kernel)(double*, std::size_t);
+        const std::vector<double> *arguments;
+        long double (*exact)(long double);
+        double bound;
+    };
+
+    const Function functions[] = {{"sin", &MathKernels::sin, &angles, sinl, 1},
+                                  {"cos", &MathKernels::cos, &angles, cosl, 1},
+                                  {"tan", &MathKernels::tan, &angles, tanl, 1},
+                                  {"cot", &MathKernels::cot, &angles, [](long double x) { return 1 / tanl(x); }, 1.5},
+                                  {"log", &MathKernels::log, &positives, log10l, 1},
+                                  {"ln", &MathKernels::ln, &positives, logl, 1}};
+
+    std::vector<double> values;
+    int checked = 0;
+
+    // the scalar kernels are libm, whose log10 is off by more than an ulp close to 1
+    for (int target = static_cast<int>(SimdTarget::AVX2); target < static_cast<int>(SimdTarget::COUNT); target++)
+    {
+        const MathKernels *kernels = VectorMath::kernels(static_cast<SimdTarget>(target));
+        std::string name = VectorMath::name(static_cast<SimdTarget>(target));
+
+        if (kernels == nullptr)
+        {
+            std::cout << "\t" << name << ": not supported" << std::endl;
+            continue;
+        }
+
+        checked++;
+
+        for (const Function &function : functions)
+        {
+            values = *function.arguments;
+            (kernels->*function.kernel)(values.data(), values.size());
+
+            double worst = 0;
+            double argument = 0;
+
+            for (std::size_t i = 0; i < values.size(); i++)
+            {
+                double error = ulps(values[i], function.exact((*function.arguments)[i]));
+
+                if (error > worst)
+                {
+                    worst = error;
+                    argument = (*function.arguments)[i];
+                }
+            }
+
+            expect(worst < function.bound, name + " " + function.name + ": " + std::to_string(worst) +
+                                           " ulp at " + std::to_string(argument));
+        }
+    }
+
+    if (checked == 0)
+        std::cout << "\tno vector instruction set is supported" << std::endl;
+}
+
+
+/**
+ * @brief Checks that cached results match evaluating every expression directly, whatever was cached before
+ */
+void Tests::cache()
+{
+    ResultCache cache(1 << 20);
+
+    // twice, so the second pass reads every result back from the cache
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (const std::string &expression : CACHE_EXPRESSIONS)
+        {
+            std::string cached;
+            std::string direct;
+
+            cache.evaluate(expression, cached);
+            EvaluateExpression::evaluate(expression, direct);
+
+            expect(cached == direct, expression + ": cached \"" + cached + "\", evaluated \"" + direct + "\"");
+        }
+    }
+
+    // every second pass lookup hits, and 1.5+2 already on the first pass
+    std::uint64_t hits = cache.stats().hits;
+    expect(hits == CACHE_EXPRESSIONS.size() + 1, std::to_string(hits) + " cache hits");
+}
+
+
+/**
+ * @brief Checks that chained functions need a space or bracket between them
+ */
+void Tests::chaining()
+{
+    for (const std::pair<std::string, std::string> &chained : CHAINED_FUNCTIONS)
+    {
+        std::string out;
+        EvaluateExpression::evaluate(chained.first, out);
+
+        expect(out == chained.second, chained.first + ": \"" + out + "\", expected \"" + chained.second + "\"");
+    }
+}
+
+
+/**
+ * @brief Checks that split programs give the sequential result on any number of threads, from tasks of
+ * the pool and beside unrelated tasks, and that a costly subexpression shared by every term is
+ * evaluated once rather than copied into each
+ */
+void Tests::parallel()
+{
+    std::string shared;
+    std::string other;
+
+    for (int i = 1; i <= SHARED_SINES; i++)
+    {
+        shared += (i > 1 ? " + " : "") + std::string("sin(x + ") + std::to_string(i) + ")";
+        other += (i > 1 ? " - " : "") + std::string("cos(x * ") + std::to_string(i) + ")";
+    }
+
+    // every term reads the shared sum, the second expression also nests one shared sum in another
+    std::string flat;
+    std::string nested;
+
+    for (int i = 1; i <= SHARED_TERMS; i++)
+        flat += (i > 1 ? " + " : "") + std::string("sin((") + shared + ") + " + std::to_string(i) + ")";
+
+    for (int i = 1; i <= NESTED_TERMS; i++)
+    {
+        nested += (i > 1 ? " - " : "") + std::string("cos(((") + shared + ") * (" + other + " + (" + shared + ")) / " +
+                  std::to_string(i) + ") * (" + other + "))";
+    }
+
+    const double values[] = {0.5};
+
+    for (const std::string *expression : {&flat, &nested})
+    {
+        std::string name = expression == &flat ? "flat" : "nested";
+        Program program;
+        double expected;
+
+        expect(!EvaluateExpression::compile(*expression, program) &&
+               !EvaluateExpression::execute(program, values, expected), name + ": does not evaluate");
+
+        ParallelProgram split(program);
+
+        expect(split.terms() > 1, name + ": not split");
+        expect(split.code.size() <= program.code.size(), name + ": " + std::to_string(split.code.size()) +
+                                                          " instructions in entries for a program of " +
+                                                          std::to_string(program.code.size()));
+
+        double result;
+        expect(!split.execute(nullptr, values, result) && result == expected, name + ": differs without threads");
+
+        for (std::size_t threads : PARALLEL_THREADS)
+        {
+            ThreadPool pool(threads);
+
+            expect(!split.execute(&pool, values, result) && result == expected,
+                   name + ": differs on " + std::to_string(threads) + " threads");
+
+            // from a task of the same pool, which deadlocks if execute waits for the whole pool
+            double nested = 0;
+            Error error;
+
+            pool.submit([&]() { error = split.execute(&pool, values, nested); });
+            pool.wait();
+
+            expect(!error && nested == expected, name + ": differs from a task on " + std::to_string(threads) + " threads");
+        }
+
+        // an unrelated task that only finishes after execute returns
+        ThreadPool pool(2);
+        std::atomic<bool> started{false};
+        std::atomic<bool> released{false};
+
+        pool.submit([&]() {
+            started = true;
+
+            while (!released)
+                std::this_thread::yield();
+        });
+
+        while (!started)
+            std::this_thread::yield();
+
+        expect(!split.execute(&pool, values, result) && result == expected, name + ": differs beside a running task");
+
+        released = true;
+        pool.wait();
+    }
+}
+
+
+/**
+ * @brief Checks that tasks submitted by concurrent producers all run once and that a throwing task
+ * neither hangs wait nor stops the pool
+ */
+void Tests::pool()
+{
+    ThreadPool pool(PARALLEL_THREADS.back());
+    std::atomic<int> ran{0};
+    std::vector<std::thread> producers;
+
+    for (int producer = 0; producer < POOL_PRODUCERS; producer++)
+    {
+        producers.emplace_back([&]() {
+            for (int i = 0; i < POOL_TASKS; i++)
+                pool.submit([&ran]() { ran++; });
+        });
+    }
+
+    for (std::thread &producer : producers)
+        producer.join();
+
+    pool.wait();
+    expect(ran == POOL_PRODUCERS * POOL_TASKS, std::to_string(ran) + " of " + std::to_string(POOL_PRODUCERS * POOL_TASKS) +
+                                               " tasks ran");
+
+    ran = 0;
+    pool.submit([]() { throw std::runtime_error("task failed"); });
+
+    for (int i = 0; i < POOL_TASKS; i++)
+        pool.submit([&ran]() { ran++; });
+
+    std::string thrown;
+
+    try
+    {
+        pool.wait();
+    }
+    catch (const std::runtime_error &error)
+    {
+        thrown = error.what();
+    }
+
+    expect(thrown == "task failed", "wait did not rethrow the exception of a task");
+    expect(ran == POOL_TASKS, "tasks after a throwing one did not run");
+
+    // the exception is reported once, the pool keeps working
+    pool.submit([&ran]() { ran++; });
+    pool.wait();
+
+    expect(ran == POOL_TASKS + 1, "pool stopped after a throwing task");
+}
+
+
+/**
+ * @brief Checks the error code, source offset and message of every kind of error, and that the
+ * error codes describe generated malformed expressions exactly as the throwing interface does
+ */
+void Tests::errors()
+{
+    for (const std::tuple<std::string, ErrorCode, std::uint32_t, std::string> &error : ERROR_CASES)
+    {
+        const std::string &expression = std::get<0>(error);
+        EvaluationContext context;
+        std::string out;
+
+        Result result = context.evaluate(expression);
+        context.evaluate(expression, out);
+
+        expect(result.error.code == std::get<1>(error) && result.error.offset == std::get<2>(error),
+               expression + ": error " + std::to_string(static_cast<int>(result.error.code)) + " at " +
+               std::to_string(result.error.offset));
+        expect(out == std::get<3>(error), expression + ": \"" + out + "\"");
+    }
+
+    GeneratorConfig config;
+    config.terms = 6;
+    config.max_depth = 2;
+
+    ExpressionGenerator generator(config);
+    int mismatches = 0;
+
+    for (int i = 0; i < ERROR_CORPUS; i++)
+    {
+        std::string expression = generator.next() + DEFECTS[i % DEFECTS.size()];
+        std::string thrown;
+        std::string returned;
+
+        try
+        {
+            EvaluateExpression::format(EvaluateExpression::execute(EvaluateExpression::compile(expression)), FormatOptions(), thrown);
+        }
+        catch (const std::exception &e)
+        {
+            thrown = std::string("error: ") + e.what();
+        }
+
+        EvaluateExpression::evaluate(expression, returned);
+
+        if (thrown != returned && mismatches++ < 5)
+            expect(false, expression + ": thrown \"" + thrown + "\", returned \"" + returned + "\"");
+    }
+
+    expect(mismatches == 0, std::to_string(mismatches) + " of " + std::to_string(ERROR_CORPUS) + " expressions differ");
+}
+
+
+/**
+ * @brief Checks that formulas reject cycles when they are defined and that a change recomputes
+ * exactly the formulas downstream of it
+ */
+void Tests::formulas()
+{
+    FormulaGraph graph;
+    std::string out;
+
+    // lines with whether they are accepted and what they print
+    const std::vector<std::tuple<std::string, bool, std::string>> lines = {
+        {"in = 1", true, "in = 1.000000 (1 formula recomputed)"},
+        {"a = in * 2", true, "a = 2.000000 (1 formula recomputed)"},
+        {"b = a + 1", true, "b = 3.000000 (1 formula recomputed)"},
+        {"c = b + a", true, "c = 5.000000 (1 formula recomputed)"},
+        {"other = 5", true, "other = 5.000000 (1 formula recomputed)"},
+        {"d = other + c", true, "d = 10.000000 (1 formula recomputed)"},
+        {"a = c + 1", false, "invalid expression: circular reference through \"c\""},
+        {"x = x + 1", false, "invalid expression: circular reference through \"x\""},
+        {"b", true, "3.000000"},
+        {"e = f + 1", false, "invalid expression: unknown variable \"f\" (1 formula recomputed)"},
+        {"f = 2", true, "f = 2.000000 (2 formulas recomputed)"},
+        {"e", true, "3.000000"}};
+
+    for (const std::tuple<std::string, bool, std::string> &line : lines)
+    {
+        out.clear();
+        bool accepted = graph.evaluate(std::get<0>(line), out);
+
+        expect(accepted == std::get<1>(line) && out == std::get<2>(line), std::get<0>(line) + ": \"" + out + "\"");
+    }
+
+    // in feeds a, b, c and d, other only feeds d, and a rejected cycle changes nothing
+    const std::vector<std::tuple<std::string, std::string, ErrorCode, std::size_t>> changes = {
+        {"in", "3", ErrorCode::NONE, 5}, {"other", "9", ErrorCode::NONE, 2}, {"in", "d * 2", ErrorCode::CIRCULAR_REFERENCE, 0}};
+
+    for (const std::tuple<std::string, std::string, ErrorCode, std::size_t> &change : changes)
+    {
+        Program program;
+        std::size_t recomputed = 0;
+
+        expect(!EvaluateExpression::compile(std::get<1>(change), program), std::get<1>(change) + ": does not compile");
+
+        Error error = graph.define(std::get<0>(change), std::get<1>(change), std::move(program), recomputed);
+
+        expect(error.code == std::get<2>(change) && recomputed == std::get<3>(change),
+               std::get<0>(change) + " = " + std::get<1>(change) + ": error " + std::to_string(static_cast<int>(error.code)) +
+               ", " + std::to_string(recomputed) + " recomputed");
+    }
+
+    out.clear();
+    graph.evaluate("d", out);
+    expect(out == "22.000000", "d after the changes: \"" + out + "\"");
+}
+
+
+/**
+ * @brief Checks that the pipeline writes the same results in the same order as evaluating the lines one by one,
+ * for a long file and for a stream from a pipe
+ */
+void Tests::pipeline()
+{
+    GeneratorConfig config;
+    ExpressionGenerator generator(config);
+    std::string text;
+
+    // errors, empty lines and one line longer than a batch among the generated ones
+    for (int i = 0; i < PIPELINE_LINES; i++)
+    {
+        text += generator.next();
+
+        if (i % 7 == 0)
+            text += DEFECTS[i % DEFECTS.size()];
+
+        if (i % 1000 == 0)
+            text += "\n";
+
+        if (i == PIPELINE_LINES / 2)
+        {
+            for (int term = 0; term < 100000; term++)
+                text += " + 1";
+        }
+
+        text += "\n";
+    }
+
+    std::vector<std::string_view> lines;
+
+    for (std::size_t begin = 0; begin < text.size();)
+    {
+        std::size_t end = text.find('\n', begin);
+        lines.push_back(std::string_view(text).substr(begin, end - begin));
+        begin = end + 1;
+    }
+
+    std::vector<std::string> results;
+    BatchInput::evaluate_lines(lines, results, nullptr, nullptr, FormatOptions());
+
+    std::string expected;
+
+    for (const std::string &result : results)
+        expected += result;
+
+    std::string path = temporary(text);
+    expect(!path.empty(), "could not write the input file");
+
+    int ends[2];
+    expect(::pipe(ends) == 0, "could not create a pipe");
+
+    for (const std::string source : {"file", "pipe"})
+    {
+        int input = source == "file" ? ::open(path.c_str(), O_RDONLY) : ends[0];
+
+        // a producer writing in small pieces, the way stdin arrives
+        std::thread producer([&]() {
+            if (source == "file")
+                return;
+
+            for (std::size_t sent = 0; sent < text.size();)
+            {
+                ssize_t length = ::write(ends[1], text.data() + sent, std::min<std::size_t>(text.size() - sent, 4000));
+
+                if (length <= 0)
+                    break;
+
+                sent += length;
+            }
+
+            ::close(ends[1]);
+        });
+
+        std::FILE *capture = std::tmpfile();
+        Pipeline pipeline((FormatOptions()));
+        PipelineMetrics metrics = pipeline.process(input, capture);
+
+        producer.join();
+        ::close(input);
+
+        std::string actual(std::ftell(capture), '\0');
+        std::rewind(capture);
+        actual.resize(std::fread(actual.data(), 1, actual.size(), capture));
+        std::fclose(capture);
+
+        expect(metrics.lines == lines.size(), source + ": " + std::to_string(metrics.lines) + " of " +
+                                              std::to_string(lines.size()) + " lines");
+        expect(actual == expected, source + ": output differs from evaluating the lines one by one");
+    }
+
+    ::unlink(path.c_str());
+}
+
+
+/**
+ * @brief Checks that mapped programs give the results and errors of compiling their text, and that
+ * corrupt, stale and foreign files are rejected
+ */
+void Tests::store()
+{
+    GeneratorConfig config;
+    config.variables = true;
+
+    ExpressionGenerator generator(config);
+    std::string text;
+    std::vector<std::string> lines;
+
+    for (int i = 0; i < STORE_FORMULAS; i++)
+    {
+        lines.push_back("f" + letters(i) + " = " + generator.next() + (i % 10 == 9 ? " * (1 +" : ""));
+        text += lines.back() + "\n";
+    }
+
+    std::string formulas = temporary(text);
+    std::string path = formulas + ".store";
+
+    expect(ProgramStore::precompile(formulas.c_str(), path.c_str()) == StoreStatus::OK, "could not precompile");
+
+    // x and y of every formula, in whatever order it reads them
+    const double values[] = {0.5, 0.5};
+
+    {
+        ProgramStore store;
+
+        expect(store.open(path.c_str(), formulas.c_str()) == StoreStatus::OK && store.size() == lines.size(),
+               "could not open the store");
+
+        int mismatches = 0;
+
+        for (std::size_t i = 0; i < store.size() && i < lines.size(); i++)
+        {
+            std::string_view name;
+            std::string_view expression;
+            EvaluateExpression::assignment(lines[i], name, expression);
+
+            Program program;
+            double expected = 0;
+            double result = 0;
+            Error error = EvaluateExpression::compile(expression, program);
+
+            if (!error)
+                error = EvaluateExpression::execute(program, values, expected);
+
+            // same error at the same offset, or the same bits
+            Error stored = store.execute(i, values, result);
+
+            if (stored.code != error.code || stored.offset != error.offset || store.find(name) != i || store.name(i) != name ||
+                (!error && std::memcmp(&result, &expected, sizeof(double)) != 0))
+                mismatches++;
+        }
+
+        expect(mismatches == 0, std::to_string(mismatches) + " of " + std::to_string(lines.size()) + " formulas differ");
+        expect(store.find("missing") == store.size(), "found a formula that is not in the store");
+    }
+
+    std::ifstream original(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(original)), std::istreambuf_iterator<char>());
+
+    // one flipped byte in the code section, a truncated file and a file that is no store
+    std::string flipped = bytes;
+    flipped[flipped.size() / 2] ^= 0x10;
+
+    const std::vector<std::tuple<std::string, std::string, StoreStatus>> files = {
+        {"flipped byte", flipped, StoreStatus::CORRUPT},
+        {"truncated", bytes.substr(0, bytes.size() / 2), StoreStatus::CORRUPT},
+        {"formula text", text, StoreStatus::NOT_A_STORE}};
+
+    for (const std::tuple<std::string, std::string, StoreStatus> &file : files)
+    {
+        std::string damaged = temporary(std::get<1>(file));
+        ProgramStore store;
+        StoreStatus status = store.open(damaged.c_str());
+
+        expect(status == std::get<2>(file), std::get<0>(file) + ": " + std::string(STORE_MESSAGES[static_cast<int>(status)]));
+        ::unlink(damaged.c_str());
+    }
+
+    // the formula file changed after precompiling
+    text[text.size() / 2] = text[text.size() / 2] == '1' ? '2' : '1';
+    std::ofstream(formulas, std::ios::binary) << text;
+
+    ProgramStore stale;
+    expect(stale.open(path.c_str(), formulas.c_str()) == StoreStatus::STALE, "stale store was not rejected");
+
+    ::unlink(path.c_str());
+    ::unlink(formulas.c_str());
+}
+
+
+/**
+ * @brief Checks that the perfect hash finds every function and nothing else, before and after registering
+ * natives, and that natives give the results of the standard library in every executor
+ */
+void Tests::registry()
+{
+    const std::vector<std::string> missing = {"", "x", "si", "sine", "lns", "maximum", "Sin", "native"};
+
+    auto lookups = [&](const std::string &table)
+    {
+        for (const FunctionEntry &entry : FUNCTIONS)
+        {
+            const FunctionEntry *found = OperatorRegistry::find(entry.name);
+            expect(found != nullptr && found->op == entry.op && found->slot == entry.slot,
+                   table + ": " + std::string(entry.name) + " not found");
+        }
+
+        for (const std::string &name : missing)
+            expect(OperatorRegistry::find(name) == nullptr, table + ": found " + name);
+    };
+
+    lookups("built in");
+
+    NativeFunction twice = [](const double *operands) { return operands[0] * 2; };
+    NativeFunction difference = [](const double *operands) { return operands[0] - operands[1]; };
+
+    expect(!OperatorRegistry::add("sin", 1, twice), "registered a built in name");
+    expect(!OperatorRegistry::add("two words", 1, twice), "registered an invalid name");
+    expect(!OperatorRegistry::add("triple", 3, twice), "registered a function of three operands");
+
+    std::size_t first = OperatorRegistry::natives();
+
+    for (int i = 0; i < REGISTRY_NATIVES; i++)
+    {
+        std::string name = "native" + letters(i);
+        expect(OperatorRegistry::add(name, 1 + i % 2, i % 2 ? difference : twice), name + ": not registered");
+    }
+
+    expect(!OperatorRegistry::add("nativea", 1, twice), "registered a name twice");
+
+    for (int i = 0; i < REGISTRY_NATIVES; i++)
+    {
+        std::string name = "native" + letters(i);
+        const FunctionEntry *found = OperatorRegistry::find(name);
+
+        expect(found != nullptr && found->op == (i % 2 ? OpCode::CALL2 : OpCode::CALL1) && found->slot == first + i &&
+               OperatorRegistry::native(found->slot) == (i % 2 ? difference : twice), name + ": not found");
+    }
+
+    lookups("registered");
+
+    // natives through the interpreter, native code and array evaluation against the standard library
+    Program program = EvaluateExpression::compile("sqrt(abs(x)) + exp(y) * min(x, y) - max(x, nativeb(x, y)) + nativea(y)");
+    JitProgram jit(program);
+
+    const std::size_t count = 1000;
+    std::vector<double> x(count);
+    std::vector<double> y(count);
+    std::vector<double> out(count);
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        x[i] = (static_cast<double>(i) - count / 2.0) * 1e-2;
+        y[i] = std::sin(i * 0.01);
+    }
+
+    Error error = EvaluateExpression::execute(program, {{"x", x.data()}, {"y", y.data()}}, count, out.data());
+    expect(!error, "arrays failed");
+
+    int mismatches = 0;
+
+    for (std::size_t i = 0; i < count && !error; i++)
+    {
+        double variables[] = {x[i], y[i]};
+        double expected = std::sqrt(std::fabs(x[i])) + std::exp(y[i]) * std::min(x[i], y[i]) - std::max(x[i], x[i] - y[i]) +
+                          y[i] * 2;
+        double interpreted = 0;
+        double native = 0;
+
+        if (EvaluateExpression::execute(program, variables, interpreted) || jit.execute(variables, native) ||
+            interpreted != expected || native != expected || out[i] != expected)
+            mismatches++;
+    }
+
+    expect(mismatches == 0, std::to_string(mismatches) + " of " + std::to_string(count) + " evaluations differ");
+}
+
+
+/**
+ * @brief Checks that expressions fed to StreamParser in random chunks give the text, error and offset of
+ * evaluating them whole, for generated, malformed and failing expressions
+ */
+void Tests::stream()
+{
+    GeneratorConfig config;
+    config.function_share = 0.3;
+    config.unary_share = 0.3;
+
+    ExpressionGenerator generator(config);
+    std::vector<std::string> corpus = STREAM_CASES;
+
+    for (const std::tuple<std::string, ErrorCode, std::uint32_t, std::string> &error : ERROR_CASES)
+        corpus.push_back(std::get<0>(error));
+
+    for (int i = 0; i < STREAM_CORPUS; i++)
+        corpus.push_back(generator.next() + (i % 3 == 0 ? DEFECTS[i % DEFECTS.size()] : ""));
+
+    std::mt19937 rng(25);
+    std::uniform_int_distribution<std::size_t> chunk(1, STREAM_CHUNK);
+
+    EvaluationContext context;
+    StreamParser parser;
+    int mismatches = 0;
+
+    for (const std::string &expression : corpus)
+    {
+        std::string expected;
+        Result whole = context.evaluate(expression);
+        context.evaluate(expression, expected);
+
+        if (whole.error)
+            expected = "error: " + expected;
+
+        parser.reset();
+
+        for (std::size_t begin = 0; begin < expression.length();)
+        {
+            std::size_t length = std::min(chunk(rng), expression.length() - begin);
+            (void) parser.feed(std::string_view(expression).substr(begin, length));
+            begin += length;
+        }
+
+        std::string streamed;
+        Error error = parser.finish(streamed);
+
+        if ((error.code != whole.error.code || error.offset != whole.error.offset || streamed != expected) && mismatches++ < 5)
+            expect(false, expression + ": streamed \"" + streamed + "\" at " + std::to_string(error.offset) + ", whole \"" +
+                          expected + "\" at " + std::to_string(whole.error.offset));
+    }
+
+    expect(mismatches == 0, std::to_string(mismatches) + " of " + std::to_string(corpus.size()) + " expressions differ");
+}
+
+
+/**
+ * @brief Checks that StaticProgram gives the results, errors and messages of the runtime compiler, for
+ * formulas the compiler folds and for generated, malformed and failing expressions compiled at run time
+ */
+void Tests::static_programs()
+{
+    // parsed, folded and checked by the compiler
+    constexpr auto folded = calc::compile("3 + 4 * 2 / (1 - 5)^(2^3)");
+    constexpr auto formula = calc::compile("x * 2 + sin(x) / (1 + y^2)");
+    constexpr auto calls = calc::compile("max(2, 3) * -min{1, -4} + 2^-1");
+
+    static_assert(folded.constant() && folded() == 3.0001220703125, "constant formula is folded");
+    static_assert(formula.variable_count() == 2 && formula.slot("y") == 1, "variables in order of first use");
+    static_assert(calls.variable_count() == 0 && !calls.constant(), "natives are left to run time");
+
+    const double bound[] = {0.75, 1.25};
+
+    expect(folded() == EvaluateExpression::execute(EvaluateExpression::compile("3 + 4 * 2 / (1 - 5)^(2^3)")), "folded formula");
+    expect(formula(0.75, 1.25) == EvaluateExpression::execute(EvaluateExpression::compile("x * 2 + sin(x) / (1 + y^2)"), bound),
+           "formula with variables");
+    expect(calls() == 12.5, "natives: " + std::to_string(calls()));
+
+    GeneratorConfig config;
+    config.function_share = 0.2;
+    config.variables = true;
+
+    ExpressionGenerator generator(config);
+    std::vector<std::string> corpus = STREAM_CASES;
+
+    for (const std::tuple<std::string, ErrorCode, std::uint32_t, std::string> &error : ERROR_CASES)
+        corpus.push_back(std::get<0>(error));
+
+    for (int i = 0; i < STATIC_CORPUS; i++)
+        corpus.push_back(generator.next() + (i % 3 == 0 ? DEFECTS[i % DEFECTS.size()] : ""));
+
+    // too large for the stack of a test thread
+    static calc::StaticProgram<STATIC_LENGTH> compiled;
+    Program program;
+    int mismatches = 0;
+
+    // x, y and the unknown z of one defect
+    const double variables[] = {0.75, 1.25, 2.5};
+
+    for (const std::string &expression : corpus)
+    {
+        if (expression.length() >= STATIC_LENGTH)
+            continue;
+
+        Error expected = EvaluateExpression::compile(expression, program);
+        Error error = compiled.compile(expression);
+
+        double expected_value = 0;
+        double value = 0;
+        std::string expected_message;
+        std::string message;
+
+        if (!expected && !error)
+        {
+            expected = EvaluateExpression::execute(program, variables, expected_value);
+            error = compiled.execute(variables, value);
+        }
+        else
+        {
+            // the messages calc::compile and the runtime compiler throw
+            try
+            {
+                (void) EvaluateExpression::compile(expression);
+            }
+            catch (const std::invalid_argument &e)
+            {
+                expected_message = e.what();
+            }
+
+            try
+            {
+                compiled.check(error);
+            }
+            catch (const std::invalid_argument &e)
+            {
+                message = e.what();
+            }
+        }
+
+        bool same = expected.code == error.code && expected.offset == error.offset && message == expected_message &&
+                    (error || (expected_value != expected_value && value != value) ||
+                     std::memcmp(&expected_value, &value, sizeof(value)) == 0);
+
+        if (!same && mismatches++ < 5)
+            expect(false, expression + ": error " + std::to_string(static_cast<int>(error.code)) + " at " +
+                          std::to_string(error.offset) + " \"" + message + "\", runtime error " +
+                          std::to_string(static_cast<int>(expected.code)) + " at " + std::to_string(expected.offset) +
+                          " \"" + expected_message + "\"");
+    }
+
+    expect(mismatches == 0, std::to_string(mismatches) + " of " + std::to_string(corpus.size()) + " expressions differ");
+}
+
+
+/**
+ * @brief Runs correctness tests
+ * 
+ * @param argc number of arguments
+ * @param argv names of tests to run (default all)
+ * @return int zero when every check passed, one for a failed check or an unknown test
+ */
+int main(int argc, char *argv[])
+{
+    const std::map<std::string, void (*)()> tests = {{"jit", Tests::jit},
+                                                     {"allocations", Tests::allocations},
+                                                     {"scaling", Tests::scaling},
+                                                     {"simd", Tests::simd},
+                                                     {"cache", Tests::cache},
+                                                     {"chaining", Tests::chaining},
+                                                     {"parallel", Tests::parallel},
+                                                     {"pool", Tests::pool},
+                                                     {"errors", Tests::errors},
+                                                     {"formulas", Tests::formulas},
+                                                     {"pipeline", Tests::pipeline},
+                                                     {"store", Tests::store},
+                                                     {"registry", Tests::registry},
+                                                     {"stream", Tests::stream},
+                                                     {"static", Tests::static_programs}};
+
+    std::vector<std::string> selected(argv + 1, argv + argc);
+
+    if (selected.size() == 0)
+    {
+        for (const std::pair<const std::string, void (*)()> &test : tests)
+            selected.push_back(test.first);
+    }
+
+    for (const std::string &name : selected)
+    {
+        if (tests.find(name) == tests.end())
+        {
+            std::cerr << "unknown test: " << name << std::endl;
+            return 1;
+        }
+
+        std::cout << name << std::endl;
+        tests.at(name)();
+    }
+
+    std::cout << (Tests::failures == 0 ? "passed" : std::to_string(Tests::failures) + " checks failed") << std::endl;
+
+    return Tests::failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include "thread_pool.h"
+#include <utility>
+
+
+/**
+ * @brief Starts worker threads, each with its own task queue
+ * 
+ * @param count number of worker threads, at least one
+ */
+ThreadPool::ThreadPool(std::size_t count)
+{
+    if (count == 0)
+        count = 1;
+
+    for (std::size_t i = 0; i < count; i++)
+        workers.push_back(std::make_unique<Worker>());
+
+    for (std::size_t i = 0; i < count; i++)
+        threads.emplace_back(&ThreadPool::work, this, i);
+}
+
+
+/**
+ * @brief Finishes queued tasks and joins the worker threads
+ */
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+
+    wake.notify_all();
+
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+
+/**
+ * @brief Queues task on the next worker in round robin order
+ * 
+ * @param task work to run on the pool
+ */
+void ThreadPool::submit(std::function<void()> task)
+{
+    Worker &worker = *workers[next++ % workers.size()];
+    pending++;
+
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+        queued++;
+    }
+
+    // a worker counts itself as sleeping before it checks queued, so one of the two sees the other
+    if (sleeping > 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake.notify_one();
+    }
+}
+
+
+/**
+ * @brief Blocks until every submitted task has finished
+ * 
+ * @throws the first exception a task threw since the last wait, the other tasks still ran
+ */
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+
+    if (failure)
+        std::rethrow_exception(std::exchange(failure, nullptr));
+}
+
+
+/**
+ * @brief Runs one queued task on the calling thread, so a caller waiting for some of the tasks can
+ * make progress instead of blocking a worker
+ * 
+ * @return true a task was run
+ * @return false every queue was empty
+ */
+bool ThreadPool::help()
+{
+    std::function<void()> task;
+
+    if (!pop(next % workers.size(), task))
+        return false;
+
+    run(task);
+    return true;
+}
+
+
+/**
+ * @brief Number of worker threads
+ * 
+ * @return std::size_t worker count
+ */
+std::size_t ThreadPool::size() const
+{
+    return threads.size();
+}
+
+
+/**
+ * @brief Takes the newest task of a worker, or steals the oldest task of another worker
+ * 
+ * @param index worker looking for a task
+ * @param task receives the task
+ * @return true task was found
+ * @return false all queues are empty
+ */
+bool ThreadPool::pop(std::size_t index, std::function<void()> &task)
+{
+    for (std::size_t i = 0; i < workers.size(); i++)
+    {
+        Worker &worker = *workers[(index + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+
+        if (worker.tasks.size() > 0)
+        {
+            // own queue is used as a stack, stolen tasks come from the other end
+            if (i == 0)
+            {
+                task = std::move(worker.tasks.back());
+                worker.tasks.pop_back();
+            }
+            else
+            {
+                task = std::move(worker.tasks.front());
+                worker.tasks.pop_front();
+            }
+
+            queued--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief Worker loop, runs tasks until the pool is stopped
+ * 
+ * @param index worker owned by this thread
+ */
+void ThreadPool::work(std::size_t index)
+{
+    std::function<void()> task;
+
+    while (true)
+    {
+        if (pop(index, task))
+        {
+            run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping++;
+        wake.wait(lock, [this] { return stop || queued > 0; });
+        sleeping--;
+
+        if (stop && queued == 0)
+            return;
+    }
+}
+
+
+/**
+ * @brief Runs a task taken from a queue and counts it as finished, even when it throws
+ * 
+ * @param task task to run, left empty
+ */
+void ThreadPool::run(std::function<void()> &task)
+{
+    // finishes the task however it ends, the last one wakes the callers of wait
+    struct Finish
+    {
+        ThreadPool &pool;
+        std::function<void()> &task;
+
+        ~Finish()
+        {
+            task = nullptr;
+
+            if (--pool.pending == 0)
+            {
+                std::lock_guard<std::mutex> lock(pool.mutex);
+                pool.done.notify_all();
+            }
+        }
+    };
+
+    Finish finish{*this, task};
+
+    try
+    {
+        task();
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!failure)
+            failure = std::current_exception();
+    }
+}
\ No newline at end of file
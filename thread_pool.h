@@ -0,0 +1,53 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+
+class ThreadPool
+{
+    public:
+        explicit ThreadPool(std::size_t);
+        ~ThreadPool();
+
+        void submit(std::function<void()>);
+        void wait();
+        bool help();
+        std::size_t size() const;
+
+    private:
+        // task queue owned by one worker, other workers steal from its front
+        struct Worker
+        {
+            std::deque<std::function<void()>> tasks;
+            std::mutex mutex;
+        };
+
+        void work(std::size_t);
+        bool pop(std::size_t, std::function<void()>&);
+        void run(std::function<void()>&);
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::thread> threads;
+
+        // sleeping workers and waiting callers, submitters only take the mutex to wake a sleeping worker
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+
+        std::atomic<std::size_t> queued{0};
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> pending{0};
+        std::atomic<std::size_t> sleeping{0};
+        bool stop = false;
+
+        // first exception thrown by a task since the last wait, rethrown by wait
+        std::exception_ptr failure;
+};
\ No newline at end of file
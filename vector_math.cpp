@@ -0,0 +1,112 @@
+#include "vector_math.h"
+#include <cmath>
+
+// names of the instruction sets
+const char *TARGET_NAMES[] = {"scalar", "avx2", "avx512"};
+
+
+/**
+ * @brief libm kernels, the fallback on every CPU
+ */
+struct ScalarKernels
+{
+    static void sin(double *values, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i++)
+            values[i] = std::sin(values[i]);
+    }
+
+    static void cos(double *values, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i++)
+            values[i] = std::cos(values[i]);
+    }
+
+    static void tan(double *values, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i++)
+            values[i] = std::tan(values[i]);
+    }
+
+    static void cot(double *values, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i++)
+            values[i] = 1 / std::tan(values[i]);
+    }
+
+    static void log(double *values, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i++)
+            values[i] = std::log10(values[i]);
+    }
+
+    static void ln(double *values, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i++)
+            values[i] = std::log(values[i]);
+    }
+};
+
+const MathKernels SCALAR_KERNELS = {ScalarKernels::sin, ScalarKernels::cos, ScalarKernels::tan,
+                                    ScalarKernels::cot, ScalarKernels::log, ScalarKernels::ln};
+
+
+/**
+ * @brief Kernels of the widest instruction set this CPU runs, chosen on first use
+ * 
+ * @return const MathKernels& table of the functions
+ */
+const MathKernels &VectorMath::kernels()
+{
+    static const MathKernels &best = *kernels(target());
+    return best;
+}
+
+
+/**
+ * @brief Kernels of one instruction set
+ * 
+ * @param target instruction set
+ * @return const MathKernels* table, null when the CPU or the build lacks the instruction set
+ */
+const MathKernels *VectorMath::kernels(SimdTarget target)
+{
+#if defined(__x86_64__)
+    if (target == SimdTarget::AVX2 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return avx2();
+
+    if (target == SimdTarget::AVX512 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+        return avx512();
+#endif
+
+    return target == SimdTarget::SCALAR ? &SCALAR_KERNELS : nullptr;
+}
+
+
+/**
+ * @brief Widest instruction set with kernels on this CPU
+ * 
+ * @return SimdTarget instruction set used by kernels()
+ */
+SimdTarget VectorMath::target()
+{
+    if (kernels(SimdTarget::AVX512) != nullptr)
+        return SimdTarget::AVX512;
+
+    if (kernels(SimdTarget::AVX2) != nullptr)
+        return SimdTarget::AVX2;
+
+    return SimdTarget::SCALAR;
+}
+
+
+/**
+ * @brief Name of an instruction set
+ * 
+ * @param target instruction set
+ * @return const char* name
+ */
+const char *VectorMath::name(SimdTarget target)
+{
+    return TARGET_NAMES[static_cast<int>(target)];
+}
\ No newline at end of file
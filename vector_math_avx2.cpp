@@ -0,0 +1,23 @@
+#include "vector_math_kernels.h"
+
+// built with -mavx2 -mfma where the compiler targets x86-64, empty otherwise
+#if defined(__AVX2__) && defined(__FMA__)
+#define AVX2_BUILT 1
+#else
+#define AVX2_BUILT 0
+#endif
+
+
+/**
+ * @brief Kernels on four doubles per AVX2 register
+ * 
+ * @return const MathKernels* table, null when this file was built without AVX2
+ */
+const MathKernels *VectorMath::avx2()
+{
+#if AVX2_BUILT
+    return &VectorKernels<Double4, Integer4>::table();
+#else
+    return nullptr;
+#endif
+}
\ No newline at end of file
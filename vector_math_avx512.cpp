@@ -0,0 +1,23 @@
+#include "vector_math_kernels.h"
+
+// built with -mavx512f -mavx512dq where the compiler targets x86-64, empty otherwise
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+#define AVX512_BUILT 1
+#else
+#define AVX512_BUILT 0
+#endif
+
+
+/**
+ * @brief Kernels on eight doubles per AVX-512 register
+ * 
+ * @return const MathKernels* table, null when this file was built without AVX-512
+ */
+const MathKernels *VectorMath::avx512()
+{
+#if AVX512_BUILT
+    return &VectorKernels<Double8, Integer8>::table();
+#else
+    return nullptr;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,458 @@
+#pragma once
+
+#include "vector_math.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Vector kernels of VectorMath, written once over GCC vector extensions and compiled by every
+// instruction set file with its own flags. The polynomials and argument reductions are those
+// of fdlibm, evaluated on whole vectors with the rare special arguments handed to libm.
+
+
+// registers of four and eight doubles, and integers of the same width for masks and bit operations
+typedef double Double4 __attribute__((vector_size(32)));
+typedef std::int64_t Integer4 __attribute__((vector_size(32)));
+typedef double Double8 __attribute__((vector_size(64)));
+typedef std::int64_t Integer8 __attribute__((vector_size(64)));
+
+
+template <typename Vector, typename Integers>
+class VectorKernels
+{
+    public:
+        static const MathKernels &table();
+
+    private:
+        // which of the functions sharing the trigonometric argument reduction to return
+        enum class Trig
+        {
+            SIN, COS, TAN, COT
+        };
+
+        template <Vector (*KERNEL)(Vector)>
+        static void apply(double*, std::size_t);
+
+        template <Trig FUNCTION>
+        static Vector trigonometric(Vector);
+
+        template <bool BASE10>
+        static Vector logarithm(Vector);
+
+        static Integers reduce(Vector, Vector&, Vector&);
+        static Vector sin_kernel(Vector, Vector);
+        static Vector cos_kernel(Vector, Vector);
+        static Vector tan_kernel(Vector, Vector, Integers);
+        static bool any(Integers);
+
+        // same bits as the other type
+        static Integers as_bits(Vector values) { return reinterpret_cast<Integers>(values); }
+        static Vector as_values(Integers bits) { return reinterpret_cast<Vector>(bits); }
+
+        static void sin(double *values, std::size_t count) { apply<trigonometric<Trig::SIN>>(values, count); }
+        static void cos(double *values, std::size_t count) { apply<trigonometric<Trig::COS>>(values, count); }
+        static void tan(double *values, std::size_t count) { apply<trigonometric<Trig::TAN>>(values, count); }
+        static void cot(double *values, std::size_t count) { apply<trigonometric<Trig::COT>>(values, count); }
+        static void log(double *values, std::size_t count) { apply<logarithm<true>>(values, count); }
+        static void ln(double *values, std::size_t count) { apply<logarithm<false>>(values, count); }
+
+        // 2 / pi, and 0x1.8p52 which rounds a double to an integer held in its low mantissa bits
+        static constexpr double INV_PIO2 = 6.36619772367581382433e-01;
+        static constexpr double ROUNDING = 0x1.8p52;
+
+        // pi / 2 in 33 bit parts, so products with quadrants below 2^20 are exact, with their tails
+        static constexpr double PIO2_1 = 1.57079632673412561417e+00;
+        static constexpr double PIO2_1T = 6.07710050650619224932e-11;
+        static constexpr double PIO2_2 = 6.07710050630396597660e-11;
+        static constexpr double PIO2_2T = 2.02226624879595063154e-21;
+        static constexpr double PIO2_3 = 2.02226624871116645580e-21;
+        static constexpr double PIO2_3T = 8.47842766036889956997e-32;
+
+        // largest argument reduced here, about 2^20 pi / 2, and below which sin x rounds to x
+        static constexpr double REDUCE_LIMIT = 0x1.921fbp+20;
+        static constexpr double TINY = 0x1p-27;
+
+        static constexpr double S1 = -1.66666666666666324348e-01;
+        static constexpr double S2 = 8.33333333332248946124e-03;
+        static constexpr double S3 = -1.98412698298579493134e-04;
+        static constexpr double S4 = 2.75573137070700676789e-06;
+        static constexpr double S5 = -2.50507602534068634195e-08;
+        static constexpr double S6 = 1.58969099521155010221e-10;
+
+        static constexpr double C1 = 4.16666666666666019037e-02;
+        static constexpr double C2 = -1.38888888888741095749e-03;
+        static constexpr double C3 = 2.48015872894767294178e-05;
+        static constexpr double C4 = -2.75573143513906633035e-07;
+        static constexpr double C5 = 2.08757232129817482790e-09;
+        static constexpr double C6 = -1.13596475577881948265e-11;
+
+        static constexpr double T[] = {3.33333333333334091986e-01, 1.33333333333201242699e-01, 5.39682539762260521377e-02,
+                                       2.18694882948595424599e-02, 8.86323982359930005737e-03, 3.59207910759131235356e-03,
+                                       1.45620945432529025516e-03, 5.88041240820264096874e-04, 2.46463134818469906812e-04,
+                                       7.81794442939557092300e-05, 7.14072491382608190305e-05, -1.85586374855275456654e-05,
+                                       2.59073051863633712884e-05};
+
+        // pi / 4 with its tail, tangents of larger reduced arguments are taken of pi / 4 - |x|
+        static constexpr double PIO4 = 7.85398163397448278999e-01;
+        static constexpr double PIO4_LO = 3.06161699786838301793e-17;
+        static constexpr std::int64_t TAN_BIG = 0x3FE5942800000000;
+
+        static constexpr double LG1 = 6.666666666666735130e-01;
+        static constexpr double LG2 = 3.999999999940941908e-01;
+        static constexpr double LG3 = 2.857142874366239149e-01;
+        static constexpr double LG4 = 2.222219843214978396e-01;
+        static constexpr double LG5 = 1.818357216161805012e-01;
+        static constexpr double LG6 = 1.531383769920937332e-01;
+        static constexpr double LG7 = 1.479819860511658591e-01;
+
+        // ln 2 and log10 2 split so products with exponents are exact, and 1 / ln 10 split in two
+        static constexpr double LN2_HI = 6.93147180369123816490e-01;
+        static constexpr double LN2_LO = 1.90821492927058770002e-10;
+        static constexpr double LOG10_2_HI = 3.01029995663611771306e-01;
+        static constexpr double LOG10_2_LO = 3.69423907715893078616e-13;
+        static constexpr double INV_LN10_HI = 4.34294481878168880939e-01;
+        static constexpr double INV_LN10_LO = 2.50829467116452752298e-11;
+
+        static constexpr std::int64_t SIGN = std::int64_t(1) << 63;
+        static constexpr std::int64_t HIGH_WORD = ~std::int64_t(0xffffffff);
+        static constexpr std::size_t LANES = sizeof(Vector) / sizeof(double);
+};
+
+
+/**
+ * @brief Kernels of this vector width
+ * 
+ * @return const MathKernels& table of the functions
+ */
+template <typename Vector, typename Integers>
+const MathKernels &VectorKernels<Vector, Integers>::table()
+{
+    static const MathKernels kernels = {sin, cos, tan, cot, log, ln};
+    return kernels;
+}
+
+
+/**
+ * @brief Runs a kernel over an array in place, a partial last vector is padded with ones
+ * 
+ * @param values arguments, replaced by the results
+ * @param count number of values
+ */
+template <typename Vector, typename Integers>
+template <Vector (*KERNEL)(Vector)>
+void VectorKernels<Vector, Integers>::apply(double *values, std::size_t count)
+{
+    std::size_t i = 0;
+    Vector x;
+
+    for (; i + LANES <= count; i += LANES)
+    {
+        std::memcpy(&x, values + i, sizeof(x));
+        x = KERNEL(x);
+        std::memcpy(values + i, &x, sizeof(x));
+    }
+
+    if (i < count)
+    {
+        x = Vector{} + 1.0;
+        std::memcpy(&x, values + i, (count - i) * sizeof(double));
+        x = KERNEL(x);
+        std::memcpy(values + i, &x, (count - i) * sizeof(double));
+    }
+}
+
+
+/**
+ * @brief Whether any lane of a mask is set
+ * 
+ * @param mask comparison result
+ * @return true at least one lane is set
+ */
+template <typename Vector, typename Integers>
+bool VectorKernels<Vector, Integers>::any(Integers mask)
+{
+    std::int64_t set = 0;
+
+    for (std::size_t lane = 0; lane < LANES; lane++)
+        set |= mask[lane];
+
+    return set != 0;
+}
+
+
+/**
+ * @brief Reduces arguments to [-pi/4, pi/4] by subtracting multiples of pi/2 to 85, 118 or 151 bits
+ * 
+ * @param x arguments, |x| at most REDUCE_LIMIT
+ * @param y0 receives the reduced argument
+ * @param y1 receives the tail of the reduced argument
+ * @return Integers quadrant, its two low bits pick the function and the sign
+ */
+template <typename Vector, typename Integers>
+Integers VectorKernels<Vector, Integers>::reduce(Vector x, Vector &y0, Vector &y1)
+{
+    Vector shifted = x * INV_PIO2 + ROUNDING;
+    Vector fn = shifted - ROUNDING;
+
+    // first round good to 85 bits, more rounds where the result cancelled more than 16 and then 49 bits
+    Integers exponent = (as_bits(x) >> 52) & 0x7ff;
+    Vector r = x - fn * PIO2_1;
+    Vector w = fn * PIO2_1T;
+    Vector y = r - w;
+
+    Vector t = r;
+    Vector next_w = fn * PIO2_2;
+    Vector next_r = t - next_w;
+    next_w = fn * PIO2_2T - ((t - next_r) - next_w);
+
+    Integers again = exponent - ((as_bits(y) >> 52) & 0x7ff) > 16;
+    r = again ? next_r : r;
+    w = again ? next_w : w;
+    y = r - w;
+
+    t = r;
+    next_w = fn * PIO2_3;
+    next_r = t - next_w;
+    next_w = fn * PIO2_3T - ((t - next_r) - next_w);
+
+    again &= exponent - ((as_bits(y) >> 52) & 0x7ff) > 49;
+    r = again ? next_r : r;
+    w = again ? next_w : w;
+    y = r - w;
+
+    y0 = y;
+    y1 = (r - y) - w;
+
+    return as_bits(shifted);
+}
+
+
+/**
+ * @brief Sine on [-pi/4, pi/4] of an argument with a tail
+ * 
+ * @param x reduced argument
+ * @param y tail of the reduced argument
+ * @return Vector sine
+ */
+template <typename Vector, typename Integers>
+Vector VectorKernels<Vector, Integers>::sin_kernel(Vector x, Vector y)
+{
+    Vector z = x * x;
+    Vector v = z * x;
+    Vector r = S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)));
+
+    return x - ((z * (0.5 * y - v * r) - y) - v * S1);
+}
+
+
+/**
+ * @brief Cosine on [-pi/4, pi/4] of an argument with a tail
+ * 
+ * @param x reduced argument
+ * @param y tail of the reduced argument
+ * @return Vector cosine
+ */
+template <typename Vector, typename Integers>
+Vector VectorKernels<Vector, Integers>::cos_kernel(Vector x, Vector y)
+{
+    Vector z = x * x;
+    Vector w = z * z;
+    Vector r = z * (C1 + z * (C2 + z * C3)) + w * w * (C4 + z * (C5 + z * C6));
+    Vector hz = 0.5 * z;
+    w = 1.0 - hz;
+
+    return w + (((1.0 - w) - hz) + (z * r - x * y));
+}
+
+
+/**
+ * @brief Tangent or -1 / tangent on [-pi/4, pi/4] of an argument with a tail
+ * 
+ * @param x reduced argument
+ * @param y tail of the reduced argument
+ * @param inverse lanes that return -1 / tangent
+ * @return Vector tangent or -1 / tangent
+ */
+template <typename Vector, typename Integers>
+Vector VectorKernels<Vector, Integers>::tan_kernel(Vector x, Vector y, Integers inverse)
+{
+    Integers sign = as_bits(x) & SIGN;
+    Integers big = (as_bits(x) & ~SIGN) >= TAN_BIG;
+    Vector folded = (PIO4 - as_values(as_bits(x) ^ sign)) + (PIO4_LO - as_values(as_bits(y) ^ sign));
+
+    x = big ? folded : x;
+    y = big ? Vector{} : y;
+
+    Vector z = x * x;
+    Vector w = z * z;
+    Vector r = T[1] + w * (T[3] + w * (T[5] + w * (T[7] + w * (T[9] + w * T[11]))));
+    Vector v = z * (T[2] + w * (T[4] + w * (T[6] + w * (T[8] + w * (T[10] + w * T[12])))));
+    Vector s = z * x;
+    r = y + z * (s * (r + v) + y);
+    r += T[0] * s;
+    w = x + r;
+
+    // tan(pi/4 - x) = (1 - tan x) / (1 + tan x)
+    Vector one = inverse ? Vector{} - 1.0 : Vector{} + 1.0;
+    Vector folded_result = as_values(as_bits(one - 2.0 * (x - (w * w / (w + one) - r))) ^ sign);
+
+    // -1 / (x + r) with the reciprocal refined from its high word
+    Vector high = as_values(as_bits(w) & HIGH_WORD);
+    v = r - (high - x);
+    Vector a = -1.0 / w;
+    Vector t = as_values(as_bits(a) & HIGH_WORD);
+    Vector reciprocal = t + a * ((1.0 + t * high) + t * v);
+
+    return big ? folded_result : (inverse ? reciprocal : w);
+}
+
+
+/**
+ * @brief Sine, cosine, tangent or cotangent of arguments reduced to [-pi/4, pi/4]
+ * 
+ * @param x arguments in radians
+ * @return Vector results
+ */
+template <typename Vector, typename Integers>
+template <typename VectorKernels<Vector, Integers>::Trig FUNCTION>
+Vector VectorKernels<Vector, Integers>::trigonometric(Vector x)
+{
+    Vector y0;
+    Vector y1;
+    Integers n = reduce(x, y0, y1);
+
+    Integers odd = (n & 1) != 0;
+    Vector result;
+
+    if (FUNCTION == Trig::SIN || FUNCTION == Trig::COS)
+    {
+        Vector s = sin_kernel(y0, y1);
+        Vector c = cos_kernel(y0, y1);
+
+        // quadrants 1 and 3 swap sine and cosine, the sign follows the quadrant
+        Integers negative = ((FUNCTION == Trig::SIN ? n : n + 1) & 2) << 62;
+        Integers bits = as_bits(odd ? (FUNCTION == Trig::SIN ? c : s) : (FUNCTION == Trig::SIN ? s : c)) ^ negative;
+        result = as_values(bits);
+    }
+    else if (FUNCTION == Trig::TAN)
+    {
+        // odd quadrants give -1 / tan of the reduced argument
+        result = tan_kernel(y0, y1, odd);
+    }
+    else
+    {
+        // cot is -(-1 / tan) in even quadrants and -tan in odd ones
+        result = -tan_kernel(y0, y1, odd == 0);
+    }
+
+    // tiny arguments keep their sign, the polynomials would lose it for -0
+    Integers magnitude = as_bits(x) & ~SIGN;
+    Integers tiny = as_values(magnitude) < TINY;
+
+    if (any(tiny))
+    {
+        Vector small = x;
+
+        if (FUNCTION == Trig::COS)
+            small = Vector{} + 1.0;
+        else if (FUNCTION == Trig::COT)
+            small = 1.0 / x;
+
+        result = tiny ? small : result;
+    }
+
+    // large arguments, infinities and NaN
+    Integers slow = (as_values(magnitude) <= REDUCE_LIMIT) == 0;
+
+    if (any(slow))
+    {
+        for (std::size_t lane = 0; lane < LANES; lane++)
+        {
+            if (slow[lane])
+            {
+                if (FUNCTION == Trig::SIN)
+                    result[lane] = std::sin(x[lane]);
+                else if (FUNCTION == Trig::COS)
+                    result[lane] = std::cos(x[lane]);
+                else if (FUNCTION == Trig::TAN)
+                    result[lane] = std::tan(x[lane]);
+                else
+                    result[lane] = 1 / std::tan(x[lane]);
+            }
+        }
+    }
+
+    return result;
+}
+
+
+/**
+ * @brief Natural or base 10 logarithm, splitting x into 2^k (1 + f) with 1 + f in [sqrt(2)/2, sqrt(2))
+ * 
+ * @param x arguments
+ * @return Vector results
+ */
+template <typename Vector, typename Integers>
+template <bool BASE10>
+Vector VectorKernels<Vector, Integers>::logarithm(Vector x)
+{
+    Integers bits = as_bits(x);
+    Integers hx = (bits >> 32) & 0x000fffff;
+
+    // mantissas above sqrt(2) are halved
+    Integers half = (hx + 0x95f64) & 0x100000;
+    Integers k = (bits >> 52) - 1023 + (half >> 20);
+    Integers normalized = (bits & 0x000fffffffffffff) | ((half ^ 0x3ff00000) << 32);
+
+    // exponent to double through the mantissa of 2^52
+    Integers biased = (k + 1024) | 0x4330000000000000;
+    Vector dk = as_values(biased) - (0x1p52 + 1024);
+
+    Vector f = as_values(normalized) - 1.0;
+    Vector s = f / (2.0 + f);
+    Vector z = s * s;
+    Vector w = z * z;
+    Vector t1 = w * (LG2 + w * (LG4 + w * LG6));
+    Vector t2 = z * (LG1 + w * (LG3 + w * (LG5 + w * LG7)));
+    Vector r = t2 + t1;
+    Vector hfsq = 0.5 * f * f;
+    Vector result;
+
+    if (BASE10)
+    {
+        // f - hfsq with its low word cleared is exact in the products below
+        Vector difference = f - hfsq;
+        Integers truncated = as_bits(difference) & ~std::int64_t(0xffffffff);
+        Vector hi = as_values(truncated);
+        Vector lo = (f - hi) - hfsq + s * (hfsq + r);
+
+        Vector value_hi = hi * INV_LN10_HI;
+        Vector y2 = dk * LOG10_2_HI;
+        Vector value_lo = dk * LOG10_2_LO + (lo + hi) * INV_LN10_LO + lo * INV_LN10_HI;
+
+        w = y2 + value_hi;
+        value_lo += (y2 - w) + value_hi;
+        result = value_lo + w;
+    }
+    else
+    {
+        // mantissas near sqrt(2) keep more of f in the last subtraction
+        Integers near = (hx >= 0x6147a) & (hx <= 0x6b851);
+        result = near ? dk * LN2_HI - ((hfsq - (s * (hfsq + r) + dk * LN2_LO)) - f)
+                      : dk * LN2_HI - ((s * (f - r) - dk * LN2_LO) - f);
+    }
+
+    // zero, subnormals, negative numbers, infinity and NaN
+    Integers slow = ((x >= 0x1p-1022) == 0) | (x > 0x1.fffffffffffffp+1023);
+
+    if (any(slow))
+    {
+        for (std::size_t lane = 0; lane < LANES; lane++)
+        {
+            if (slow[lane])
+                result[lane] = BASE10 ? std::log10(x[lane]) : std::log(x[lane]);
+        }
+    }
+
+    return result;
+}
\ No newline at end of file